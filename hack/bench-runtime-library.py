@@ -0,0 +1,72 @@
+#!/usr/bin/env python3
+"""Compare container starts through --runtime-library with executing --runtime.
+
+Runs conmon --sync N times in each mode and reports the time from starting
+conmon to the container pid on the sync pipe, and the CPU time used by conmon
+and everything it waited for (the runtime included).  "{i}" in the arguments
+is replaced by a per-run name, so each run can use its own container id; the
+container should exit quickly:
+
+    bench-runtime-library.py --runs 20 --conmon ./bin/conmon \\
+        --library /usr/lib/conmon/libcrun-conmon.so -- \\
+        --cid bench-{i} --cuuid bench-{i} --runtime /usr/bin/crun ...
+
+The containers are left behind for the caller to clean up.
+"""
+
+import argparse
+import json
+import os
+import resource
+import statistics
+import subprocess
+import sys
+import time
+
+
+def children_cpu():
+    usage = resource.getrusage(resource.RUSAGE_CHILDREN)
+    return usage.ru_utime + usage.ru_stime
+
+
+def run_once(conmon, args):
+    r, w = os.pipe()
+    env = dict(os.environ, _OCI_SYNCPIPE=str(w))
+    cpu = children_cpu()
+    start = time.monotonic()
+    proc = subprocess.Popen([conmon, "--sync"] + args, env=env, pass_fds=[w], stdin=subprocess.DEVNULL)
+    os.close(w)
+    with os.fdopen(r, "r") as pipe:
+        line = pipe.readline()
+        latency = time.monotonic() - start
+        msg = json.loads(line)
+        if msg.get("pid", msg.get("data", -1)) < 0:
+            raise RuntimeError("container failed to start: %s" % line.strip())
+        pipe.read()
+    proc.wait()
+    return latency * 1000, (children_cpu() - cpu) * 1000
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__, formatter_class=argparse.RawDescriptionHelpFormatter)
+    parser.add_argument("--runs", type=int, default=10)
+    parser.add_argument("--conmon", default="conmon")
+    parser.add_argument("--library", required=True, help="runtime library for --runtime-library")
+    parser.add_argument("args", nargs=argparse.REMAINDER)
+    opts = parser.parse_args()
+    args = opts.args[1:] if opts.args[:1] == ["--"] else opts.args
+
+    for label, extra in (("exec", []), ("library", ["--runtime-library", opts.library])):
+        latency, cpu = [], []
+        for i in range(opts.runs):
+            run_args = extra + [a.replace("{i}", "%s-%d" % (label, i)) for a in args]
+            lat, c = run_once(opts.conmon, run_args)
+            latency.append(lat)
+            cpu.append(c)
+        print("%-8s n=%d start median=%.2fms min=%.2fms  cpu median=%.2fms"
+              % (label, opts.runs, statistics.median(latency), min(latency), statistics.median(cpu)))
+    return 0
+
+
+if __name__ == "__main__":
+    sys.exit(main())
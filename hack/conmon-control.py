@@ -0,0 +1,32 @@
+#!/usr/bin/env python3
+"""Send commands to a container's conmon started with --control-socket.
+
+    conmon-control.py SOCKET get
+    conmon-control.py SOCKET set log-size-max 10485760
+    conmon-control.py SOCKET rotate
+
+SOCKET is the "control" socket next to the container's attach socket.  Each
+command is sent as one message; the reply is printed and the exit status is 1
+if conmon answered with an error.
+"""
+
+import socket
+import sys
+
+
+def main():
+    if len(sys.argv) < 3:
+        print(__doc__, file=sys.stderr)
+        return 2
+
+    with socket.socket(socket.AF_UNIX, socket.SOCK_SEQPACKET) as sock:
+        sock.connect(sys.argv[1])
+        sock.send(" ".join(sys.argv[2:]).encode())
+        reply = sock.recv(65536).decode()
+
+    sys.stdout.write(reply)
+    return 0 if reply.startswith("ok") else 1
+
+
+if __name__ == "__main__":
+    sys.exit(main())
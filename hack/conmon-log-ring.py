@@ -0,0 +1,117 @@
+#!/usr/bin/env python3
+"""Follow the shared memory log ring of a container (--log-path ring).
+
+Prints the records of the ring linked as "log-ring" in a bundle directory,
+reached through the socket directory like the attach socket, as
+"<time_ns> <stdout|stderr> <F|P> <line>".  The layout is described in
+src/log_ring.h.  conmon removes the ring when it exits.  With --follow it
+keeps reading until conmon closes the ring, and reports its position so conmon
+can tell how far behind it is:
+
+    conmon-log-ring.py --follow /run/containers/*/userdata
+"""
+
+import argparse
+import mmap
+import os
+import struct
+import sys
+import time
+
+MAGIC = b"CONMONLR"
+HEADER = struct.Struct("=8sIIQQQQII")
+READER = struct.Struct("=iIQ")
+READERS = 8
+RECORD = struct.Struct("=QqIHH")
+STREAMS = {1: "stdout", 2: "stderr"}
+TAIL_OFFSET = 32
+
+
+class Ring:
+    def __init__(self, path):
+        with open(path, "r+b") as f:
+            self.map = mmap.mmap(f.fileno(), 0)
+        magic, version, self.header_size, self.data_size, _, _, _, _, _ = HEADER.unpack_from(self.map)
+        if magic != MAGIC or version != 1:
+            raise ValueError("%s is not a conmon log ring" % path)
+        self.slot = None
+
+    def header(self):
+        _, _, _, _, head, tail, records, closed, _ = HEADER.unpack_from(self.map)
+        return head, tail, closed
+
+    def claim_slot(self):
+        for i in range(READERS):
+            offset = HEADER.size + i * READER.size
+            pid = READER.unpack_from(self.map, offset)[0]
+            if pid == 0 or not os.path.exists("/proc/%d" % pid):
+                READER.pack_into(self.map, offset, os.getpid(), 0, 0)
+                self.slot = offset
+                return
+
+    def report(self, position):
+        if self.slot is not None:
+            READER.pack_into(self.map, self.slot, os.getpid(), 0, position)
+
+    def release_slot(self):
+        if self.slot is not None:
+            READER.pack_into(self.map, self.slot, 0, 0, 0)
+
+    def read(self, position):
+        """Returns the records from position to head, and the new position."""
+        head, tail, _ = self.header()
+        records = []
+        if position < tail:
+            position = tail
+        while position < head:
+            offset = position % self.data_size
+            left = self.data_size - offset
+            if left < RECORD.size:
+                position += left
+                continue
+            start = self.header_size + offset
+            seq, time_ns, length, stream, flags = RECORD.unpack_from(self.map, start)
+            size = left if stream == 0 else RECORD.size + (length + 7) // 8 * 8
+            data = bytes(self.map[start + RECORD.size:start + RECORD.size + length]) if stream else b""
+            # The writer lapped us while we were copying: start over from tail
+            if struct.unpack_from("=Q", self.map, TAIL_OFFSET)[0] > position:
+                return records, struct.unpack_from("=Q", self.map, TAIL_OFFSET)[0]
+            if stream:
+                records.append((seq, time_ns, stream, flags, data))
+            position += size
+        return records, position
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__, formatter_class=argparse.RawDescriptionHelpFormatter)
+    parser.add_argument("--follow", action="store_true", help="wait for new records until conmon closes the ring")
+    parser.add_argument("bundle")
+    opts = parser.parse_args()
+
+    ring = Ring(os.path.join(opts.bundle, "log-ring"))
+    out = sys.stdout.buffer
+    position = 0
+    last_seq = None
+    if opts.follow:
+        ring.claim_slot()
+    try:
+        while True:
+            closed = ring.header()[2]
+            records, position = ring.read(position)
+            for seq, time_ns, stream, flags, data in records:
+                if last_seq is not None and seq != last_seq + 1:
+                    print("conmon-log-ring: lost %d records" % (seq - last_seq - 1), file=sys.stderr)
+                last_seq = seq
+                out.write(b"%d %s %s %s\n" % (time_ns, STREAMS[stream].encode(), b"P" if flags & 1 else b"F", data))
+            out.flush()
+            ring.report(position)
+            if not opts.follow or closed:
+                break
+            time.sleep(0.1)
+    finally:
+        ring.release_slot()
+    return 0
+
+
+if __name__ == "__main__":
+    sys.exit(main())
@@ -0,0 +1,68 @@
+#!/usr/bin/env python3
+"""Print the resource samples conmon publishes with --stats-interval.
+
+Reads the "stats" file of one or more bundle directories (the layout is
+described in src/stats.h) and prints the latest sample of each as JSON, or
+the whole history with --history.  Reading never touches the cgroups:
+
+    conmon-stats.py /run/containers/*/userdata
+"""
+
+import argparse
+import json
+import os
+import struct
+import sys
+
+MAGIC = b"CONMONST"
+HEADER = struct.Struct("=8sIIQQQ")
+SAMPLE = struct.Struct("=9Q")
+FIELDS = ("time_us", "cpu_usage_usec", "cpu_user_usec", "cpu_system_usec", "memory_current",
+          "memory_peak", "io_rbytes", "io_wbytes", "pids_current")
+
+
+def read_stats(path):
+    with open(path, "rb") as f:
+        # Retry while conmon is in the middle of writing a sample.
+        while True:
+            data = f.read()
+            f.seek(0)
+            magic, version, history_len, interval_us, seq, samples = HEADER.unpack_from(data)
+            if magic != MAGIC or version != 1:
+                raise ValueError("%s is not a conmon stats file" % path)
+            if seq % 2 == 0 and HEADER.unpack_from(f.read(HEADER.size))[4] == seq:
+                break
+            f.seek(0)
+
+    def sample(offset):
+        return dict(zip(FIELDS, SAMPLE.unpack_from(data, offset)))
+
+    latest = sample(HEADER.size)
+    history_offset = HEADER.size + SAMPLE.size
+    count = min(samples, history_len)
+    history = [sample(history_offset + ((samples - count + i) % history_len) * SAMPLE.size) for i in range(count)]
+    return {"interval_us": interval_us, "samples": samples, "latest": latest, "history": history}
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__, formatter_class=argparse.RawDescriptionHelpFormatter)
+    parser.add_argument("--history", action="store_true", help="print all the samples still in the ring")
+    parser.add_argument("bundles", nargs="+")
+    opts = parser.parse_args()
+
+    ret = 0
+    for bundle in opts.bundles:
+        try:
+            stats = read_stats(os.path.join(bundle, "stats"))
+        except (OSError, ValueError, struct.error) as e:
+            print("%s: %s" % (bundle, e), file=sys.stderr)
+            ret = 1
+            continue
+        if not opts.history:
+            del stats["history"]
+        print(json.dumps(dict(bundle=bundle, **stats)))
+    return ret
+
+
+if __name__ == "__main__":
+    sys.exit(main())
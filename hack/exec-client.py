@@ -0,0 +1,98 @@
+#!/usr/bin/env python3
+"""Client for exec sessions run by a container's conmon (--exec-sessions).
+
+Run a process described by an OCI process.json in the container, relaying
+its output and exiting with its exit code:
+
+    exec-client.py SOCKET PROCESS_JSON [-i] [--runtime-opt ARG]...
+
+SOCKET is the "exec" socket next to the container's attach socket.  With -i
+the client's stdin is forwarded to the process.  --bench N runs the process
+N times and prints the time from request to exit status.
+"""
+
+import argparse
+import os
+import select
+import socket
+import statistics
+import sys
+import time
+
+STDOUT_PIPE = 2
+STDERR_PIPE = 3
+MSG_STARTED = ord("S")
+MSG_EXIT = ord("X")
+MSG_ERROR = ord("E")
+
+
+def run(path, spec, stdin=False, runtime_opts=(), out=None, err=None):
+    """Run one session; returns (session id, pid, exit code)."""
+    out = out or sys.stdout.buffer
+    err = err or sys.stderr.buffer
+    fields = ["p" + spec] + ["o" + o for o in runtime_opts] + (["i"] if stdin else [])
+    session = pid = None
+
+    with socket.socket(socket.AF_UNIX, socket.SOCK_SEQPACKET) as sock:
+        sock.connect(path)
+        sock.send(b"".join(f.encode() + b"\0" for f in fields))
+        watched = [sock, sys.stdin.buffer] if stdin else [sock]
+        while True:
+            readable, _, _ = select.select(watched, [], [])
+            if sys.stdin.buffer in readable:
+                data = os.read(sys.stdin.fileno(), 32768)
+                sock.send(data)
+                if not data:
+                    watched.remove(sys.stdin.buffer)
+                continue
+            msg = sock.recv(32769)
+            if not msg:
+                raise RuntimeError("conmon closed the exec session")
+            kind, payload = msg[0], msg[1:]
+            if kind == STDOUT_PIPE:
+                out.write(payload)
+                out.flush()
+            elif kind == STDERR_PIPE:
+                err.write(payload)
+                err.flush()
+            elif kind == MSG_STARTED:
+                session, pid = (int(x) for x in payload.split())
+            elif kind == MSG_EXIT:
+                return session, pid, int(payload)
+            elif kind == MSG_ERROR:
+                raise RuntimeError(payload.decode(errors="replace"))
+
+
+def bench(path, spec, runtime_opts, runs):
+    samples = []
+    with open(os.devnull, "wb") as devnull:
+        for _ in range(runs):
+            start = time.monotonic()
+            run(path, spec, runtime_opts=runtime_opts, out=devnull, err=devnull)
+            samples.append((time.monotonic() - start) * 1000)
+    print("exec n=%d median=%.2fms min=%.2fms max=%.2fms"
+          % (runs, statistics.median(samples), min(samples), max(samples)))
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__, formatter_class=argparse.RawDescriptionHelpFormatter)
+    parser.add_argument("socket")
+    parser.add_argument("process_spec")
+    parser.add_argument("-i", "--interactive", action="store_true", help="forward stdin to the process")
+    parser.add_argument("--runtime-opt", action="append", default=[], help="extra argument for runtime exec")
+    parser.add_argument("--bench", type=int, metavar="N", help="time N sequential sessions")
+    opts = parser.parse_args()
+
+    if opts.bench:
+        bench(opts.socket, opts.process_spec, opts.runtime_opt, opts.bench)
+        return 0
+    try:
+        _, _, code = run(opts.socket, opts.process_spec, opts.interactive, opts.runtime_opt)
+    except RuntimeError as e:
+        print("exec failed: %s" % e, file=sys.stderr)
+        return 125
+    return code
+
+
+if __name__ == "__main__":
+    sys.exit(main())
@@ -0,0 +1,88 @@
+/*
+ * Example log sink for --log-path plugin:<so>:<path>, see src/log_sink_plugin.h.
+ *
+ *     cc -shared -fPIC -Isrc -o log-sink-example.so hack/log-sink-example.c
+ *
+ * Appends every record to <path> as "<time_ns> <stdout|stderr> <F|P> <line>",
+ * buffered with stdio.  flush syncs the file and reopen starts a new one, so
+ * the sink follows the log rotation requested on the ctl fifo.
+ */
+
+#define _GNU_SOURCE
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "log_sink_plugin.h"
+
+struct sink {
+	char *path;
+	FILE *file;
+};
+
+int conmon_log_sink_version(void)
+{
+	return CONMON_LOG_SINK_VERSION;
+}
+
+int conmon_log_sink_start(void **opaque, const struct conmon_log_sink_conf *conf, size_t size_configuration)
+{
+	struct sink *sink;
+
+	if (size_configuration < sizeof(*conf) || conf->config[0] == '\0')
+		return -1;
+	sink = calloc(1, sizeof(*sink));
+	if (sink == NULL)
+		return -1;
+	sink->path = strdup(conf->config);
+	sink->file = fopen(sink->path, "ae");
+	if (sink->path == NULL || sink->file == NULL)
+		return -1;
+	*opaque = sink;
+	return 0;
+}
+
+int conmon_log_sink_write(void *opaque, const struct conmon_log_sink_record *records, size_t n_records)
+{
+	struct sink *sink = opaque;
+
+	if (sink->file == NULL)
+		return -1;
+	for (size_t i = 0; i < n_records; i++) {
+		const struct conmon_log_sink_record *r = &records[i];
+		fprintf(sink->file, "%lld %s %c %.*s\n", (long long)r->time_ns, r->stream == CONMON_LOG_SINK_STDERR ? "stderr" : "stdout",
+			r->partial ? 'P' : 'F', (int)r->len, r->data);
+	}
+	return ferror(sink->file) ? -1 : 0;
+}
+
+int conmon_log_sink_flush(void *opaque)
+{
+	struct sink *sink = opaque;
+
+	if (sink->file == NULL || fflush(sink->file) != 0)
+		return -1;
+	return fsync(fileno(sink->file));
+}
+
+int conmon_log_sink_reopen(void *opaque)
+{
+	struct sink *sink = opaque;
+
+	if (sink->file != NULL)
+		fclose(sink->file);
+	sink->file = fopen(sink->path, "we");
+	return sink->file == NULL ? -1 : 0;
+}
+
+int conmon_log_sink_stop(void *opaque)
+{
+	struct sink *sink = opaque;
+	int ret = sink->file != NULL ? fclose(sink->file) : 0;
+
+	free(sink->path);
+	free(sink);
+	return ret;
+}
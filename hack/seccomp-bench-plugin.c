@@ -0,0 +1,62 @@
+/*
+ * Seccomp notify plugin for benchmarking conmon, see hack/seccomp-bench.c.
+ *
+ *     cc -shared -fPIC -DUSE_SECCOMP -Isrc -o seccomp-bench-plugin.so hack/seccomp-bench-plugin.c
+ *
+ * Lets every trapped syscall return 0.  SECCOMP_BENCH_DELAY_US in the
+ * environment of conmon makes it sleep that long on each request, to stand in
+ * for a slow plugin; SECCOMP_BENCH_CACHEABLE=1 marks the answers cacheable.
+ */
+
+#define _GNU_SOURCE
+
+#include <stdlib.h>
+#include <unistd.h>
+
+#include "seccomp_notify_plugin.h"
+
+static useconds_t delay_us = 0;
+static int cacheable = 0;
+
+int run_oci_seccomp_notify_version()
+{
+	return 1;
+}
+
+int run_oci_seccomp_notify_start(void **opaque, struct seccomp_notify_conf_s *conf, size_t size_configuration)
+{
+	const char *delay = getenv("SECCOMP_BENCH_DELAY_US");
+	const char *cache = getenv("SECCOMP_BENCH_CACHEABLE");
+
+	(void)conf;
+	(void)size_configuration;
+	delay_us = delay ? strtoul(delay, NULL, 10) : 0;
+	cacheable = cache != NULL && cache[0] == '1';
+	*opaque = NULL;
+	return 0;
+}
+
+int run_oci_seccomp_notify_handle_request(void *opaque, struct seccomp_notif_sizes *sizes, struct seccomp_notif *sreq,
+					  struct seccomp_notif_resp *sresp, int seccomp_fd, int *handled)
+{
+	(void)opaque;
+	(void)sizes;
+	(void)sreq;
+	(void)seccomp_fd;
+
+	if (delay_us > 0)
+		usleep(delay_us);
+
+	sresp->error = 0;
+	sresp->val = 0;
+	*handled = RUN_OCI_SECCOMP_NOTIFY_HANDLE_SEND_RESPONSE;
+	if (cacheable)
+		*handled |= RUN_OCI_SECCOMP_NOTIFY_HANDLE_CACHEABLE;
+	return 0;
+}
+
+int run_oci_seccomp_notify_stop(void *opaque)
+{
+	(void)opaque;
+	return 0;
+}
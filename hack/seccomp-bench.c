@@ -0,0 +1,143 @@
+/*
+ * Seccomp notify throughput and latency benchmark.
+ *
+ *     cc -O2 -static -o seccomp-bench hack/seccomp-bench.c -lm
+ *
+ * Run it as the process of a container whose seccomp profile traps sysinfo(2)
+ * to conmon, e.g. with
+ *
+ *     "seccomp": {"defaultAction": "SCMP_ACT_ALLOW",
+ *                 "syscalls": [{"names": ["sysinfo"], "action": "SCMP_ACT_NOTIFY"}]}
+ *
+ * in config.json, the "run.oci.seccomp.receiver" annotation pointing at
+ * conmon's --seccomp-notify-socket and hack/seccomp-bench-plugin.c loaded
+ * with --seccomp-notify-plugins:
+ *
+ *     seccomp-bench [RATE [SECONDS [THREADS]]]
+ *
+ * makes RATE calls per second (0, the default, as fast as possible) for
+ * SECONDS seconds (default 10), spread over THREADS threads (default 1), and
+ * prints the achieved rate and the latency percentiles of the trapped calls.
+ * Send SIGUSR2 to conmon afterwards for its side of the picture.
+ */
+
+#define _GNU_SOURCE
+
+#include <math.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/syscall.h>
+#include <sys/sysinfo.h>
+#include <time.h>
+#include <unistd.h>
+
+struct runner {
+	pthread_t thread;
+	double rate;
+	double seconds;
+	size_t n_samples;
+	size_t max_samples;
+	double *samples_us;
+};
+
+static double now(void)
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static void *run(void *arg)
+{
+	struct runner *r = arg;
+	struct sysinfo info;
+	double start = now();
+	double next = start;
+
+	while (r->n_samples < r->max_samples) {
+		double t0 = now();
+		if (t0 - start >= r->seconds)
+			break;
+		syscall(SYS_sysinfo, &info);
+		r->samples_us[r->n_samples++] = (now() - t0) * 1e6;
+
+		if (r->rate > 0) {
+			next += 1 / r->rate;
+			double wait = next - now();
+			if (wait > 0) {
+				struct timespec ts = {.tv_sec = (time_t)wait, .tv_nsec = (long)((wait - (time_t)wait) * 1e9)};
+				nanosleep(&ts, NULL);
+			}
+		}
+	}
+	return NULL;
+}
+
+static int cmp_double(const void *a, const void *b)
+{
+	double x = *(const double *)a, y = *(const double *)b;
+	return (x > y) - (x < y);
+}
+
+static double percentile(const double *sorted, size_t n, double p)
+{
+	size_t i = (size_t)ceil(p / 100 * n);
+	return sorted[i > 0 ? i - 1 : 0];
+}
+
+int main(int argc, char **argv)
+{
+	double rate = argc > 1 ? atof(argv[1]) : 0;
+	double seconds = argc > 2 ? atof(argv[2]) : 10;
+	int n_threads = argc > 3 ? atoi(argv[3]) : 1;
+
+	if (seconds <= 0 || n_threads <= 0) {
+		fprintf(stderr, "usage: %s [RATE [SECONDS [THREADS]]]\n", argv[0]);
+		return 2;
+	}
+
+	/* Without a rate limit, assume no better than a microsecond per call */
+	size_t max_samples = rate > 0 ? (size_t)(rate / n_threads * seconds) + 1 : (size_t)(seconds * 1e6);
+	struct runner *runners = calloc(n_threads, sizeof(*runners));
+	if (runners == NULL)
+		return 1;
+
+	double start = now();
+	for (int i = 0; i < n_threads; i++) {
+		runners[i].rate = rate / n_threads;
+		runners[i].seconds = seconds;
+		runners[i].max_samples = max_samples;
+		runners[i].samples_us = malloc(max_samples * sizeof(double));
+		if (runners[i].samples_us == NULL || pthread_create(&runners[i].thread, NULL, run, &runners[i]) != 0) {
+			perror("seccomp-bench");
+			return 1;
+		}
+	}
+
+	size_t n = 0;
+	for (int i = 0; i < n_threads; i++) {
+		pthread_join(runners[i].thread, NULL);
+		n += runners[i].n_samples;
+	}
+	double elapsed = now() - start;
+
+	double *all = malloc((n + 1) * sizeof(double));
+	if (all == NULL)
+		return 1;
+	size_t k = 0;
+	for (int i = 0; i < n_threads; i++) {
+		memcpy(all + k, runners[i].samples_us, runners[i].n_samples * sizeof(double));
+		k += runners[i].n_samples;
+	}
+	if (n == 0) {
+		fprintf(stderr, "no calls made\n");
+		return 1;
+	}
+	qsort(all, n, sizeof(double), cmp_double);
+
+	printf("calls %zu\nrate %.0f/s\np50_us %.1f\np99_us %.1f\np999_us %.1f\nmax_us %.1f\n", n, n / elapsed, percentile(all, n, 50),
+	       percentile(all, n, 99), percentile(all, n, 99.9), all[n - 1]);
+	return 0;
+}
@@ -0,0 +1,116 @@
+#!/usr/bin/env python3
+"""Client for conmon's zygote mode (conmon --zygote-socket).
+
+Start a container monitor through a running zygote, passing the current
+environment, working directory, standard streams and every _OCI_* fd:
+
+    zygote-client.py SOCKET -- CONMON-ARGS...
+
+Compare the time from request to the container pid on the sync pipe with a
+cold exec of conmon.  "{i}" in the arguments is replaced by the iteration
+number, so each run can use its own container id:
+
+    zygote-client.py SOCKET --bench 20 --conmon /usr/bin/conmon -- \\
+        --cid bench-{i} --cuuid bench-{i} --runtime /usr/bin/runc ...
+
+The containers created by a benchmark are left behind for the caller to
+clean up.
+"""
+
+import argparse
+import json
+import os
+import socket
+import statistics
+import subprocess
+import sys
+import time
+
+OCI_FD_PREFIX = "_OCI_"
+
+
+def send_request(path, args, fds, env=None, cwd=None):
+    """Send a request; fds maps names (stdin, _OCI_SYNCPIPE, ...) to fds."""
+    env = os.environ if env is None else env
+    fields = ["a" + a for a in args]
+    fields += ["e%s=%s" % (k, v) for k, v in env.items() if k not in fds]
+    fields.append("c" + (cwd or os.getcwd()))
+    fields += ["f" + name for name in fds]
+
+    with socket.socket(socket.AF_UNIX, socket.SOCK_SEQPACKET) as sock:
+        sock.connect(path)
+        sock.send(b"".join(f.encode() + b"\0" for f in fields))
+        for name, fd in fds.items():
+            socket.send_fds(sock, [name.encode() + b"\0"], [fd])
+        reply = int(sock.recv(32))
+    if reply < 0:
+        raise OSError(-reply, os.strerror(-reply))
+    return reply
+
+
+def inherited_fds():
+    fds = {"stdin": 0, "stdout": 1, "stderr": 2}
+    for name, value in os.environ.items():
+        if name.startswith(OCI_FD_PREFIX) and value.isdigit():
+            fds[name] = int(value)
+    return fds
+
+
+def wait_for_pid(read_fd):
+    """Read the first sync pipe message and return the time it arrived."""
+    with os.fdopen(read_fd, "r") as pipe:
+        line = pipe.readline()
+    end = time.monotonic()
+    msg = json.loads(line)
+    if msg.get("pid", msg.get("data", -1)) < 0:
+        raise RuntimeError("container failed to start: %s" % line.strip())
+    return end
+
+
+def bench_once(sock_path, conmon, args):
+    r, w = os.pipe()
+    env = dict(os.environ, _OCI_SYNCPIPE=str(w))
+    proc = None
+    start = time.monotonic()
+    if sock_path is None:
+        proc = subprocess.Popen([conmon] + args, env=env, pass_fds=[w], stdin=subprocess.DEVNULL)
+    else:
+        send_request(sock_path, args, {"stdin": 0, "stdout": 1, "stderr": 2, "_OCI_SYNCPIPE": w}, env=env)
+    os.close(w)
+    end = wait_for_pid(r)
+    if proc is not None:
+        proc.wait()
+    return end - start
+
+
+def bench(sock_path, conmon, args, runs):
+    results = {}
+    for label, path in (("cold", None), ("zygote", sock_path)):
+        samples = []
+        for i in range(runs):
+            run_args = [a.replace("{i}", "%s-%d" % (label, i)) for a in args]
+            samples.append(bench_once(path, conmon, run_args) * 1000)
+        results[label] = samples
+        print("%-6s n=%d median=%.2fms min=%.2fms max=%.2fms"
+              % (label, runs, statistics.median(samples), min(samples), max(samples)))
+    return results
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__, formatter_class=argparse.RawDescriptionHelpFormatter)
+    parser.add_argument("socket")
+    parser.add_argument("--bench", type=int, metavar="N", help="compare N cold and N zygote starts")
+    parser.add_argument("--conmon", default="conmon", help="conmon binary for the cold starts")
+    parser.add_argument("args", nargs=argparse.REMAINDER)
+    opts = parser.parse_args()
+
+    args = opts.args[1:] if opts.args[:1] == ["--"] else opts.args
+    if opts.bench:
+        bench(opts.socket, opts.conmon, args, opts.bench)
+    else:
+        print(send_request(opts.socket, args, inherited_fds()))
+    return 0
+
+
+if __name__ == "__main__":
+    sys.exit(main())
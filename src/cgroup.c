@@ -2,9 +2,11 @@
 
 #include "cgroup.h"
 #include "globals.h"
+#include "loop.h"
 #include "utils.h"
 #include "cli.h"
 #include "config.h"
+#include "events.h"
 
 #include <errno.h>
 #include <fcntl.h>
@@ -29,13 +31,23 @@ int oom_cgroup_fd = -1;
 
 #ifdef __linux__
 
+/* Kept open and re-read with pread() on every change. */
+static int memory_events_fd = -1;
+
+/* Unprivileged PSI triggers need a window that is a multiple of 2s. */
+#define PRESSURE_WINDOW_US 2000000
+static const char *const pressure_resources[] = {"memory", "cpu", "io"};
+
 static char *process_cgroup_subsystem_path(int pid, bool cgroup2, const char *subsystem);
 static void setup_oom_handling_cgroup_v2(int pid);
 static void setup_oom_handling_cgroup_v1(int pid);
 static gboolean oom_cb_cgroup_v2(int fd, GIOCondition condition, G_GNUC_UNUSED gpointer user_data);
 static gboolean oom_cb_cgroup_v1(int fd, GIOCondition condition, G_GNUC_UNUSED gpointer user_data);
+static void setup_pressure_triggers(void);
+static gboolean pressure_cb(int fd, GIOCondition condition, gpointer user_data);
 static int create_oom_files();
 static int create_oom_file(const char *base_path);
+static void create_pressure_file(const char *base_path, const char *resource, const char *contents);
 
 void setup_oom_handling(int pid)
 {
@@ -115,8 +127,14 @@ static void setup_oom_handling_cgroup_v2(int pid)
 		return;
 	}
 
+	setup_pressure_triggers();
+
 	_cleanup_free_ char *memory_events_file_path = g_build_filename(cgroup2_path, "memory.events", NULL);
 
+	memory_events_fd = open(memory_events_file_path, O_RDONLY | O_CLOEXEC);
+	if (memory_events_fd < 0)
+		nwarnf("Failed to open %s", memory_events_file_path);
+
 	_cleanup_close_ int ifd = -1;
 	if ((ifd = inotify_init()) < 0) {
 		nwarnf("Failed to create inotify fd");
@@ -132,7 +150,7 @@ static void setup_oom_handling_cgroup_v2(int pid)
 	inotify_fd = ifd;
 	ifd = -1;
 
-	g_unix_fd_add(inotify_fd, G_IO_IN, oom_cb_cgroup_v2, NULL);
+	loop_add_fd(inotify_fd, G_IO_IN, oom_cb_cgroup_v2, NULL);
 }
 
 static void setup_oom_handling_cgroup_v1(int pid)
@@ -173,7 +191,7 @@ static void setup_oom_handling_cgroup_v1(int pid)
 		return;
 	}
 
-	g_unix_fd_add(oom_event_fd, G_IO_IN, oom_cb_cgroup_v1, memory_cgroup_file_path);
+	loop_add_fd(oom_event_fd, G_IO_IN, oom_cb_cgroup_v1, memory_cgroup_file_path);
 }
 
 static gboolean oom_cb_cgroup_v2(int fd, GIOCondition condition, G_GNUC_UNUSED gpointer user_data)
@@ -198,7 +216,7 @@ static gboolean oom_cb_cgroup_v2(int fd, GIOCondition condition, G_GNUC_UNUSED g
 
 	if (ret == G_SOURCE_REMOVE) {
 		/* End of input */
-		close(fd);
+		loop_close_fd(fd);
 		inotify_fd = -1;
 	}
 
@@ -212,7 +230,7 @@ static gboolean oom_cb_cgroup_v1(int fd, GIOCondition condition, gpointer user_d
 	char *cgroup_event_control_path = (char *)user_data;
 	if ((condition & G_IO_IN) == 0) {
 		/* End of input */
-		close(fd);
+		loop_close_fd(fd);
 		oom_event_fd = -1;
 		g_free(cgroup_event_control_path);
 		return G_SOURCE_REMOVE;
@@ -244,7 +262,7 @@ static gboolean oom_cb_cgroup_v1(int fd, GIOCondition condition, gpointer user_d
 	}
 
 	if (num_read == 0) {
-		close(fd);
+		loop_close_fd(fd);
 		oom_event_fd = -1;
 		g_free(cgroup_event_control_path);
 		return G_SOURCE_REMOVE;
@@ -287,33 +305,52 @@ gboolean check_cgroup2_oom()
 		return G_SOURCE_REMOVE;
 	}
 
-	_cleanup_free_ char *memory_events_file_path = g_build_filename(cgroup2_path, "memory.events", NULL);
+	if (memory_events_fd < 0) {
+		_cleanup_free_ char *memory_events_file_path = g_build_filename(cgroup2_path, "memory.events", NULL);
 
-	_cleanup_fclose_ FILE *fp = fopen(memory_events_file_path, "re");
-	if (fp == NULL) {
-		nwarnf("Failed to open cgroups file: %s", memory_events_file_path);
-		/* If the file doesn't exist, the cgroup was likely removed */
-		if (errno == ENOENT) {
+		memory_events_fd = open(memory_events_file_path, O_RDONLY | O_CLOEXEC);
+		if (memory_events_fd < 0) {
+			nwarnf("Failed to open cgroups file: %s", memory_events_file_path);
+			/* If the file doesn't exist, the cgroup was likely removed */
+			if (errno == ENOENT) {
+				ndebugf("Cgroup appears to have been removed, stopping OOM monitoring");
+				return G_SOURCE_REMOVE;
+			}
+			return G_SOURCE_CONTINUE;
+		}
+	}
+
+	/* memory.events is a handful of short lines */
+	char buf[1024];
+	ssize_t num_read = pread(memory_events_fd, buf, sizeof(buf) - 1, 0);
+	if (num_read < 0) {
+		/* Files of a removed cgroup fail with ENODEV */
+		if (errno == ENODEV || errno == ENOENT) {
 			ndebugf("Cgroup appears to have been removed, stopping OOM monitoring");
 			return G_SOURCE_REMOVE;
 		}
+		nwarn("Failed to read memory.events");
 		return G_SOURCE_CONTINUE;
 	}
+	buf[num_read] = '\0';
 
-	_cleanup_free_ char *line = NULL;
-	size_t len = 0;
-	ssize_t read;
+	char *next = NULL;
 	gboolean oom_detected = FALSE;
-	while ((read = getline(&line, &len, fp)) != -1) {
+	for (char *line = buf; line != NULL && *line != '\0'; line = next) {
 		long int counter;
 		const size_t oom_len = 4, oom_kill_len = 9;
 		gboolean is_oom_kill = FALSE;
 		size_t prefix_len;
 
-		if ((size_t)read >= oom_kill_len + 2 && memcmp(line, "oom_kill ", oom_kill_len) == 0) {
+		next = strchr(line, '\n');
+		if (next != NULL)
+			*next++ = '\0';
+		size_t read = strlen(line);
+
+		if (read >= oom_kill_len + 1 && memcmp(line, "oom_kill ", oom_kill_len) == 0) {
 			prefix_len = oom_kill_len;
 			is_oom_kill = TRUE;
-		} else if ((size_t)read >= oom_len + 2 && memcmp(line, "oom ", oom_len) == 0) {
+		} else if (read >= oom_len + 1 && memcmp(line, "oom ", oom_len) == 0) {
 			prefix_len = oom_len;
 			is_oom_kill = FALSE;
 		} else {
@@ -345,6 +382,74 @@ gboolean check_cgroup2_oom()
 	return oom_detected ? G_SOURCE_CONTINUE : G_SOURCE_REMOVE;
 }
 
+/* Register a PSI trigger on each pressure file of the container's cgroup, so
+ * that stalls are reported while they build up instead of after the OOM kill. */
+static void setup_pressure_triggers(void)
+{
+	if (opt_pressure_stall <= 0)
+		return;
+
+	_cleanup_free_ char *trigger = g_strdup_printf("some %d %d", opt_pressure_stall * 1000, PRESSURE_WINDOW_US);
+	for (size_t i = 0; i < G_N_ELEMENTS(pressure_resources); i++) {
+		_cleanup_free_ char *file_name = g_strdup_printf("%s.pressure", pressure_resources[i]);
+		_cleanup_free_ char *path = g_build_filename(cgroup2_path, file_name, NULL);
+
+		int fd = open(path, O_RDWR | O_NONBLOCK | O_CLOEXEC);
+		if (fd < 0) {
+			nwarnf("Failed to open %s", path);
+			continue;
+		}
+		if (write(fd, trigger, strlen(trigger) + 1) < 0) {
+			nwarnf("Failed to register pressure trigger on %s", path);
+			close(fd);
+			continue;
+		}
+		loop_add_fd(fd, G_IO_PRI, pressure_cb, (gpointer)pressure_resources[i]);
+	}
+}
+
+/* user_data is the name of the resource the trigger fd belongs to */
+static gboolean pressure_cb(int fd, GIOCondition condition, gpointer user_data)
+{
+	const char *resource = user_data;
+
+	/* The trigger reports an error once the cgroup is gone */
+	if (condition & (G_IO_ERR | G_IO_HUP | G_IO_NVAL)) {
+		loop_close_fd(fd);
+		return G_SOURCE_REMOVE;
+	}
+
+	/* The file cannot be read either once the cgroup is removed */
+	char buf[256];
+	ssize_t num_read = pread(fd, buf, sizeof(buf) - 1, 0);
+	if (num_read < 0) {
+		ndebugf("Failed to read %s pressure, the cgroup was removed", resource);
+		loop_close_fd(fd);
+		return G_SOURCE_REMOVE;
+	}
+	buf[num_read] = '\0';
+
+	ninfof("%s pressure stall received", resource);
+	events_send_pressure(resource);
+	create_pressure_file(opt_persist_path, resource, buf);
+	create_pressure_file(opt_bundle_path, resource, buf);
+	return G_SOURCE_CONTINUE;
+}
+
+/* pressure-<resource> holds the pressure file as of the last stall */
+static void create_pressure_file(const char *base_path, const char *resource, const char *contents)
+{
+	_cleanup_gerror_ GError *err = NULL;
+
+	if (base_path == NULL || base_path[0] == '\0')
+		return;
+
+	_cleanup_free_ char *file_name = g_strdup_printf("pressure-%s", resource);
+	_cleanup_free_ char *path = g_build_filename(base_path, file_name, NULL);
+	if (!g_file_set_contents(path, contents, -1, &err))
+		nwarnf("Failed to write %s: %s", path, err->message);
+}
+
 /* create the appropriate files to tell the caller there was an oom event
  * this can be used for v1 and v2 OOMs
  * returns 0 on success, negative value on failure
@@ -352,6 +457,7 @@ gboolean check_cgroup2_oom()
 static int create_oom_files()
 {
 	ninfo("OOM received");
+	events_send_oom();
 	int r = 0;
 	r |= create_oom_file(opt_persist_path);
 	r |= create_oom_file(opt_bundle_path);
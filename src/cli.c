@@ -1,5 +1,6 @@
 #include "cli.h"
 #include "globals.h"
+#include "loop.h"
 #include "ctr_logging.h"
 #include "config.h"
 #include "utils.h"
@@ -42,6 +43,20 @@ char *opt_exit_dir = NULL;
 int opt_timeout = 0;
 int64_t opt_log_size_max = -1;
 int64_t opt_log_global_size_max = -1;
+int64_t opt_log_rate_bytes = 0;
+int64_t opt_log_rate_lines = 0;
+int opt_log_rate_burst = 1;
+int opt_log_rate_sample = 0;
+int64_t opt_log_writeback_bytes = 0;
+int opt_log_writeback_interval = 0;
+int64_t opt_log_spill_size = 1024 * 1024;
+int64_t opt_log_dedup = 0;
+gchar **opt_log_drop_patterns = NULL;
+int64_t opt_log_forward_buffer_size = 1024 * 1024;
+int opt_log_forward_flush_interval = 1000;
+char *opt_log_multiline_start = NULL;
+char *opt_log_multiline_continue = NULL;
+int opt_log_multiline_timeout = 500;
 char *opt_socket_path = DEFAULT_SOCKET_PATH;
 gboolean opt_no_new_keyring = FALSE;
 char *opt_exit_command = NULL;
@@ -58,6 +73,7 @@ char *opt_sdnotify_socket = NULL;
 gboolean opt_full_attach_path = FALSE;
 char *opt_seccomp_notify_socket = NULL;
 char *opt_seccomp_notify_plugins = NULL;
+int opt_seccomp_notify_threads = 1;
 gboolean opt_log_rotate = FALSE;
 int opt_log_max_files = 1;
 gchar **opt_log_allowlist_dirs = NULL;
@@ -67,6 +83,16 @@ int opt_healthcheck_interval = -1;
 int opt_healthcheck_timeout = -1;
 int opt_healthcheck_retries = -1;
 int opt_healthcheck_start_period = -1;
+char *opt_zygote_socket = NULL;
+char *opt_event_socket = NULL;
+gboolean opt_exec_sessions = FALSE;
+char *opt_runtime_library = NULL;
+gboolean opt_startup_trace = FALSE;
+int opt_timer_slack = 0;
+int opt_pressure_stall = 0;
+int opt_stats_interval = 0;
+gboolean opt_no_idle_wakeups = FALSE;
+gboolean opt_control_socket = FALSE;
 GOptionEntry opt_entries[] = {
 	{"api-version", 0, 0, G_OPTION_ARG_NONE, &opt_api_version, "Conmon API version to use", NULL},
 	{"bundle", 'b', 0, G_OPTION_ARG_STRING, &opt_bundle_path, "Location of the OCI Bundle path", NULL},
@@ -89,6 +115,36 @@ GOptionEntry opt_entries[] = {
 	{"log-path", 'l', 0, G_OPTION_ARG_STRING_ARRAY, &opt_log_path, "Log file path", NULL},
 	{"log-size-max", 0, 0, G_OPTION_ARG_INT64, &opt_log_size_max, "Maximum size of log file", NULL},
 	{"log-global-size-max", 0, 0, G_OPTION_ARG_INT64, &opt_log_global_size_max, "Maximum size of all log files", NULL},
+	{"log-dedup", 0, 0, G_OPTION_ARG_INT64, &opt_log_dedup,
+	 "Collapse repeats of a line and log their count at the latest this many seconds after the first one", NULL},
+	{"log-drop-pattern", 0, 0, G_OPTION_ARG_STRING_ARRAY, &opt_log_drop_patterns,
+	 "Do not log lines containing this string, or matching this regular expression if prefixed with re:.  Can be specified "
+	 "multiple times",
+	 NULL},
+	{"log-forward-buffer-size", 0, 0, G_OPTION_ARG_INT64, &opt_log_forward_buffer_size,
+	 "Bytes of logs queued for the forward log driver while the collector is away (default: 1048576)", NULL},
+	{"log-forward-flush-interval", 0, 0, G_OPTION_ARG_INT, &opt_log_forward_flush_interval,
+	 "Milliseconds after which queued lines are sent to the forward log driver (default: 1000)", NULL},
+	{"log-multiline-start", 0, 0, G_OPTION_ARG_STRING, &opt_log_multiline_start,
+	 "Send lines to journald as one entry up to the next line matching this regular expression", NULL},
+	{"log-multiline-continue", 0, 0, G_OPTION_ARG_STRING, &opt_log_multiline_continue,
+	 "Append lines matching this regular expression to the journald entry of the line before", NULL},
+	{"log-multiline-timeout", 0, 0, G_OPTION_ARG_INT, &opt_log_multiline_timeout,
+	 "Milliseconds without a new line after which a multiline journald entry is sent (default: 500)", NULL},
+	{"log-rate-bytes", 0, 0, G_OPTION_ARG_INT64, &opt_log_rate_bytes, "Maximum bytes per second logged for each of stdout and stderr",
+	 NULL},
+	{"log-rate-lines", 0, 0, G_OPTION_ARG_INT64, &opt_log_rate_lines, "Maximum lines per second logged for each of stdout and stderr",
+	 NULL},
+	{"log-rate-burst", 0, 0, G_OPTION_ARG_INT, &opt_log_rate_burst,
+	 "Seconds worth of --log-rate-bytes and --log-rate-lines that may be logged in a burst (default: 1)", NULL},
+	{"log-rate-sample", 0, 0, G_OPTION_ARG_INT, &opt_log_rate_sample, "Log one in this many lines over the rate limit instead of none",
+	 NULL},
+	{"log-writeback-bytes", 0, 0, G_OPTION_ARG_INT64, &opt_log_writeback_bytes,
+	 "Write the log file back to disk and drop it from the page cache every this many bytes", NULL},
+	{"log-writeback-interval", 0, 0, G_OPTION_ARG_INT, &opt_log_writeback_interval,
+	 "Write the log file back to disk and drop it from the page cache at the latest after this many seconds", NULL},
+	{"log-spill-size", 0, 0, G_OPTION_ARG_INT64, &opt_log_spill_size,
+	 "Bytes of logs held back in memory while the file system of the log file is full (default: 1048576)", NULL},
 	{"log-tag", 0, 0, G_OPTION_ARG_STRING, &opt_log_tag, "Additional tag to use for logging", NULL},
 	{"log-label", 0, 0, G_OPTION_ARG_STRING_ARRAY, &opt_log_labels,
 	 "Additional label to include in logs. Can be specified multiple times", NULL},
@@ -127,6 +183,8 @@ GOptionEntry opt_entries[] = {
 	 "Path to the socket where the seccomp notification fd is received", NULL},
 	{"seccomp-notify-plugins", 0, 0, G_OPTION_ARG_STRING, &opt_seccomp_notify_plugins,
 	 "Plugins to use for managing the seccomp notifications", NULL},
+	{"seccomp-notify-threads", 0, 0, G_OPTION_ARG_INT, &opt_seccomp_notify_threads,
+	 "Number of threads handling seccomp notifications (default: 1)", NULL},
 	{"log-rotate", 0, 0, G_OPTION_ARG_NONE, &opt_log_rotate, "Enable log rotation instead of truncation when log-size-max is reached",
 	 NULL},
 	{"log-max-files", 0, 0, G_OPTION_ARG_INT, &opt_log_max_files, "Number of backup log files to keep (default: 1)", NULL},
@@ -140,11 +198,98 @@ GOptionEntry opt_entries[] = {
 	 "Number of consecutive failures before marking unhealthy (default: 3)", NULL},
 	{"healthcheck-start-period", 0, 0, G_OPTION_ARG_INT, &opt_healthcheck_start_period,
 	 "Start period in seconds before healthchecks start counting failures (default: 0)", NULL},
+	{"zygote-socket", 0, 0, G_OPTION_ARG_STRING, &opt_zygote_socket,
+	 "Serve container start requests on this socket instead of monitoring a container", NULL},
+	{"exec-sessions", 0, 0, G_OPTION_ARG_NONE, &opt_exec_sessions, "Run exec sessions requested on the exec socket next to the attach socket",
+	 NULL},
+	{"runtime-library", 0, 0, G_OPTION_ARG_STRING, &opt_runtime_library,
+	 "Run the runtime through this library in the forked child instead of executing --runtime", NULL},
+	{"startup-trace", 0, 0, G_OPTION_ARG_NONE, &opt_startup_trace, "Write the time spent in each startup phase to the bundle directory",
+	 NULL},
+	{"pressure-stall", 0, 0, G_OPTION_ARG_INT, &opt_pressure_stall,
+	 "Report memory, CPU and IO pressure stalls of at least this many milliseconds in a 2 second window", NULL},
+	{"stats-interval", 0, 0, G_OPTION_ARG_INT, &opt_stats_interval,
+	 "Sample the container's cgroup every this many seconds into the stats file in the bundle directory", NULL},
+	{"timer-slack", 0, 0, G_OPTION_ARG_INT, &opt_timer_slack,
+	 "Milliseconds by which timer wakeups may be deferred to merge them with other wakeups", NULL},
+	{"no-idle-wakeups", 0, 0, G_OPTION_ARG_NONE, &opt_no_idle_wakeups,
+	 "Refuse options that would wake conmon up periodically while the container is idle (--healthcheck-cmd, --stats-interval)", NULL},
+	{"control-socket", 0, 0, G_OPTION_ARG_NONE, &opt_control_socket,
+	 "Accept runtime tuning and introspection commands on the control socket next to the attach socket", NULL},
+	{"event-socket", 0, 0, G_OPTION_ARG_STRING, &opt_event_socket, "Send container lifecycle events as datagrams to this socket",
+	 NULL},
 	{NULL, 0, 0, 0, NULL, NULL, NULL}};
 
+/* The values of the option globals before any command line was parsed */
+union option_value {
+	gboolean b;
+	int i;
+	gint64 i64;
+	gchar *s;
+	gchar **strv;
+};
+static union option_value option_defaults[G_N_ELEMENTS(opt_entries)];
+static gboolean option_defaults_saved = FALSE;
+
+static void save_option_defaults(void)
+{
+	for (size_t i = 0; opt_entries[i].long_name != NULL; i++) {
+		void *data = opt_entries[i].arg_data;
+		switch (opt_entries[i].arg) {
+		case G_OPTION_ARG_NONE:
+			option_defaults[i].b = *(gboolean *)data;
+			break;
+		case G_OPTION_ARG_INT:
+			option_defaults[i].i = *(int *)data;
+			break;
+		case G_OPTION_ARG_INT64:
+			option_defaults[i].i64 = *(gint64 *)data;
+			break;
+		case G_OPTION_ARG_STRING:
+			option_defaults[i].s = *(gchar **)data;
+			break;
+		case G_OPTION_ARG_STRING_ARRAY:
+			option_defaults[i].strv = *(gchar ***)data;
+			break;
+		default:
+			nexitf("Unexpected type of option --%s", opt_entries[i].long_name);
+		}
+	}
+	option_defaults_saved = TRUE;
+}
+
+void reset_cli_options(void)
+{
+	/* The parsed values are not freed: some defaults are string literals */
+	for (size_t i = 0; option_defaults_saved && opt_entries[i].long_name != NULL; i++) {
+		void *data = opt_entries[i].arg_data;
+		switch (opt_entries[i].arg) {
+		case G_OPTION_ARG_NONE:
+			*(gboolean *)data = option_defaults[i].b;
+			break;
+		case G_OPTION_ARG_INT:
+			*(int *)data = option_defaults[i].i;
+			break;
+		case G_OPTION_ARG_INT64:
+			*(gint64 *)data = option_defaults[i].i64;
+			break;
+		case G_OPTION_ARG_STRING:
+			*(gchar **)data = option_defaults[i].s;
+			break;
+		case G_OPTION_ARG_STRING_ARRAY:
+			*(gchar ***)data = option_defaults[i].strv;
+			break;
+		default:
+			break;
+		}
+	}
+}
 
 int initialize_cli(int argc, char *argv[])
 {
+	if (!option_defaults_saved)
+		save_option_defaults();
+
 	GOptionContext *context = g_option_context_new("- conmon utility");
 	g_option_context_add_main_entries(context, opt_entries, "conmon");
 
@@ -162,6 +307,10 @@ int initialize_cli(int argc, char *argv[])
 		exit(EXIT_SUCCESS);
 	}
 
+	/* The container options arrive with each request to the zygote. */
+	if (opt_zygote_socket)
+		return -1;
+
 	/* Validate log rotation parameters */
 	if (opt_log_max_files < 0) {
 		fprintf(stderr, "conmon: log-max-files must be non-negative, got %d\n", opt_log_max_files);
@@ -190,7 +339,7 @@ void process_cli()
 	set_conmon_logs(opt_log_level, opt_cid, opt_syslog, opt_log_tag);
 
 
-	main_loop = g_main_loop_new(NULL, FALSE);
+	loop_init();
 
 	if (opt_restore_path && opt_exec)
 		nexit("Cannot use 'exec' and 'restore' at the same time");
@@ -229,6 +378,58 @@ void process_cli()
 		opt_bundle_path = cwd;
 	}
 
+	if (opt_exec_sessions && opt_exec) {
+		nexit("Exec sessions are run by the container's conmon; --exec-sessions cannot be used with --exec");
+	}
+
+	if (opt_pressure_stall < 0 || opt_pressure_stall > 2000) {
+		nexit("Pressure stall must be between 0 and 2000 milliseconds");
+	}
+
+	if (opt_seccomp_notify_threads < 1 || opt_seccomp_notify_threads > 64) {
+		nexit("Seccomp notify threads must be between 1 and 64");
+	}
+
+	if (opt_stats_interval < 0) {
+		nexit("Stats interval must be greater than or equal to 0");
+	}
+
+	if (opt_log_rate_bytes < 0 || opt_log_rate_lines < 0 || opt_log_rate_sample < 0) {
+		nexit("Log rate limits must be greater than or equal to 0");
+	}
+
+	if (opt_log_writeback_bytes < 0 || opt_log_writeback_interval < 0) {
+		nexit("Log writeback settings must be greater than or equal to 0");
+	}
+
+	if (opt_log_spill_size < 0) {
+		nexit("Log spill size must be greater than or equal to 0");
+	}
+
+	if (opt_log_dedup < 0) {
+		nexit("Log dedup window must be greater than or equal to 0");
+	}
+
+	if (opt_log_forward_buffer_size < 4096) {
+		nexit("Log forward buffer size must be at least 4096 bytes");
+	}
+
+	if (opt_log_forward_flush_interval < 1) {
+		nexit("Log forward flush interval must be at least 1 millisecond");
+	}
+
+	if (opt_log_multiline_timeout < 1) {
+		nexit("Log multiline timeout must be at least 1 millisecond");
+	}
+
+	if (opt_log_rate_burst < 1) {
+		nexit("Log rate burst must be at least 1 second");
+	}
+
+	if (opt_timer_slack < 0) {
+		nexit("Timer slack must be greater than or equal to 0");
+	}
+
 	if (opt_exit_delay < 0) {
 		nexit("Delay before invoking exit command must be greater than or equal to 0");
 	}
@@ -244,10 +445,22 @@ void process_cli()
 		nwarnf("--no-container-partial-message has no effect without journald log driver");
 	}
 
+	if ((opt_log_multiline_start != NULL || opt_log_multiline_continue != NULL) && !logging_is_journald_enabled()) {
+		nwarnf("--log-multiline-start and --log-multiline-continue have no effect without journald log driver");
+	}
+
 	/* Validate healthcheck parameters - if any healthcheck options were provided without --healthcheck-cmd */
 	if (opt_healthcheck_cmd == NULL
 	    && (opt_healthcheck_interval != -1 || opt_healthcheck_timeout != -1 || opt_healthcheck_retries != -1
 		|| opt_healthcheck_start_period != -1 || opt_healthcheck_args != NULL)) {
 		nexit("Healthcheck parameters specified without --healthcheck-cmd. Please provide --healthcheck-cmd to enable healthcheck functionality.");
 	}
+
+	/* Healthchecks and stats sampling are the only periodic timers; everything else conmon waits for is an fd */
+	if (opt_no_idle_wakeups && opt_healthcheck_cmd != NULL) {
+		nexit("Healthchecks run periodically; --healthcheck-cmd cannot be used with --no-idle-wakeups");
+	}
+	if (opt_no_idle_wakeups && opt_stats_interval > 0) {
+		nexit("Stats are sampled periodically; --stats-interval cannot be used with --no-idle-wakeups");
+	}
 }
@@ -32,6 +32,20 @@ extern gchar **opt_log_path;
 extern char *opt_exit_dir;
 extern int opt_timeout;
 extern int64_t opt_log_size_max;
+extern int64_t opt_log_rate_bytes;
+extern int64_t opt_log_rate_lines;
+extern int opt_log_rate_burst;
+extern int opt_log_rate_sample;
+extern int64_t opt_log_writeback_bytes;
+extern int opt_log_writeback_interval;
+extern int64_t opt_log_spill_size;
+extern int64_t opt_log_dedup;
+extern gchar **opt_log_drop_patterns;
+extern int64_t opt_log_forward_buffer_size;
+extern int opt_log_forward_flush_interval;
+extern char *opt_log_multiline_start;
+extern char *opt_log_multiline_continue;
+extern int opt_log_multiline_timeout;
 extern char *opt_socket_path;
 extern gboolean opt_no_new_keyring;
 extern char *opt_exit_command;
@@ -47,6 +61,7 @@ extern gboolean opt_sync;
 extern char *opt_sdnotify_socket;
 extern char *opt_seccomp_notify_socket;
 extern char *opt_seccomp_notify_plugins;
+extern int opt_seccomp_notify_threads;
 extern gboolean opt_log_rotate;
 extern int opt_log_max_files;
 extern gchar **opt_log_allowlist_dirs;
@@ -56,10 +71,22 @@ extern int opt_healthcheck_interval;
 extern int opt_healthcheck_timeout;
 extern int opt_healthcheck_retries;
 extern int opt_healthcheck_start_period;
+extern char *opt_zygote_socket;
+extern char *opt_event_socket;
+extern gboolean opt_exec_sessions;
+extern char *opt_runtime_library;
+extern gboolean opt_startup_trace;
+extern int opt_timer_slack;
+extern int opt_pressure_stall;
+extern int opt_stats_interval;
+extern gboolean opt_no_idle_wakeups;
+extern gboolean opt_control_socket;
 extern GOptionEntry opt_entries[];
 extern gboolean opt_full_attach_path;
 
 int initialize_cli(int argc, char *argv[]);
+/* Put every option back to its default, before parsing another command line */
+void reset_cli_options(void);
 void process_cli();
 
 #endif // CLI_H
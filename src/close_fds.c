@@ -21,6 +21,7 @@
 #include "runtime_args.h"
 
 #include <sys/stat.h>
+#include <sys/syscall.h>
 
 #ifdef __FreeBSD__
 #define OPEN_FILES_DIR "/dev/fd"
@@ -86,11 +87,26 @@ void close_other_fds()
 	}
 }
 
+/* Forget the fds recorded at startup, once they have been closed, so that
+ * fds opened later under the same numbers are left alone. */
+void forget_other_fds()
+{
+	free(open_files_set);
+	open_files_set = NULL;
+	open_files_max_fd = 0;
+}
+
 void close_all_fds_ge_than(int firstfd)
 {
 	struct dirent *ent;
 	DIR *d;
 
+#ifdef __NR_close_range
+	/* One syscall instead of a directory scan, when the kernel has it. */
+	if (syscall(__NR_close_range, firstfd, ~0U, 0) == 0)
+		return;
+#endif
+
 	d = opendir(OPEN_FILES_DIR);
 	if (!d)
 		return;
@@ -109,3 +125,26 @@ void close_all_fds_ge_than(int firstfd)
 	}
 	closedir(d);
 }
+
+static void close_fd_range(int firstfd, int lastfd)
+{
+#ifdef __NR_close_range
+	if (syscall(__NR_close_range, firstfd, lastfd, 0) == 0)
+		return;
+#endif
+	for (int fd = firstfd; fd <= lastfd; fd++)
+		close(fd);
+}
+
+/* keep holds the fds to leave open, in ascending order */
+void close_all_fds_ge_than_except(int firstfd, const int *keep, size_t n_keep)
+{
+	for (size_t i = 0; i < n_keep; i++) {
+		if (keep[i] < firstfd)
+			continue;
+		if (keep[i] > firstfd)
+			close_fd_range(firstfd, keep[i] - 1);
+		firstfd = keep[i] + 1;
+	}
+	close_all_fds_ge_than(firstfd);
+}
@@ -1,2 +1,4 @@
 void close_other_fds();
+void forget_other_fds();
 void close_all_fds_ge_than(int firstfd);
+void close_all_fds_ge_than_except(int firstfd, const int *keep, size_t n_keep);
@@ -10,6 +10,7 @@
 #include "cgroup.h"
 #include "cli.h"
 #include "globals.h"
+#include "loop.h"
 #include "oom.h"
 #include "conn_sock.h"
 #include "ctrl.h"
@@ -21,6 +22,13 @@
 #include "seccomp_notify.h"
 #include "runtime_args.h"
 #include "healthcheck.h"
+#include "zygote.h"
+#include "events.h"
+#include "exec_session.h"
+#include "runtime_library.h"
+#include "trace.h"
+#include "stats.h"
+#include "control.h"
 
 #include <sys/stat.h>
 #include <locale.h>
@@ -35,10 +43,65 @@ static void disconnect_std_streams(int dev_null_r, int dev_null_w)
 		pexit("Failed to dup over stderr");
 }
 
+/* Build the healthcheck configuration from the command line. */
+static void build_healthcheck_config(healthcheck_config_t *config)
+{
+	memset(config, 0, sizeof(*config));
+
+	/* Parse healthcheck command and arguments into array */
+	/* Count total arguments: command + args + NULL terminator */
+	int argc = 1; // At least the command
+	if (opt_healthcheck_args != NULL) {
+		for (int i = 0; opt_healthcheck_args[i] != NULL; i++) {
+			argc++;
+		}
+	}
+
+	/* Allocate array for command and arguments */
+	config->test = calloc(argc + 1, sizeof(char *));
+	if (config->test == NULL) {
+		pexit("Failed to allocate memory for healthcheck command");
+	}
+
+	/* Copy command */
+	config->test[0] = strdup(opt_healthcheck_cmd);
+	if (config->test[0] == NULL) {
+		pexit("Failed to duplicate healthcheck command");
+	}
+
+	/* Copy arguments */
+	if (opt_healthcheck_args != NULL) {
+		for (int i = 0; opt_healthcheck_args[i] != NULL; i++) {
+			config->test[i + 1] = strdup(opt_healthcheck_args[i]);
+			if (config->test[i + 1] == NULL) {
+				/* Clean up on error */
+				for (int j = 0; j <= i; j++) {
+					free(config->test[j]);
+				}
+				free(config->test);
+				pexit("Failed to duplicate healthcheck argument");
+			}
+		}
+	}
+	config->test[argc] = NULL; /* NULL terminator */
+
+	/* Set healthcheck parameters from CLI, using defaults for -1 values */
+	config->enabled = true;
+	config->interval = opt_healthcheck_interval != -1 ? opt_healthcheck_interval : 30;
+	config->timeout = opt_healthcheck_timeout != -1 ? opt_healthcheck_timeout : 30;
+	config->retries = opt_healthcheck_retries != -1 ? opt_healthcheck_retries : 3;
+	/* First healthcheck runs immediately, then after 'interval' seconds.
+	 * Here we give a default of 10 seconds to allow container to fully initialize.
+	 * If the user knows the container will take less time to initialize, they can set the start_period to a lower value.
+	 */
+	config->start_period = opt_healthcheck_start_period != -1 ? opt_healthcheck_start_period : 10;
+}
+
 #define DEFAULT_UMASK 0022
 
 int main(int argc, char *argv[])
 {
+	trace_start();
 	setlocale(LC_ALL, "");
 	umask(DEFAULT_UMASK);
 	_cleanup_gerror_ GError *err = NULL;
@@ -52,7 +115,26 @@ int main(int argc, char *argv[])
 		exit(initialize_ec);
 	}
 
+	if (opt_zygote_socket) {
+		/* Only returns in a child that was handed a container to monitor. */
+		run_zygote(opt_zygote_socket, &argc, &argv);
+		/* The options of the zygote are not defaults for its containers */
+		reset_cli_options();
+		initialize_ec = initialize_cli(argc, argv);
+		if (initialize_ec >= 0) {
+			exit(initialize_ec);
+		}
+	}
+
 	process_cli();
+	trace_phase("cli parsed");
+
+	if (opt_timer_slack > 0)
+		loop_set_timer_slack(opt_timer_slack);
+
+	/* Load before forking, so no runtime child pays for it. */
+	if (opt_runtime_library)
+		runtime_library_load(opt_runtime_library);
 
 	attempt_oom_adjust(-1000);
 
@@ -115,6 +197,8 @@ int main(int argc, char *argv[])
 	/* Environment variables */
 	sync_pipe_fd = get_pipe_fd_from_env("_OCI_SYNCPIPE");
 
+	events_init(opt_event_socket);
+
 	if (opt_attach) {
 		attach_pipe_fd = get_pipe_fd_from_env("_OCI_ATTACHPIPE");
 		if (attach_pipe_fd < 0) {
@@ -179,7 +263,7 @@ int main(int argc, char *argv[])
 	}
 
 	if (opt_seccomp_notify_socket != NULL) {
-#ifdef USE_SECCOMP
+#ifndef USE_SECCOMP
 		pexit("seccomp support not present");
 #else
 		if (opt_seccomp_notify_plugins == NULL)
@@ -198,7 +282,11 @@ int main(int argc, char *argv[])
 
 	GPtrArray *runtime_argv = configure_runtime_args(csname);
 
-	/* Setup endpoint for attach */
+	/*
+	 * Setup endpoint for attach.  This exits on failure, so it comes before
+	 * the runtime is forked: afterwards it would leave a half-created
+	 * container behind.
+	 */
 	_cleanup_free_ char *attach_symlink_dir_path = NULL;
 	if (opt_bundle_path != NULL && !logging_is_passthrough()) {
 		attach_symlink_dir_path = setup_attach_socket();
@@ -212,6 +300,8 @@ int main(int argc, char *argv[])
 		}
 	}
 
+	trace_phase("endpoints ready");
+
 	sigset_t mask, oldmask;
 	if ((sigemptyset(&mask) < 0) || (sigaddset(&mask, SIGTERM) < 0) || (sigaddset(&mask, SIGQUIT) < 0) || (sigaddset(&mask, SIGINT) < 0)
 	    || sigprocmask(SIG_BLOCK, &mask, &oldmask) < 0)
@@ -293,7 +383,7 @@ int main(int argc, char *argv[])
 
 		// We don't want runc to be unkillable so we reset the oom_score_adj back to 0
 		reset_oom_adjust();
-		execv(g_ptr_array_index(runtime_argv, 0), (char **)runtime_argv->pdata);
+		exec_runtime(runtime_argv);
 		exit(127);
 	}
 
@@ -308,6 +398,17 @@ int main(int argc, char *argv[])
 	if (sigprocmask(SIG_SETMASK, &oldmask, NULL) < 0)
 		pexit("Failed to unblock signals");
 
+	trace_phase("runtime forked");
+
+	/*
+	 * Parsing the healthcheck command line cannot fail in a way that leaves
+	 * the runtime's create behind, so it overlaps with the create.
+	 */
+	healthcheck_config_t healthcheck_config;
+	memset(&healthcheck_config, 0, sizeof(healthcheck_config));
+	if (opt_healthcheck_cmd != NULL)
+		build_healthcheck_config(&healthcheck_config);
+
 	/* Map pid to its handler.  */
 	_cleanup_(hashtable_free_cleanup) GHashTable *pid_to_handler = g_hash_table_new(g_int_hash, g_int_equal);
 	g_hash_table_insert(pid_to_handler, (pid_t *)&create_pid, runtime_exit_cb);
@@ -320,7 +421,7 @@ int main(int argc, char *argv[])
 	int signal_fd = get_signal_descriptor();
 	if (signal_fd < 0)
 		pexit("Failed to create signalfd");
-	int signal_fd_tag = g_unix_fd_add(signal_fd, G_IO_IN, on_signalfd_cb, &data);
+	int signal_fd_tag = loop_add_fd(signal_fd, G_IO_IN, on_signalfd_cb, &data);
 
 	if (opt_exit_command)
 		atexit(do_exit_command);
@@ -336,16 +437,16 @@ int main(int argc, char *argv[])
 		close(workerfd_stderr);
 
 	if (seccomp_listener != NULL)
-		g_unix_fd_add(seccomp_socket_fd, G_IO_IN, seccomp_accept_cb, csname);
+		loop_add_fd(seccomp_socket_fd, G_IO_IN, seccomp_accept_cb, csname);
 
 	if (csname != NULL) {
-		g_unix_fd_add(console_socket_fd, G_IO_IN, terminal_accept_cb, csname);
+		loop_add_fd(console_socket_fd, G_IO_IN, terminal_accept_cb, csname);
 		/* Process any SIGCHLD we may have missed before the signal handler was in place.  */
 		if (!opt_exec || !opt_terminal || container_status < 0) {
 			GHashTable *exit_status_cache = g_hash_table_new_full(g_int_hash, g_int_equal, g_free, g_free);
 			data.exit_status_cache = exit_status_cache;
-			g_idle_add(check_child_processes_cb, &data);
-			g_main_loop_run(main_loop);
+			loop_add_idle(check_child_processes_cb, &data);
+			loop_run();
 		}
 	} else {
 		int ret;
@@ -363,6 +464,8 @@ int main(int argc, char *argv[])
 		}
 	}
 
+	trace_phase("runtime exited");
+
 	/* For exec operations, a non-zero runtime exit status reflects the exit status of the exec'd command,
 	 * which is expected behavior, not a runtime failure. Only treat non-zero exit as failure for create/run operations. */
 	if (!opt_exec && (!WIFEXITED(runtime_status) || WEXITSTATUS(runtime_status) != 0)) {
@@ -407,73 +510,27 @@ int main(int argc, char *argv[])
 	if ((opt_api_version >= 1 || !opt_exec) && sync_pipe_fd >= 0)
 		write_or_close_sync_fd(&sync_pipe_fd, container_pid, NULL);
 
-	/* Start healthcheck timers if healthcheck command is provided */
-	if (opt_healthcheck_cmd != NULL) {
-
-		healthcheck_config_t config;
-		memset(&config, 0, sizeof(config));
+	trace_phase("pid reported");
+	if (opt_startup_trace)
+		trace_write(opt_bundle_path);
 
-		/* Parse healthcheck command and arguments into array */
-		/* Count total arguments: command + args + NULL terminator */
-		int argc = 1; // At least the command
-		if (opt_healthcheck_args != NULL) {
-			for (int i = 0; opt_healthcheck_args[i] != NULL; i++) {
-				argc++;
-			}
-		}
-
-		/* Allocate array for command and arguments */
-		config.test = calloc(argc + 1, sizeof(char *));
-		if (config.test == NULL) {
-			pexit("Failed to allocate memory for healthcheck command");
-		}
-
-		/* Copy command */
-		config.test[0] = strdup(opt_healthcheck_cmd);
-		if (config.test[0] == NULL) {
-			pexit("Failed to duplicate healthcheck command");
-		}
-
-		/* Copy arguments */
-		if (opt_healthcheck_args != NULL) {
-			for (int i = 0; opt_healthcheck_args[i] != NULL; i++) {
-				config.test[i + 1] = strdup(opt_healthcheck_args[i]);
-				if (config.test[i + 1] == NULL) {
-					/* Clean up on error */
-					for (int j = 0; j <= i; j++) {
-						free(config.test[j]);
-					}
-					free(config.test);
-					pexit("Failed to duplicate healthcheck argument");
-				}
-			}
-		}
-		config.test[argc] = NULL; /* NULL terminator */
-
-		/* Set healthcheck parameters from CLI, using defaults for -1 values */
-		config.enabled = true;
-		config.interval = opt_healthcheck_interval != -1 ? opt_healthcheck_interval : 30;
-		config.timeout = opt_healthcheck_timeout != -1 ? opt_healthcheck_timeout : 30;
-		config.retries = opt_healthcheck_retries != -1 ? opt_healthcheck_retries : 3;
-		/* First healthcheck runs immediately, then after 'interval' seconds.
-		 * Here we give a default of 10 seconds to allow container to fully initialize.
-		 * If the user knows the container will take less time to initialize, they can set the start_period to a lower value.
-		 */
-		config.start_period = opt_healthcheck_start_period != -1 ? opt_healthcheck_start_period : 10;
+	events_send_start(container_pid);
 
+	/* Start healthcheck timers if healthcheck command is provided */
+	if (opt_healthcheck_cmd != NULL) {
 		/* Validate healthcheck configuration */
-		if (!healthcheck_validate_config(&config)) {
+		if (!healthcheck_validate_config(&healthcheck_config)) {
 			nwarnf("Invalid healthcheck configuration for container %s", opt_cid);
-			healthcheck_config_free(&config);
+			healthcheck_config_free(&healthcheck_config);
 			return 1;
 		}
 
-		healthcheck_timer_t *timer = healthcheck_timer_new(opt_cid, &config);
+		healthcheck_timer_t *timer = healthcheck_timer_new(opt_cid, &healthcheck_config);
 		if (timer != NULL) {
 			/* Start healthcheck with a 3-second delay to allow container to fully initialize in
 			   addition to the default of 10 seconds.
 			*/
-			if (g_timeout_add_seconds(3, healthcheck_delayed_start_callback, timer)) {
+			if (loop_add_timeout_seconds(3, healthcheck_delayed_start_callback, timer)) {
 				active_healthcheck_timer = timer;
 				ninfof("Scheduled healthcheck for container %s (will start after 3s delay)", opt_cid);
 			} else {
@@ -485,22 +542,24 @@ int main(int argc, char *argv[])
 		}
 
 		/* Always free the config, regardless of success or failure */
-		healthcheck_config_free(&config);
+		healthcheck_config_free(&healthcheck_config);
 	}
 
 #ifdef __linux__
 	setup_oom_handling(container_pid);
+	if (opt_stats_interval > 0)
+		stats_start(cgroup2_path, opt_bundle_path, opt_stats_interval);
 #endif
 
 	if (mainfd_stdout >= 0) {
-		g_unix_fd_add(mainfd_stdout, G_IO_IN, stdio_cb, GINT_TO_POINTER(STDOUT_PIPE));
+		loop_add_fd(mainfd_stdout, G_IO_IN, stdio_cb, GINT_TO_POINTER(STDOUT_PIPE));
 	}
 	if (mainfd_stderr >= 0) {
-		g_unix_fd_add(mainfd_stderr, G_IO_IN, stdio_cb, GINT_TO_POINTER(STDERR_PIPE));
+		loop_add_fd(mainfd_stderr, G_IO_IN, stdio_cb, GINT_TO_POINTER(STDERR_PIPE));
 	}
 
 	if (opt_timeout > 0) {
-		g_timeout_add_seconds(opt_timeout, timeout_cb, NULL);
+		loop_add_timeout_seconds(opt_timeout, timeout_cb, NULL);
 	}
 
 	if (data.exit_status_cache) {
@@ -519,6 +578,16 @@ int main(int argc, char *argv[])
 		data.exit_status_cache = NULL;
 	}
 
+	/* Get notified of the container exit even if it is not our child. */
+	if (container_pid > 0)
+		watch_container_pidfd(&data);
+
+	if (opt_exec_sessions)
+		setup_exec_sessions(pid_to_handler);
+
+	if (opt_control_socket)
+		setup_control_socket();
+
 	/* There are three cases we want to run this main loop:
 	   1. If we are using the legacy API
 	   2. if we are running create or restore
@@ -536,8 +605,8 @@ int main(int argc, char *argv[])
 		but will need to exit once all the i/o is read. This will be handled in stdio_cb above.
 	*/
 	if (opt_api_version < 1 || !opt_exec || !opt_terminal || container_status < 0) {
-		g_idle_add(check_child_processes_cb, &data);
-		g_main_loop_run(main_loop);
+		loop_add_idle(check_child_processes_cb, &data);
+		loop_run();
 	}
 
 #ifdef __linux__
@@ -550,6 +619,7 @@ int main(int argc, char *argv[])
 
 	if (!opt_no_sync_log)
 		sync_logs();
+	stop_log_drivers();
 
 	int exit_status = -1;
 	const char *exit_message = NULL;
@@ -572,12 +642,14 @@ int main(int argc, char *argv[])
 	}
 
 	/* Close down the signalfd */
-	g_source_remove(signal_fd_tag);
+	loop_remove(signal_fd_tag);
 	close(signal_fd);
 
 	/* Cleanup healthcheck timers */
 	healthcheck_cleanup();
 
+	stats_finish();
+
 	/*
 	 * Podman injects some fd's into the conmon process so that exposed ports are kept busy while
 	 * the container runs.  Close them before we notify the container exited, so that they can be
@@ -604,6 +676,8 @@ int main(int argc, char *argv[])
 		if (!g_file_set_contents(exit_file_path, status_str, -1, &err))
 			nexitf("Failed to write %s to exit file: %s", status_str, err->message);
 	}
+	events_send_exit(exit_status, timed_out);
+
 	if (seccomp_listener != NULL)
 		unlink(seccomp_listener);
 
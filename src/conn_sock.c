@@ -3,6 +3,7 @@
 #include "conn_sock.h"
 #include "ctr_exit.h"
 #include "globals.h"
+#include "loop.h"
 #include "utils.h"
 #include "config.h"
 #include "cli.h" // opt_stdin
@@ -226,11 +227,37 @@ char *setup_attach_socket(void)
 	if (listen(remote_attach_sock.fd, 10) == -1)
 		pexitf("Failed to listen on attach socket: %s/%s", symlink_dir_path, "attach");
 
-	g_unix_fd_add(remote_attach_sock.fd, G_IO_IN, attach_cb, &remote_attach_sock);
+	loop_add_fd(remote_attach_sock.fd, G_IO_IN, attach_cb, &remote_attach_sock);
 
 	return symlink_dir_path;
 }
 
+/* Returns the listening fd of the exec session socket, next to the attach socket. */
+int setup_exec_socket(void)
+{
+	struct remote_sock_s exec_sock = {.fd = -1};
+	_cleanup_free_ char *sock_path =
+		bind_unix_socket("exec", SOCK_SEQPACKET | SOCK_NONBLOCK | SOCK_CLOEXEC, 0700, &exec_sock, opt_full_attach_path);
+
+	if (listen(exec_sock.fd, 10) == -1)
+		pexitf("Failed to listen on exec socket: %s", sock_path);
+
+	return exec_sock.fd;
+}
+
+/* Returns the listening fd of the control socket, next to the attach socket. */
+int bind_control_socket(void)
+{
+	struct remote_sock_s control_sock = {.fd = -1};
+	_cleanup_free_ char *sock_path =
+		bind_unix_socket("control", SOCK_SEQPACKET | SOCK_NONBLOCK | SOCK_CLOEXEC, 0700, &control_sock, opt_full_attach_path);
+
+	if (listen(control_sock.fd, 10) == -1)
+		pexitf("Failed to listen on control socket: %s", sock_path);
+
+	return control_sock.fd;
+}
+
 void setup_notify_socket(char *socket_path)
 {
 	/* Connect to Host socket */
@@ -248,7 +275,7 @@ void setup_notify_socket(char *socket_path)
 	 * when compiling with clang */
 	char *symlink_dir_path =
 		bind_unix_socket("notify/notify.sock", SOCK_DGRAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0777, &remote_notify_sock, TRUE);
-	g_unix_fd_add(remote_notify_sock.fd, G_IO_IN | G_IO_HUP | G_IO_ERR, remote_sock_cb, &remote_notify_sock);
+	loop_add_fd(remote_notify_sock.fd, G_IO_IN | G_IO_HUP | G_IO_ERR, remote_sock_cb, &remote_notify_sock);
 
 	g_free(symlink_dir_path);
 }
@@ -390,7 +417,7 @@ static gboolean attach_cb(int fd, G_GNUC_UNUSED GIOCondition condition, gpointer
 		}
 		init_remote_sock(remote_sock, srcsock);
 		remote_sock->fd = new_fd;
-		g_unix_fd_add(remote_sock->fd, G_IO_IN | G_IO_HUP | G_IO_ERR, remote_sock_cb, remote_sock);
+		loop_add_fd(remote_sock->fd, G_IO_IN | G_IO_HUP | G_IO_ERR, remote_sock_cb, remote_sock);
 		g_ptr_array_add(remote_sock->dest->readers, remote_sock);
 		ndebugf("Accepted%s connection %d", SOCK_IS_CONSOLE(srcsock->sock_type) ? " console" : "", remote_sock->fd);
 	}
@@ -499,7 +526,7 @@ static gboolean terminate_remote_sock(struct remote_sock_s *sock)
 		// If we're terminating our STDIN holder, we need to close the FD too, based on the cmdline option
 		if (*(sock->dest->fd) >= 0 && opt_stdin) {
 			if (!opt_leave_stdin_open) {
-				close(*(sock->dest->fd));
+				loop_close_fd(*(sock->dest->fd));
 				*(sock->dest->fd) = -1;
 			} else {
 				ninfo("Not closing input");
@@ -528,7 +555,7 @@ static void remote_sock_shutdown(struct remote_sock_s *sock, int how)
 	}
 	if (!sock->writable && !sock->readable) {
 		ndebugf("Closing %d", sock->fd);
-		close(sock->fd);
+		loop_close_fd(sock->fd);
 		sock->fd = -1;
 		if (sock->dest->readers != NULL) {
 			g_ptr_array_remove(sock->dest->readers, sock);
@@ -547,7 +574,7 @@ static void write_to_local_sock(gpointer data, gpointer user_data)
 		*has_data = true;
 	else if (sock->data_ready) {
 		sock->data_ready = false;
-		g_unix_fd_add(sock->fd, G_IO_IN | G_IO_HUP | G_IO_ERR, remote_sock_cb, sock);
+		loop_add_fd(sock->fd, G_IO_IN | G_IO_HUP | G_IO_ERR, remote_sock_cb, sock);
 	}
 }
 
@@ -596,7 +623,7 @@ static void schedule_local_sock_write(struct local_sock_s *local_sock)
 	if (*(local_sock->fd) < 0)
 		return;
 
-	g_unix_fd_add(*(local_sock->fd), G_IO_OUT, local_sock_write_cb, local_sock);
+	loop_add_fd(*(local_sock->fd), G_IO_OUT, local_sock_write_cb, local_sock);
 }
 
 static void init_remote_sock(struct remote_sock_s *sock, struct remote_sock_s *src)
@@ -620,7 +647,7 @@ static void close_sock(gpointer data, G_GNUC_UNUSED gpointer user_data)
 		return;
 	struct remote_sock_s *sock = (struct remote_sock_s *)data;
 
-	close(sock->fd);
+	loop_close_fd(sock->fd);
 	sock->fd = -1;
 }
 
@@ -631,6 +658,6 @@ void close_all_readers()
 	g_ptr_array_foreach(local_mainfd_stdin.readers, close_sock, NULL);
 
 	if (remote_attach_sock.fd >= 0)
-		close(remote_attach_sock.fd);
+		loop_close_fd(remote_attach_sock.fd);
 	remote_attach_sock.fd = -1;
 }
@@ -50,6 +50,8 @@ struct local_sock_s {
 char *setup_console_socket(void);
 char *setup_seccomp_socket(const char *socket);
 char *setup_attach_socket(void);
+int setup_exec_socket(void);
+int bind_control_socket(void);
 void setup_notify_socket(char *);
 void schedule_main_stdin_write();
 void write_back_to_remote_consoles(char *buf, int len);
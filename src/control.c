@@ -0,0 +1,138 @@
+#define _GNU_SOURCE
+
+#include "control.h"
+#include "conn_sock.h"
+#include "ctr_logging.h"
+#include "loop.h"
+#include "utils.h"
+
+#include <errno.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+/*
+ * Control socket.
+ *
+ * With --control-socket conmon listens on the SOCK_SEQPACKET socket "control"
+ * next to the attach socket.  Unlike the ctl fifo it answers: every message a
+ * client sends is one command, and conmon replies with one message that starts
+ * with "ok" or "error: <reason>", followed by "<key> <value>" lines for get.
+ *
+ *   get                 current settings, buffer occupancy and counters
+ *   set <key> <value>   change a setting, see get for the keys
+ *   rotate              rotate (or truncate) the log file, like the ctl fifo
+ *   flush               sync the log file to disk
+ *   pause, resume       stop and restart logging; output is still read and
+ *                       counted as dropped, so the container never blocks
+ */
+
+#define CONTROL_MAX_REQUEST 4096
+
+static const char *const log_level_names[] = {"error", "warn", "info", "debug", "trace"};
+
+static void describe_log_level(GString *out)
+{
+	/* log_level_t starts at EXIT_LEVEL */
+	g_string_append_printf(out, "log-level %s\n", log_level_names[log_level - EXIT_LEVEL]);
+}
+
+static const char *set_log_level(const char *value)
+{
+	if (!parse_log_level(value, &log_level))
+		return "unknown log level";
+	return NULL;
+}
+
+static void handle_command(char *request, GString *reply)
+{
+	char *saveptr = NULL;
+	const char *cmd = strtok_r(request, " \n", &saveptr);
+	const char *error = NULL;
+
+	if (cmd == NULL) {
+		error = "empty request";
+	} else if (strcmp(cmd, "get") == 0) {
+		g_string_append(reply, "ok\n");
+		describe_log_level(reply);
+		describe_logging(reply);
+		return;
+	} else if (strcmp(cmd, "set") == 0) {
+		const char *key = strtok_r(NULL, " \n", &saveptr);
+		const char *value = strtok_r(NULL, " \n", &saveptr);
+
+		if (key == NULL || value == NULL)
+			error = "usage: set <key> <value>";
+		else if (strcmp(key, "log-level") == 0)
+			error = set_log_level(value);
+		else
+			error = set_logging_option(key, value);
+		if (error == NULL)
+			ninfof("Control socket: set %s to %s", key, value);
+	} else if (strcmp(cmd, "rotate") == 0) {
+		reopen_log_files();
+	} else if (strcmp(cmd, "flush") == 0) {
+		sync_logs();
+	} else if (strcmp(cmd, "pause") == 0) {
+		ninfo("Control socket: log capture paused");
+		pause_log_capture(TRUE);
+	} else if (strcmp(cmd, "resume") == 0) {
+		ninfo("Control socket: log capture resumed");
+		pause_log_capture(FALSE);
+	} else {
+		error = "unknown command";
+	}
+
+	if (error != NULL)
+		g_string_append_printf(reply, "error: %s\n", error);
+	else
+		g_string_append(reply, "ok\n");
+}
+
+static gboolean control_request_cb(int fd, GIOCondition condition, G_GNUC_UNUSED gpointer user_data)
+{
+	char request[CONTROL_MAX_REQUEST];
+
+	if (condition & G_IO_IN) {
+		ssize_t num_read = recv(fd, request, sizeof(request) - 1, MSG_TRUNC);
+		if (num_read < 0 && (errno == EAGAIN || errno == EINTR))
+			return G_SOURCE_CONTINUE;
+		if (num_read > 0) {
+			GString *reply = g_string_new(NULL);
+
+			if ((size_t)num_read >= sizeof(request)) {
+				g_string_append(reply, "error: request too long\n");
+			} else {
+				request[num_read] = '\0';
+				handle_command(request, reply);
+			}
+			if (send(fd, reply->str, reply->len, MSG_NOSIGNAL) < 0)
+				nwarn("Failed to reply on the control socket");
+			g_string_free(reply, TRUE);
+			return G_SOURCE_CONTINUE;
+		}
+	}
+
+	/* EOF, or the client went away */
+	loop_close_fd(fd);
+	return G_SOURCE_REMOVE;
+}
+
+static gboolean control_accept_cb(int fd, G_GNUC_UNUSED GIOCondition condition, G_GNUC_UNUSED gpointer user_data)
+{
+	int conn = accept4(fd, NULL, NULL, SOCK_NONBLOCK | SOCK_CLOEXEC);
+	if (conn < 0) {
+		if (errno != EWOULDBLOCK)
+			nwarn("Failed to accept client connection on control socket");
+		return G_SOURCE_CONTINUE;
+	}
+
+	loop_add_fd(conn, G_IO_IN | G_IO_HUP | G_IO_ERR, control_request_cb, NULL);
+	return G_SOURCE_CONTINUE;
+}
+
+void setup_control_socket(void)
+{
+	int fd = bind_control_socket();
+	loop_add_fd(fd, G_IO_IN, control_accept_cb, NULL);
+}
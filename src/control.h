@@ -0,0 +1,6 @@
+#if !defined(CONTROL_H)
+#define CONTROL_H
+
+void setup_control_socket(void);
+
+#endif // CONTROL_H
@@ -5,9 +5,13 @@
 #include "utils.h"
 #include "parent_pipe_fd.h"
 #include "globals.h"
+#include "loop.h"
 #include "ctr_logging.h"
 #include "close_fds.h"
 #include "oom.h"
+#include "spawn.h"
+#include "exec_session.h"
+#include "seccomp_notify.h"
 
 #include <errno.h>
 #include <glib.h>
@@ -19,6 +23,9 @@
 volatile sig_atomic_t container_pid = -1;
 volatile sig_atomic_t create_pid = -1;
 
+/* pidfd of container_pid while it is watched by the loop, otherwise -1 */
+static int container_pidfd = -1;
+
 void on_sig_exit(int signal)
 {
 	if (container_pid > 0) {
@@ -46,7 +53,13 @@ static void check_child_processes(GHashTable *pid_to_handler, GHashTable *cache)
 			continue;
 
 		if (pid < 0 && errno == ECHILD) {
-			/* Before quitting, check if container_pid is still alive.
+			/* The pidfd source reports the exit of a container that is
+			 * not our child, so there is nothing to probe for. */
+			if (container_pid > 0 && container_pidfd >= 0) {
+				ninfof("Container process %d is not a direct child, waiting on its pidfd", container_pid);
+				return;
+			}
+			/* Without a pidfd, check if container_pid is still alive.
 			 * In some systemd configurations, the container process may not be
 			 * a direct child, so we won't receive SIGCHLD when it exits.
 			 * Use kill(pid, 0) to check if the process still exists. */
@@ -65,7 +78,7 @@ static void check_child_processes(GHashTable *pid_to_handler, GHashTable *cache)
 					/* Fall through to quit the main loop */
 				}
 			}
-			g_main_loop_quit(main_loop);
+			loop_quit();
 			return;
 		}
 		if (pid < 0)
@@ -86,6 +99,8 @@ static void check_child_processes(GHashTable *pid_to_handler, GHashTable *cache)
 			*k = pid;
 			*v = status;
 			g_hash_table_insert(cache, k, v);
+		} else {
+			exec_sessions_unclaimed_exit(pid, status);
 		}
 	}
 }
@@ -102,17 +117,50 @@ gboolean on_signalfd_cb(gint fd, G_GNUC_UNUSED GIOCondition condition, gpointer
 	struct pid_check_data *data = (struct pid_check_data *)user_data;
 
 	/* drop the signal from the signalfd */
-	drop_signal_event(fd);
+	if (drop_signal_event(fd) == SIGUSR2) {
+		seccomp_notify_dump_stats();
+		return G_SOURCE_CONTINUE;
+	}
 
 	check_child_processes(data->pid_to_handler, data->exit_status_cache);
 	return G_SOURCE_CONTINUE;
 }
 
+static gboolean container_pidfd_cb(int fd, G_GNUC_UNUSED GIOCondition condition, gpointer user_data)
+{
+	struct pid_check_data *data = (struct pid_check_data *)user_data;
+
+	/* If the container is our child this reaps it and reports the real status. */
+	check_child_processes(data->pid_to_handler, data->exit_status_cache);
+
+	if (container_pid > 0) {
+		/* Only the parent can collect the exit status of a process. */
+		ninfof("Container process %d has exited (not a direct child, exit status unknown)", container_pid);
+		container_status = 0;
+		container_pid = -1;
+		loop_quit();
+	}
+
+	container_pidfd = -1;
+	loop_close_fd(fd);
+	return G_SOURCE_REMOVE;
+}
+
+void watch_container_pidfd(struct pid_check_data *data)
+{
+	container_pidfd = open_pidfd(container_pid);
+	if (container_pidfd < 0) {
+		ndebugf("Cannot get a pidfd for container process %d: %m", container_pid);
+		return;
+	}
+	loop_add_fd(container_pidfd, G_IO_IN, container_pidfd_cb, data);
+}
+
 gboolean timeout_cb(G_GNUC_UNUSED gpointer user_data)
 {
 	timed_out = TRUE;
 	ninfo("Timed out, killing main loop");
-	g_main_loop_quit(main_loop);
+	loop_quit();
 	return G_SOURCE_REMOVE;
 }
 
@@ -129,7 +177,7 @@ void runtime_exit_cb(G_GNUC_UNUSED GPid pid, int status, G_GNUC_UNUSED gpointer
 {
 	runtime_status = status;
 	create_pid = -1;
-	g_main_loop_quit(main_loop);
+	loop_quit();
 }
 
 void container_exit_cb(G_GNUC_UNUSED GPid pid, int status, G_GNUC_UNUSED gpointer user_data)
@@ -149,7 +197,7 @@ void container_exit_cb(G_GNUC_UNUSED GPid pid, int status, G_GNUC_UNUSED gpointe
 		return;
 	}
 
-	g_main_loop_quit(main_loop);
+	loop_quit();
 }
 
 void do_exit_command()
@@ -173,33 +221,6 @@ void do_exit_command()
 		nwarn("Failed to disable self subreaper attribute - might wait for indirect children a long time");
 	}
 
-	pid_t exit_pid = fork();
-	if (exit_pid < 0) {
-		_pexit("Failed to fork");
-	}
-
-	if (exit_pid) {
-		int ret, exit_status = 0;
-
-		/*
-		 * Make sure to cleanup any zombie process that the container runtime
-		 * could have left around.
-		 */
-		do {
-			int tmp;
-
-			exit_status = 0;
-			ret = waitpid(-1, &tmp, 0);
-			if (ret == exit_pid)
-				exit_status = get_exit_status(tmp);
-		} while ((ret < 0 && errno == EINTR) || ret > 0);
-
-		if (exit_status)
-			_exit(exit_status);
-
-		return;
-	}
-
 	/* Count the additional args, if any.  */
 	size_t n_args = 0;
 	if (opt_exit_args)
@@ -219,12 +240,33 @@ void do_exit_command()
 		sleep(opt_exit_delay);
 	}
 
+	/* conmon is on its way out, so the exit command can simply inherit the
+	 * original score instead of conmon's. */
 	reset_oom_adjust();
 
-	execv(opt_exit_command, args);
+	pid_t exit_pid = spawn_process(args, NULL, FALSE, NULL);
+	g_free(args);
+	if (exit_pid < 0) {
+		_pexit("Failed to spawn the exit command");
+	}
 
-	/* Should not happen, but better be safe. */
-	_exit(EXIT_FAILURE);
+	int ret, exit_status = 0;
+
+	/*
+	 * Make sure to cleanup any zombie process that the container runtime
+	 * could have left around.
+	 */
+	do {
+		int tmp;
+
+		exit_status = 0;
+		ret = waitpid(-1, &tmp, 0);
+		if (ret == exit_pid)
+			exit_status = get_exit_status(tmp);
+	} while ((ret < 0 && errno == EINTR) || ret > 0);
+
+	if (exit_status)
+		_exit(exit_status);
 }
 
 void reap_children()
@@ -17,6 +17,7 @@ struct pid_check_data {
 void on_sig_exit(int signal);
 void container_exit_cb(G_GNUC_UNUSED GPid pid, int status, G_GNUC_UNUSED gpointer user_data);
 gboolean check_child_processes_cb(gpointer user_data);
+void watch_container_pidfd(struct pid_check_data *data);
 gboolean on_signalfd_cb(gint fd, GIOCondition condition, gpointer user_data);
 gboolean timeout_cb(G_GNUC_UNUSED gpointer user_data);
 int get_exit_status(int status);
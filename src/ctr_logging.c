@@ -2,7 +2,13 @@
 #include "ctr_logging.h"
 #include "cli.h"
 #include "config.h"
+#include "log_plugin.h"
+#include "log_ring.h"
+#include "log_forward.h"
+#include "loop.h"
+#include "multimatch.h"
 #include <ctype.h>
+#include <stdarg.h>
 #include <string.h>
 #include <sys/stat.h>
 #include <limits.h>
@@ -33,6 +39,18 @@ static gboolean use_logging_passthrough = FALSE;
 /* Value the user must input for each log driver */
 static const char *const K8S_FILE_STRING = "k8s-file";
 static const char *const JOURNALD_FILE_STRING = "journald";
+static const char *const PLUGIN_PREFIX = "plugin:";
+static const char *const RING_STRING = "ring";
+static const char *const FORWARD_PREFIX = "forward:";
+
+/* --log-path ring[:<size>], 0 if there is no ring */
+static uint64_t log_ring_size = 0;
+
+/* --log-path forward:<socket> */
+static const char *log_forward_path = NULL;
+
+/* --log-path plugin:<so>[:<config>], loaded once the container ID is known */
+static GPtrArray *log_plugin_specs = NULL;
 
 /* Max log size for any log file types */
 static int64_t log_size_max = -1;
@@ -40,12 +58,55 @@ static int64_t log_size_max = -1;
 /* Max total log size for any log file types */
 static int64_t log_global_size_max = -1;
 
+/* Per-stream rate limit, 0 if unlimited; see rate_limit_line */
+static int64_t log_rate_bytes = 0;
+static int64_t log_rate_lines = 0;
+
+/* --log-drop-pattern, NULL if none */
+static struct multimatch *drop_patterns = NULL;
+
+/* Seconds for which repeats of a line are collapsed, 0 if off; see dedup_line */
+static int64_t log_dedup = 0;
+
+/* journald multiline aggregation, off if both are NULL */
+static GRegex *multiline_start_re = NULL;
+static GRegex *multiline_continue_re = NULL;
+#define MULTILINE_MAX (64 * 1024)
+
 /* k8s log file parameters */
 static int k8s_log_fd = -1;
 static char *k8s_log_path = NULL;
 static int64_t k8s_bytes_written;
 static int64_t k8s_total_bytes_written;
 
+/*
+ * Write-behind of the k8s log file, off if both are 0; see k8s_writeback.
+ * Bytes of the file before writeback_start have been submitted to the disk,
+ * bytes before writeback_done are on it and dropped from the page cache.
+ */
+static int64_t writeback_bytes = 0;
+static int writeback_interval = 0;
+static int64_t writeback_start = 0;
+static int64_t writeback_done = 0;
+static guint writeback_timer = 0;
+
+/*
+ * Degraded mode of the k8s log file while its file system is full, see
+ * k8s_spill.  Output is held back in k8s_spill_buf up to k8s_spill_size and
+ * written out by a timer; what does not fit is counted in k8s_bytes_lost.
+ */
+#define DISK_FULL_RETRY_MIN 1
+#define DISK_FULL_RETRY_MAX 30
+static int64_t k8s_spill_size = 0;
+static gboolean k8s_degraded = FALSE;
+static gboolean k8s_spill_full = FALSE;
+static GString *k8s_spill_buf = NULL;
+static guint64 k8s_bytes_lost = 0;
+static guint64 k8s_total_bytes_lost = 0;
+static guint k8s_retry_timer = 0;
+static guint k8s_retry_interval = 0;
+static char k8s_last_byte = '\n'; /* last byte written to the log file */
+
 /* journald log file parameters */
 // short ID length
 #define TRUNC_ID_LEN 12
@@ -77,6 +138,70 @@ static size_t container_tag_len;
 static char *syslog_identifier = NULL;
 static size_t syslog_identifier_len;
 
+/* Per-stream state of the log drivers.  Everything that has to survive
+ * between two reads of the same container stream lives here rather than in
+ * function-local statics, so it can be found, flushed and reset in one place. */
+struct log_stream {
+	/* journald: start of a line that has not been terminated yet */
+	char journald_partial_buf[STDIO_BUF_SIZE];
+	size_t journald_partial_buf_len;
+	/* k8s-file: the last entry written was a partial (P) one */
+	bool k8s_has_partial;
+	/* counters reported on the control socket */
+	uint64_t bytes_read;
+	uint64_t bytes_dropped;
+
+	/* filter stages: the line being read started in an earlier read, and
+	 * whether its head was let through */
+	bool in_line;
+	bool line_passes;
+	/* lines generated by the filter stages, written before the next line */
+	GString *markers;
+
+	/* lines matching --log-drop-pattern */
+	uint64_t lines_filtered;
+	uint64_t bytes_filtered;
+
+	/* rate limit: tokens left in the buckets and when they were refilled */
+	double rate_bytes_tokens;
+	double rate_lines_tokens;
+	gint64 rate_refilled_at;
+	/* lines over the limit since the buckets ran dry, for sampling */
+	uint64_t rate_overflow;
+	/* suppressed since the last marker, and in total */
+	uint64_t rate_pending_lines;
+	uint64_t rate_pending_bytes;
+	uint64_t lines_suppressed;
+	uint64_t bytes_suppressed;
+
+	/* dedup: the last complete line let through, and how often it has been
+	 * repeated since */
+	char dedup_line[STDIO_BUF_SIZE];
+	size_t dedup_len;
+	guint32 dedup_hash;
+	uint64_t dedup_repeats;
+	guint dedup_timer;
+	uint64_t lines_deduplicated;
+
+	/* journald multiline: entry being aggregated, see journald_add_multiline */
+	GString *multiline;
+	int multiline_priority;
+	gint64 multiline_last_line;
+	guint multiline_timer;
+	uint64_t multiline_lines;
+};
+
+/* Set on the control socket: output is read but not logged */
+static gboolean log_capture_paused = FALSE;
+
+static struct log_stream stdout_stream;
+static struct log_stream stderr_stream;
+
+static struct log_stream *log_stream_for(stdpipe_t pipe)
+{
+	return pipe == STDERR_PIPE ? &stderr_stream : &stdout_stream;
+}
+
 #define WRITEV_BUFFER_N_IOV 128
 
 typedef struct {
@@ -86,6 +211,8 @@ typedef struct {
 
 static void parse_log_path(char *log_config);
 static const char *stdpipe_name(stdpipe_t pipe);
+static bool write_to_sinks(stdpipe_t pipe, char *buf, ssize_t num_read);
+static bool filter_and_write(stdpipe_t pipe, char *buf, ssize_t num_read);
 static int write_journald(int pipe, char *buf, ssize_t num_read);
 static int write_k8s_log(stdpipe_t pipe, const char *buf, ssize_t buflen);
 static bool get_line_len(ptrdiff_t *line_len, const char *buf, ssize_t buflen);
@@ -136,6 +263,16 @@ static int is_valid_label_name(const char *str)
 	return 1;
 }
 
+static GRegex *compile_multiline_regex(const char *option, const char *pattern)
+{
+	_cleanup_gerror_ GError *err = NULL;
+
+	GRegex *re = g_regex_new(pattern, G_REGEX_OPTIMIZE, 0, &err);
+	if (re == NULL)
+		nexitf("Invalid %s pattern: %s", option, err->message);
+	return re;
+}
+
 /*
  * configures container log specific information, such as the drivers the user
  * called with and the max log size for log file types. For the log file types
@@ -147,11 +284,32 @@ void configure_log_drivers(gchar **log_drivers, int64_t log_size_max_, int64_t l
 {
 	log_size_max = log_size_max_;
 	log_global_size_max = log_global_size_max_;
+	log_rate_bytes = opt_log_rate_bytes;
+	log_rate_lines = opt_log_rate_lines;
+	log_dedup = opt_log_dedup;
+	writeback_bytes = opt_log_writeback_bytes;
+	writeback_interval = opt_log_writeback_interval;
+	k8s_spill_size = opt_log_spill_size;
+	if (opt_log_drop_patterns != NULL) {
+		_cleanup_gerror_ GError *err = NULL;
+		drop_patterns = multimatch_new(opt_log_drop_patterns, &err);
+		if (drop_patterns == NULL)
+			nexitf("Invalid --log-drop-pattern: %s", err->message);
+	}
 	if (log_drivers == NULL)
 		nexit("Log driver not provided. Use --log-path");
 	for (int driver = 0; log_drivers[driver]; ++driver) {
 		parse_log_path(log_drivers[driver]);
 	}
+	for (guint i = 0; log_plugin_specs != NULL && i < log_plugin_specs->len; i++)
+		log_plugin_load(g_ptr_array_index(log_plugin_specs, i), cuuid_, name_);
+	if (log_ring_size > 0) {
+		if (opt_bundle_path == NULL)
+			nexit("The ring log driver needs the bundle directory");
+		log_ring_open(cuuid_, opt_socket_path, opt_bundle_path, log_ring_size);
+	}
+	if (log_forward_path != NULL)
+		log_forward_open(log_forward_path, opt_log_forward_flush_interval, opt_log_forward_buffer_size);
 	if (use_k8s_logging) {
 		/* Open the log path file. */
 		k8s_log_fd = open(k8s_log_path, O_WRONLY | O_APPEND | O_CREAT | O_CLOEXEC, 0640);
@@ -166,6 +324,8 @@ void configure_log_drivers(gchar **log_drivers, int64_t log_size_max_, int64_t l
 			k8s_bytes_written = 0;
 		}
 		k8s_total_bytes_written = k8s_bytes_written;
+		/* Whatever was in the file before is not ours to write back */
+		writeback_start = writeback_done = k8s_bytes_written;
 
 		if (!use_journald_logging) {
 			if (tag) {
@@ -216,6 +376,11 @@ void configure_log_drivers(gchar **log_drivers, int64_t log_size_max_, int64_t l
 			syslog_identifier = g_strdup_printf("SYSLOG_IDENTIFIER=%s", tag);
 			syslog_identifier_len = strlen(syslog_identifier);
 		}
+		if (opt_log_multiline_start != NULL)
+			multiline_start_re = compile_multiline_regex("--log-multiline-start", opt_log_multiline_start);
+		if (opt_log_multiline_continue != NULL)
+			multiline_continue_re = compile_multiline_regex("--log-multiline-continue", opt_log_multiline_continue);
+
 		if (log_labels) {
 			container_labels = log_labels;
 
@@ -247,6 +412,23 @@ void configure_log_drivers(gchar **log_drivers, int64_t log_size_max_, int64_t l
  */
 static void parse_log_path(char *log_config)
 {
+	/* The plugin config may contain colons of its own, keep it whole */
+	if (g_str_has_prefix(log_config, PLUGIN_PREFIX)) {
+		if (log_plugin_specs == NULL)
+			log_plugin_specs = g_ptr_array_new();
+		g_ptr_array_add(log_plugin_specs, log_config + strlen(PLUGIN_PREFIX));
+		return;
+	}
+	/* Socket paths may contain colons too */
+	if (g_str_has_prefix(log_config, FORWARD_PREFIX)) {
+		if (log_forward_path != NULL)
+			nexit("Only one forward log driver is supported");
+		log_forward_path = log_config + strlen(FORWARD_PREFIX);
+		if (*log_forward_path == '\0')
+			nexit("forward requires the path of a unix socket");
+		return;
+	}
+
 	const char *delim = strchr(log_config, ':');
 	char *driver = strtok(log_config, ":");
 	char *path = strtok(NULL, ":");
@@ -267,6 +449,18 @@ static void parse_log_path(char *log_config)
 		return;
 	}
 
+	if (!strcmp(driver, RING_STRING)) {
+		char *end = NULL;
+
+		log_ring_size = LOG_RING_DEFAULT_SIZE;
+		if (path != NULL) {
+			log_ring_size = g_ascii_strtoull(path, &end, 10);
+			if (end == path || *end != '\0' || log_ring_size == 0 || log_ring_size > LOG_RING_MAX_SIZE)
+				nexitf("Invalid ring size %s", path);
+		}
+		return;
+	}
+
 	if (!strcmp(driver, "passthrough")) {
 		use_logging_passthrough = TRUE;
 		return;
@@ -297,8 +491,29 @@ static void parse_log_path(char *log_config)
 	nexitf("No such log driver %s", driver);
 }
 
+static bool log_filters_enabled(void)
+{
+	return drop_patterns != NULL || log_rate_bytes > 0 || log_rate_lines > 0 || log_dedup > 0;
+}
+
 /* write container output to all logs the user defined */
 bool write_to_logs(stdpipe_t pipe, char *buf, ssize_t num_read)
+{
+	struct log_stream *stream = log_stream_for(pipe);
+
+	stream->bytes_read += num_read;
+	/* The drain still goes through, to finish a line started before the pause */
+	if (log_capture_paused && num_read > 0) {
+		stream->bytes_dropped += num_read;
+		return true;
+	}
+
+	if (log_filters_enabled())
+		return filter_and_write(pipe, buf, num_read);
+	return write_to_sinks(pipe, buf, num_read);
+}
+
+static bool write_to_sinks(stdpipe_t pipe, char *buf, ssize_t num_read)
 {
 	if (use_k8s_logging && write_k8s_log(pipe, buf, num_read) < 0) {
 		nwarn("write_k8s_log failed");
@@ -308,9 +523,260 @@ bool write_to_logs(stdpipe_t pipe, char *buf, ssize_t num_read)
 		nwarn("write_journald failed");
 		return G_SOURCE_CONTINUE;
 	}
+	if (log_ring_is_open())
+		log_ring_write(pipe, buf, num_read);
+	if (log_forward_is_open() && num_read > 0) {
+		char tsbuf[TSBUFLEN];
+		set_k8s_timestamp(tsbuf, sizeof tsbuf, stdpipe_name(pipe));
+		log_forward_write(tsbuf, buf, num_read);
+	}
+	if (log_plugins_loaded() && log_plugins_write(pipe, buf, num_read) < 0) {
+		nwarn("log_plugins_write failed");
+		return G_SOURCE_CONTINUE;
+	}
+	return true;
+}
+
+/* Queue a line to be logged in front of the next line that is let through. */
+static void G_GNUC_PRINTF(2, 3) queue_marker(struct log_stream *stream, const char *fmt, ...)
+{
+	va_list ap;
+
+	if (stream->markers == NULL)
+		stream->markers = g_string_new(NULL);
+	va_start(ap, fmt);
+	g_string_append_vprintf(stream->markers, fmt, ap);
+	va_end(ap);
+	g_string_append_c(stream->markers, '\n');
+}
+
+static void queue_rate_marker(struct log_stream *stream)
+{
+	if (stream->rate_pending_lines == 0)
+		return;
+	queue_marker(stream, "conmon: %" G_GUINT64_FORMAT " lines (%" G_GUINT64_FORMAT " bytes) suppressed by the log rate limit",
+		     (guint64)stream->rate_pending_lines, (guint64)stream->rate_pending_bytes);
+	stream->rate_pending_lines = 0;
+	stream->rate_pending_bytes = 0;
+}
+
+/*
+ * Token bucket per stream: a line is let through if there are byte tokens
+ * left and a token for one line.  The whole line is charged to the byte bucket,
+ * which may go into debt, so that a line longer than the bucket holds is still
+ * logged and the lines after it wait until the debt is paid.  The buckets
+ * refill at --log-rate-bytes and --log-rate-lines per second and hold
+ * --log-rate-burst seconds worth.  Lines over the limit are dropped and
+ * counted, and a marker with the count is logged once lines fit again; with
+ * --log-rate-sample N one in N of them is still let through.  Only the head of
+ * a line is judged, the rest of a long line follows it and is charged to the
+ * bucket.
+ */
+static bool rate_limit_line(struct log_stream *stream, ptrdiff_t len, bool head, gint64 now)
+{
+	double burst = opt_log_rate_burst;
+
+	if (!head) {
+		if (stream->line_passes) {
+			stream->rate_bytes_tokens -= len;
+		} else {
+			stream->rate_pending_bytes += len;
+			stream->bytes_suppressed += len;
+		}
+		return stream->line_passes;
+	}
+
+	if (stream->rate_refilled_at == 0) {
+		stream->rate_bytes_tokens = log_rate_bytes * burst;
+		stream->rate_lines_tokens = log_rate_lines * burst;
+	} else {
+		double elapsed = (double)(now - stream->rate_refilled_at) / G_USEC_PER_SEC;
+		stream->rate_bytes_tokens = MIN(stream->rate_bytes_tokens + log_rate_bytes * elapsed, log_rate_bytes * burst);
+		stream->rate_lines_tokens = MIN(stream->rate_lines_tokens + log_rate_lines * elapsed, log_rate_lines * burst);
+	}
+	stream->rate_refilled_at = now;
+
+	if ((log_rate_bytes == 0 || stream->rate_bytes_tokens > 0) && (log_rate_lines == 0 || stream->rate_lines_tokens >= 1)) {
+		stream->rate_bytes_tokens -= len;
+		stream->rate_lines_tokens -= 1;
+		stream->rate_overflow = 0;
+		queue_rate_marker(stream);
+		return true;
+	}
+
+	if (opt_log_rate_sample > 0 && stream->rate_overflow++ % opt_log_rate_sample == 0)
+		return true;
+
+	stream->rate_pending_lines++;
+	stream->rate_pending_bytes += len;
+	stream->lines_suppressed++;
+	stream->bytes_suppressed += len;
+	return false;
+}
+
+static void write_markers(stdpipe_t pipe, struct log_stream *stream)
+{
+	if (stream->markers == NULL || stream->markers->len == 0)
+		return;
+	write_to_sinks(pipe, stream->markers->str, stream->markers->len);
+	g_string_truncate(stream->markers, 0);
+}
+
+/* FNV-1a */
+static guint32 line_hash(const char *line, ptrdiff_t len)
+{
+	guint32 hash = 2166136261u;
+
+	for (ptrdiff_t i = 0; i < len; i++)
+		hash = (hash ^ (guchar)line[i]) * 16777619u;
+	return hash;
+}
+
+static void queue_dedup_marker(struct log_stream *stream)
+{
+	if (stream->dedup_timer != 0) {
+		loop_remove(stream->dedup_timer);
+		stream->dedup_timer = 0;
+	}
+	if (stream->dedup_repeats == 0)
+		return;
+	queue_marker(stream, "conmon: last message repeated %" G_GUINT64_FORMAT " times", (guint64)stream->dedup_repeats);
+	stream->dedup_repeats = 0;
+}
+
+/* Report the repeats of a line that keeps coming without waiting for another line */
+static gboolean dedup_timer_cb(gpointer user_data)
+{
+	stdpipe_t pipe = GPOINTER_TO_INT(user_data);
+	struct log_stream *stream = log_stream_for(pipe);
+
+	stream->dedup_timer = 0;
+	if (stream->in_line)
+		return G_SOURCE_REMOVE;
+	queue_dedup_marker(stream);
+	write_markers(pipe, stream);
+	return G_SOURCE_REMOVE;
+}
+
+/*
+ * Collapse consecutive identical lines: the first one is logged, the repeats
+ * are counted and replaced by a "last message repeated N times" line when a
+ * different line comes, or --log-dedup seconds after the first repeat if the
+ * line keeps coming.  Lines are compared by hash and length first.  Lines
+ * that do not fit in one read are never collapsed.
+ */
+static bool dedup_line(stdpipe_t pipe, struct log_stream *stream, const char *line, ptrdiff_t len, bool partial, bool head)
+{
+	if (!head)
+		return stream->line_passes;
+
+	if (partial) {
+		queue_dedup_marker(stream);
+		stream->dedup_len = 0;
+		return true;
+	}
+
+	guint32 hash = line_hash(line, len);
+	if ((size_t)len == stream->dedup_len && hash == stream->dedup_hash && memcmp(line, stream->dedup_line, len) == 0) {
+		if (stream->dedup_repeats++ == 0)
+			stream->dedup_timer = loop_add_timeout_seconds(log_dedup, dedup_timer_cb, GINT_TO_POINTER(pipe));
+		stream->lines_deduplicated++;
+		return false;
+	}
+
+	queue_dedup_marker(stream);
+	memcpy(stream->dedup_line, line, len);
+	stream->dedup_len = len;
+	stream->dedup_hash = hash;
 	return true;
 }
 
+/*
+ * Drop lines matching any --log-drop-pattern.  All the patterns are matched in
+ * a single pass over the line, see multimatch.c.  A line longer than one read
+ * is matched on its head only; the rest follows the head.
+ */
+static bool drop_pattern_line(struct log_stream *stream, const char *line, ptrdiff_t len, bool partial, bool head)
+{
+	bool passes = head ? !multimatch_search(drop_patterns, line, partial ? len : len - 1) : stream->line_passes;
+
+	if (!passes) {
+		if (head)
+			stream->lines_filtered++;
+		stream->bytes_filtered += len;
+	}
+	return passes;
+}
+
+static bool filter_line(stdpipe_t pipe, struct log_stream *stream, const char *line, ptrdiff_t len, bool partial, bool head, gint64 now)
+{
+	bool passes = true;
+
+	if (drop_patterns != NULL)
+		passes = drop_pattern_line(stream, line, len, partial, head);
+	if (passes && log_dedup > 0)
+		passes = dedup_line(pipe, stream, line, len, partial, head);
+	if (passes && (log_rate_bytes > 0 || log_rate_lines > 0)) {
+		passes = rate_limit_line(stream, len, head, now);
+		/* A line that was not logged cannot be repeated */
+		if (!passes && head)
+			stream->dedup_len = 0;
+	}
+	return passes;
+}
+
+/*
+ * Run every line through the filter stages.  Consecutive lines that are let
+ * through are still written to the sinks in one go; markers queued by the
+ * stages go out between two lines, never in the middle of one.
+ */
+static bool filter_and_write(stdpipe_t pipe, char *buf, ssize_t num_read)
+{
+	struct log_stream *stream = log_stream_for(pipe);
+	gint64 now = g_get_monotonic_time();
+	char *run = buf;
+	ssize_t run_len = 0;
+	bool ret = true;
+
+	/* Drain: finish any partial line first, then report what is left */
+	if (num_read == 0) {
+		ret = write_to_sinks(pipe, buf, 0);
+		stream->in_line = false;
+		queue_dedup_marker(stream);
+		queue_rate_marker(stream);
+		write_markers(pipe, stream);
+		return ret;
+	}
+
+	while (num_read > 0) {
+		ptrdiff_t line_len = 0;
+		bool partial = get_line_len(&line_len, buf, num_read);
+		bool head = !stream->in_line;
+		bool passes = filter_line(pipe, stream, buf, line_len, partial, head, now);
+
+		if (head && (!passes || (stream->markers != NULL && stream->markers->len > 0))) {
+			if (run_len > 0)
+				ret = write_to_sinks(pipe, run, run_len) && ret;
+			run_len = 0;
+			write_markers(pipe, stream);
+		}
+		if (passes) {
+			if (run_len == 0)
+				run = buf;
+			run_len += line_len;
+		}
+
+		stream->line_passes = passes;
+		stream->in_line = partial;
+		buf += line_len;
+		num_read -= line_len;
+	}
+
+	if (run_len > 0)
+		ret = write_to_sinks(pipe, run, run_len) && ret;
+	return ret;
+}
+
 
 /*
  * parse_priority_prefix checks if the buffer starts with a systemd priority prefix
@@ -355,39 +821,153 @@ static int parse_priority_prefix(const char *buf, ssize_t buflen, int *priority,
 	return 1;
 }
 
+/* Send one journal entry.  message starts with "MESSAGE=". */
+static int journald_send(const char *message, size_t msg_len, int priority, bool partial)
+{
+	writev_buffer_t bufv = {0};
+	char priority_str[PRIORITY_EQ_LEN + 2]; /* "PRIORITY=" + digit + null terminator */
+
+	/* Format the priority string */
+	snprintf(priority_str, sizeof(priority_str), "PRIORITY=%d", priority);
+
+	if (writev_buffer_append_segment_no_flush(&bufv, message, msg_len) < 0)
+		return -1;
+
+	if (writev_buffer_append_segment_no_flush(&bufv, container_id_full, cuuid_len + CID_FULL_EQ_LEN) < 0)
+		return -1;
+
+	if (writev_buffer_append_segment_no_flush(&bufv, priority_str, strlen(priority_str)) < 0)
+		return -1;
+
+	if (writev_buffer_append_segment_no_flush(&bufv, container_id, TRUNC_ID_LEN + CID_EQ_LEN) < 0)
+		return -1;
+
+	if (container_tag && writev_buffer_append_segment_no_flush(&bufv, container_tag, container_tag_len) < 0)
+		return -1;
+
+	/* only print the name if we have a name to print */
+	if (name && writev_buffer_append_segment_no_flush(&bufv, container_name, name_len + NAME_EQ_LEN) < 0)
+		return -1;
+
+	if (writev_buffer_append_segment_no_flush(&bufv, syslog_identifier, syslog_identifier_len) < 0)
+		return -1;
+
+	/* per docker journald logging format, CONTAINER_PARTIAL_MESSAGE is set to true if it's partial, but otherwise not set. */
+	if (partial && !opt_no_container_partial_message
+	    && writev_buffer_append_segment_no_flush(&bufv, "CONTAINER_PARTIAL_MESSAGE=true", PARTIAL_MESSAGE_EQ_LEN) < 0)
+		return -1;
+	if (container_labels) {
+		for (gchar **label = container_labels; *label; ++label) {
+			if (writev_buffer_append_segment_no_flush(&bufv, *label, strlen(*label)) < 0)
+				return -1;
+		}
+	}
+
+	int err = sd_journal_sendv(bufv.iov, bufv.iovcnt);
+	if (err < 0) {
+		nwarnf("sd_journal_sendv: %s", strerror(-err));
+		return err;
+	}
+	return 0;
+}
+
+/* Send the multiline entry being aggregated, if any */
+static int journald_flush_multiline(struct log_stream *stream)
+{
+	GString *entry = stream->multiline;
+
+	if (entry == NULL || entry->len == 0)
+		return 0;
+
+	int ret = journald_send(entry->str, entry->len, stream->multiline_priority, false);
+	g_string_truncate(entry, 0);
+	return ret;
+}
+
+/* The timer is armed once for a burst of lines rather than for every entry */
+static gboolean multiline_timer_cb(gpointer user_data)
+{
+	struct log_stream *stream = log_stream_for(GPOINTER_TO_INT(user_data));
+	gint64 idle_ms = (g_get_monotonic_time() - stream->multiline_last_line) / 1000;
+
+	stream->multiline_timer = 0;
+	if (stream->multiline->len == 0)
+		return G_SOURCE_REMOVE;
+
+	/* Lines kept coming: wait until the entry has been quiet for the whole timeout */
+	if (idle_ms < opt_log_multiline_timeout) {
+		stream->multiline_timer = loop_add_timeout(opt_log_multiline_timeout - idle_ms, multiline_timer_cb, user_data);
+		return G_SOURCE_REMOVE;
+	}
+
+	journald_flush_multiline(stream);
+	return G_SOURCE_REMOVE;
+}
+
+/* Whether line, without its newline, continues the entry before it */
+static bool multiline_continues(const char *line, size_t len)
+{
+	if (multiline_continue_re != NULL && g_regex_match_full(multiline_continue_re, line, len, 0, 0, NULL, NULL))
+		return true;
+	if (multiline_start_re != NULL && !g_regex_match_full(multiline_start_re, line, len, 0, 0, NULL, NULL))
+		return true;
+	return false;
+}
+
+/*
+ * Aggregate the lines of a stack trace into one journal entry.  A line that
+ * matches --log-multiline-continue, or does not match --log-multiline-start,
+ * is appended to the entry before it.  The entry is sent when a line starts a
+ * new one, when it would grow past MULTILINE_MAX, on drain, or once no line
+ * was added to it for --log-multiline-timeout milliseconds.  message is a
+ * complete line and starts with "MESSAGE=".
+ */
+static int journald_add_multiline(stdpipe_t pipe, struct log_stream *stream, const char *message, size_t msg_len, int priority)
+{
+	const char *line = message + MESSAGE_EQ_LEN;
+	size_t line_len = msg_len - MESSAGE_EQ_LEN;
+	int ret = 0;
+
+	if (stream->multiline == NULL)
+		stream->multiline = g_string_new(NULL);
+
+	if (stream->multiline->len > 0
+	    && (!multiline_continues(line, line_len - 1) || stream->multiline->len + line_len > MULTILINE_MAX))
+		ret = journald_flush_multiline(stream);
+
+	if (stream->multiline->len == 0) {
+		g_string_append_len(stream->multiline, message, msg_len);
+		stream->multiline_priority = priority;
+		if (stream->multiline_timer == 0)
+			stream->multiline_timer = loop_add_timeout(opt_log_multiline_timeout, multiline_timer_cb, GINT_TO_POINTER(pipe));
+	} else {
+		g_string_append_len(stream->multiline, line, line_len);
+		stream->multiline_lines++;
+	}
+	stream->multiline_last_line = g_get_monotonic_time();
+	return ret;
+}
+
 /* write to systemd journal. If the pipe is stdout, write with notice priority,
  * otherwise, write with error priority. Partial lines (that don't end in a newline) are buffered
  * between invocations. A 0 buflen argument forces a buffered partial line to be flushed.
  */
 static int write_journald(int pipe, char *buf, ssize_t buflen)
 {
-	static char stdout_partial_buf[STDIO_BUF_SIZE];
-	static size_t stdout_partial_buf_len = 0;
-	static char stderr_partial_buf[STDIO_BUF_SIZE];
-	static size_t stderr_partial_buf_len = 0;
-
-	char *partial_buf;
-	size_t *partial_buf_len;
+	struct log_stream *stream = log_stream_for(pipe);
+	char *partial_buf = stream->journald_partial_buf;
+	size_t *partial_buf_len = &stream->journald_partial_buf_len;
+	bool multiline = multiline_start_re != NULL || multiline_continue_re != NULL;
+	bool drain = buflen == 0;
 
 	/* Default priority values: 6 (info) for stdout, 3 (err) for stderr
 	 * These may be overridden by systemd priority prefixes in the message.
 	 */
 	int default_priority = (pipe == STDERR_PIPE) ? 3 : 6;
-	char priority_str[PRIORITY_EQ_LEN + 2]; /* "PRIORITY=" + digit + null terminator */
-
-	if (pipe == STDERR_PIPE) {
-		partial_buf = stderr_partial_buf;
-		partial_buf_len = &stderr_partial_buf_len;
-	} else {
-		partial_buf = stdout_partial_buf;
-		partial_buf_len = &stdout_partial_buf_len;
-	}
 
 	ptrdiff_t line_len = 0;
 
 	while (buflen > 0 || *partial_buf_len > 0) {
-		writev_buffer_t bufv = {0};
-
 		bool partial = buflen == 0 || get_line_len(&line_len, buf, buflen);
 
 		/* If this is a partial line, and we have capacity to buffer it, buffer it and return.
@@ -428,53 +1008,78 @@ static int write_journald(int pipe, char *buf, ssize_t buflen)
 		memcpy(message + MESSAGE_EQ_LEN, partial_buf, *partial_buf_len);
 		memcpy(message + MESSAGE_EQ_LEN + *partial_buf_len, actual_message_start, actual_message_len);
 
-		/* Format the priority string */
-		snprintf(priority_str, sizeof(priority_str), "PRIORITY=%d", parsed_priority);
-
-		if (writev_buffer_append_segment_no_flush(&bufv, message, msg_len) < 0)
-			return -1;
-
-		if (writev_buffer_append_segment_no_flush(&bufv, container_id_full, cuuid_len + CID_FULL_EQ_LEN) < 0)
-			return -1;
+		int err;
+		if (multiline && !partial) {
+			err = journald_add_multiline(pipe, stream, message, msg_len, parsed_priority);
+		} else {
+			if (multiline)
+				journald_flush_multiline(stream);
+			err = journald_send(message, msg_len, parsed_priority, partial);
+		}
+		if (err < 0)
+			return err;
 
-		if (writev_buffer_append_segment_no_flush(&bufv, priority_str, strlen(priority_str)) < 0)
-			return -1;
+		buf += line_len;
+		buflen -= line_len;
+		*partial_buf_len = 0;
+	}
 
-		if (writev_buffer_append_segment_no_flush(&bufv, container_id, TRUNC_ID_LEN + CID_EQ_LEN) < 0)
-			return -1;
+	/* Drain: nothing more is coming for the entry being aggregated */
+	if (drain && multiline) {
+		if (stream->multiline_timer != 0) {
+			loop_remove(stream->multiline_timer);
+			stream->multiline_timer = 0;
+		}
+		return journald_flush_multiline(stream);
+	}
+	return 0;
+}
 
-		if (container_tag && writev_buffer_append_segment_no_flush(&bufv, container_tag, container_tag_len) < 0)
-			return -1;
+/*
+ * Write-behind: start writing out what was logged since the last call, and
+ * wait for the range submitted by the last call, which has had a whole round
+ * to reach the disk, to drop it from the page cache.  This bounds the dirty
+ * pages of the log to about two rounds and keeps the log, which nobody reads
+ * back soon, from pushing the data of the containers out of the cache.
+ */
+static void k8s_writeback(void)
+{
+	int64_t end = k8s_bytes_written;
 
-		/* only print the name if we have a name to print */
-		if (name && writev_buffer_append_segment_no_flush(&bufv, container_name, name_len + NAME_EQ_LEN) < 0)
-			return -1;
+	if (writeback_timer != 0) {
+		loop_remove(writeback_timer);
+		writeback_timer = 0;
+	}
+	if (end <= writeback_start)
+		return;
 
-		if (writev_buffer_append_segment_no_flush(&bufv, syslog_identifier, syslog_identifier_len) < 0)
-			return -1;
+	/* Fails only if the log is not a regular file, e.g. /dev/null; give up then */
+	if (sync_file_range(k8s_log_fd, writeback_start, end - writeback_start, SYNC_FILE_RANGE_WRITE) < 0) {
+		nwarnf("Failed to start writeback of the log file, disabling it: %m");
+		writeback_bytes = 0;
+		writeback_interval = 0;
+		return;
+	}
 
-		/* per docker journald logging format, CONTAINER_PARTIAL_MESSAGE is set to true if it's partial, but otherwise not set. */
-		if (partial && !opt_no_container_partial_message
-		    && writev_buffer_append_segment_no_flush(&bufv, "CONTAINER_PARTIAL_MESSAGE=true", PARTIAL_MESSAGE_EQ_LEN) < 0)
-			return -1;
-		if (container_labels) {
-			for (gchar **label = container_labels; *label; ++label) {
-				if (writev_buffer_append_segment_no_flush(&bufv, *label, strlen(*label)) < 0)
-					return -1;
-			}
-		}
+	if (writeback_start > writeback_done) {
+		int64_t len = writeback_start - writeback_done;
+		int flags = SYNC_FILE_RANGE_WAIT_BEFORE | SYNC_FILE_RANGE_WRITE | SYNC_FILE_RANGE_WAIT_AFTER;
 
-		int err = sd_journal_sendv(bufv.iov, bufv.iovcnt);
-		if (err < 0) {
-			nwarnf("sd_journal_sendv: %s", strerror(-err));
-			return err;
+		if (sync_file_range(k8s_log_fd, writeback_done, len, flags) < 0) {
+			nwarnf("Failed to write back the log file: %m");
+		} else {
+			posix_fadvise(k8s_log_fd, writeback_done, len, POSIX_FADV_DONTNEED);
 		}
-
-		buf += line_len;
-		buflen -= line_len;
-		*partial_buf_len = 0;
+		writeback_done = writeback_start;
 	}
-	return 0;
+	writeback_start = end;
+}
+
+static gboolean writeback_timer_cb(G_GNUC_UNUSED gpointer user_data)
+{
+	writeback_timer = 0;
+	k8s_writeback();
+	return G_SOURCE_REMOVE;
 }
 
 /*
@@ -486,13 +1091,10 @@ static int write_journald(int pipe, char *buf, ssize_t buflen)
  */
 static int write_k8s_log(stdpipe_t pipe, const char *buf, ssize_t buflen)
 {
-	static bool stdout_has_partial = false;
-	static bool stderr_has_partial = false;
-
 	writev_buffer_t bufv = {0};
 	int64_t bytes_to_be_written = 0;
 
-	bool *has_partial = (pipe == STDOUT_PIPE) ? &stdout_has_partial : &stderr_has_partial;
+	bool *has_partial = &log_stream_for(pipe)->k8s_has_partial;
 
 	/*
 	 * Use the same timestamp for every line of the log in this buffer.
@@ -604,6 +1206,11 @@ static int write_k8s_log(stdpipe_t pipe, const char *buf, ssize_t buflen)
 		nwarn("failed to flush buffer to log");
 	}
 
+	if (writeback_bytes > 0 && k8s_bytes_written - writeback_start >= writeback_bytes)
+		k8s_writeback();
+	else if (writeback_interval > 0 && writeback_timer == 0 && k8s_bytes_written > writeback_start)
+		writeback_timer = loop_add_timeout_seconds(writeback_interval, writeback_timer_cb, NULL);
+
 	return 0;
 }
 
@@ -622,6 +1229,135 @@ static bool get_line_len(ptrdiff_t *line_len, const char *buf, ssize_t buflen)
 	return partial;
 }
 
+/*
+ * Call cb on each line of buf.  The last one is partial if buf does not end
+ * with a newline.  Like k8s-file, all the lines of one read share a
+ * timestamp, in nanoseconds of CLOCK_REALTIME.  Nothing is held back between
+ * two calls, so a drain (buflen 0) has no lines.
+ */
+void for_each_log_line(const char *buf, ssize_t buflen, log_line_cb cb, void *user_data)
+{
+	struct timespec ts;
+
+	if (buflen <= 0)
+		return;
+
+	clock_gettime(CLOCK_REALTIME, &ts);
+	int64_t time_ns = (int64_t)ts.tv_sec * 1000000000 + ts.tv_nsec;
+
+	while (buflen > 0) {
+		ptrdiff_t line_len = 0;
+		bool partial = get_line_len(&line_len, buf, buflen);
+
+		cb(time_ns, buf, partial ? line_len : line_len - 1, partial, user_data);
+		buf += line_len;
+		buflen -= line_len;
+	}
+}
+
+/* write_k8s_log counts what it hands to writev; take back what never gets to the file */
+static void k8s_count_lost(size_t len)
+{
+	k8s_bytes_lost += len;
+	k8s_bytes_written -= len;
+	k8s_total_bytes_written -= len;
+}
+
+/*
+ * Hold back output while degraded.  Once a piece does not fit, everything
+ * after it is dropped, and so is the start of the line it belongs to, so
+ * that only whole lines are held back.
+ */
+static void k8s_spill(const struct iovec *iov, int iovcnt)
+{
+	for (int i = 0; i < iovcnt; i++) {
+		if (!k8s_spill_full && k8s_spill_buf->len + iov[i].iov_len <= (size_t)k8s_spill_size) {
+			g_string_append_len(k8s_spill_buf, iov[i].iov_base, iov[i].iov_len);
+			continue;
+		}
+		if (!k8s_spill_full) {
+			const char *line_end = memrchr(k8s_spill_buf->str, '\n', k8s_spill_buf->len);
+			gsize keep = line_end ? (gsize)(line_end - k8s_spill_buf->str) + 1 : 0;
+
+			k8s_count_lost(k8s_spill_buf->len - keep);
+			g_string_truncate(k8s_spill_buf, keep);
+			k8s_spill_full = TRUE;
+		}
+		k8s_count_lost(iov[i].iov_len);
+	}
+}
+
+/*
+ * Write out what was held back, end the line that was cut off if any, and
+ * log how much was lost.  Returns FALSE if the file system is still full.
+ */
+static gboolean k8s_drain_spill(void)
+{
+	char tsbuf[TSBUFLEN];
+
+	for (;;) {
+		while (k8s_spill_buf->len > 0) {
+			ssize_t res = write(k8s_log_fd, k8s_spill_buf->str, k8s_spill_buf->len);
+			if (res < 0 && errno == EINTR)
+				continue;
+			if (res <= 0)
+				return FALSE;
+			k8s_last_byte = k8s_spill_buf->str[res - 1];
+			g_string_erase(k8s_spill_buf, 0, res);
+		}
+
+		/*
+		 * End the line cut off by a short write, then log the loss.  Both go
+		 * through the spill buffer too, so that they are written exactly once.
+		 */
+		if (k8s_last_byte != '\n') {
+			g_string_append_c(k8s_spill_buf, '\n');
+			k8s_bytes_written++;
+			k8s_total_bytes_written++;
+		} else if (k8s_bytes_lost > 0) {
+			_cleanup_free_ char *marker = NULL;
+
+			set_k8s_timestamp(tsbuf, sizeof tsbuf, stdpipe_name(STDERR_PIPE));
+			marker = g_strdup_printf("%sF conmon: %" G_GUINT64_FORMAT " bytes of logs lost while the file system was full\n", tsbuf,
+						 k8s_bytes_lost);
+			k8s_total_bytes_lost += k8s_bytes_lost;
+			k8s_bytes_lost = 0;
+			g_string_append(k8s_spill_buf, marker);
+			k8s_bytes_written += strlen(marker);
+			k8s_total_bytes_written += strlen(marker);
+		} else {
+			k8s_spill_full = FALSE;
+			return TRUE;
+		}
+	}
+}
+
+static gboolean k8s_retry_cb(G_GNUC_UNUSED gpointer user_data)
+{
+	k8s_retry_timer = 0;
+	if (k8s_drain_spill()) {
+		ninfo("Log file system has space again, leaving degraded mode");
+		k8s_degraded = FALSE;
+		return G_SOURCE_REMOVE;
+	}
+
+	/* One warning per retry instead of one per line */
+	nwarnf("Log file system still full: %zu bytes held back, %" G_GUINT64_FORMAT " bytes lost", k8s_spill_buf->len, k8s_bytes_lost);
+	k8s_retry_interval = MIN(k8s_retry_interval * 2, DISK_FULL_RETRY_MAX);
+	k8s_retry_timer = loop_add_timeout_seconds(k8s_retry_interval, k8s_retry_cb, NULL);
+	return G_SOURCE_REMOVE;
+}
+
+static void k8s_enter_degraded(void)
+{
+	nwarnf("Failed to write to the log file, holding back up to %" G_GINT64_FORMAT " bytes until there is space: %m",
+	       (gint64)k8s_spill_size);
+	k8s_degraded = TRUE;
+	if (k8s_spill_buf == NULL)
+		k8s_spill_buf = g_string_new(NULL);
+	k8s_retry_interval = DISK_FULL_RETRY_MIN;
+	k8s_retry_timer = loop_add_timeout_seconds(k8s_retry_interval, k8s_retry_cb, NULL);
+}
 
 static ssize_t writev_buffer_flush(int fd, writev_buffer_t *buf)
 {
@@ -636,12 +1372,24 @@ static ssize_t writev_buffer_flush(int fd, writev_buffer_t *buf)
 	 */
 	buf->iovcnt = 0;
 
+	/* Do not hit the full file system again for every line */
+	if (k8s_degraded) {
+		k8s_spill(iov, iovcnt);
+		return 0;
+	}
+
 	while (iovcnt > 0) {
 		ssize_t res;
 		do {
 			res = writev(fd, iov, iovcnt);
 		} while (res == -1 && errno == EINTR);
 
+		if (res < 0 && (errno == ENOSPC || errno == EDQUOT)) {
+			k8s_enter_degraded();
+			k8s_spill(iov, iovcnt);
+			return count;
+		}
+
 		if (res <= 0) {
 			/*
 			 * Any unflushed data is lost (this would be a good place to add a counter for how many times
@@ -657,6 +1405,8 @@ static ssize_t writev_buffer_flush(int fd, writev_buffer_t *buf)
 		while (res > 0) {
 			size_t iov_len = iov->iov_len;
 			size_t from_this = MIN((size_t)res, iov_len);
+			if (from_this > 0)
+				k8s_last_byte = ((const char *)iov->iov_base)[from_this - 1];
 			res -= from_this;
 			iov_len -= from_this;
 
@@ -790,6 +1540,7 @@ void close_logging_fds(void)
 void reopen_log_files(void)
 {
 	reopen_k8s_file();
+	log_plugins_reopen();
 }
 
 /* Atomic symlink validation using file descriptors to prevent race conditions */
@@ -1219,6 +1970,7 @@ static void rotate_k8s_file(void)
 
 	k8s_log_fd = new_fd;
 	k8s_bytes_written = 0;
+	writeback_start = writeback_done = 0;
 	close(parent_fd);
 	return;
 
@@ -1247,6 +1999,7 @@ static void reopen_k8s_file(void)
 
 		/* Open with O_TRUNC: reset bytes written */
 		k8s_bytes_written = 0;
+		writeback_start = writeback_done = 0;
 
 		/* Open the log path file again */
 		k8s_log_fd = open(k8s_log_path_tmp, O_WRONLY | O_TRUNC | O_CREAT | O_CLOEXEC, 0640);
@@ -1261,10 +2014,120 @@ static void reopen_k8s_file(void)
 }
 
 
+void pause_log_capture(gboolean paused)
+{
+	log_capture_paused = paused;
+}
+
+/* Returns NULL on success, or why the value was not accepted */
+const char *set_logging_option(const char *key, const char *value)
+{
+	char *end = NULL;
+	gint64 n = g_ascii_strtoll(value, &end, 10);
+
+	if (end == value || *end != '\0')
+		return "value is not a number";
+
+	if (strcmp(key, "log-size-max") == 0) {
+		log_size_max = n;
+		return NULL;
+	}
+	if (strcmp(key, "log-global-size-max") == 0) {
+		log_global_size_max = n;
+		return NULL;
+	}
+	if (strcmp(key, "log-dedup") == 0) {
+		if (n < 0)
+			return "value must be greater than or equal to 0";
+		log_dedup = n;
+		return NULL;
+	}
+	if (strcmp(key, "log-rate-bytes") == 0) {
+		if (n < 0)
+			return "value must be greater than or equal to 0";
+		log_rate_bytes = n;
+		return NULL;
+	}
+	if (strcmp(key, "log-rate-lines") == 0) {
+		if (n < 0)
+			return "value must be greater than or equal to 0";
+		log_rate_lines = n;
+		return NULL;
+	}
+	if (strcmp(key, "log-writeback-bytes") == 0) {
+		if (n < 0)
+			return "value must be greater than or equal to 0";
+		writeback_bytes = n;
+		return NULL;
+	}
+	return "unknown option";
+}
+
+void describe_logging(GString *out)
+{
+	g_string_append_printf(out, "log-size-max %" G_GINT64_FORMAT "\n", (gint64)log_size_max);
+	g_string_append_printf(out, "log-global-size-max %" G_GINT64_FORMAT "\n", (gint64)log_global_size_max);
+	g_string_append_printf(out, "log-dedup %" G_GINT64_FORMAT "\n", (gint64)log_dedup);
+	g_string_append_printf(out, "log-rate-bytes %" G_GINT64_FORMAT "\n", (gint64)log_rate_bytes);
+	g_string_append_printf(out, "log-rate-lines %" G_GINT64_FORMAT "\n", (gint64)log_rate_lines);
+	g_string_append_printf(out, "paused %d\n", log_capture_paused ? 1 : 0);
+	g_string_append_printf(out, "k8s-bytes-written %" G_GINT64_FORMAT "\n", (gint64)k8s_bytes_written);
+	g_string_append_printf(out, "k8s-total-bytes-written %" G_GINT64_FORMAT "\n", (gint64)k8s_total_bytes_written);
+	g_string_append_printf(out, "log-writeback-bytes %" G_GINT64_FORMAT "\n", (gint64)writeback_bytes);
+	g_string_append_printf(out, "k8s-degraded %d\n", k8s_degraded ? 1 : 0);
+	g_string_append_printf(out, "k8s-bytes-held-back %zu\n", k8s_spill_buf != NULL ? k8s_spill_buf->len : 0);
+	g_string_append_printf(out, "k8s-bytes-lost %" G_GUINT64_FORMAT "\n", k8s_total_bytes_lost + k8s_bytes_lost);
+	g_string_append_printf(out, "k8s-bytes-not-written-back %" G_GINT64_FORMAT "\n", (gint64)(k8s_bytes_written - writeback_done));
+	log_ring_describe(out);
+	log_forward_describe(out);
+	for (stdpipe_t pipe = STDOUT_PIPE; pipe <= STDERR_PIPE; pipe++) {
+		struct log_stream *stream = log_stream_for(pipe);
+		const char *name = stdpipe_name(pipe);
+
+		g_string_append_printf(out, "%s-bytes-read %" G_GUINT64_FORMAT "\n", name, (guint64)stream->bytes_read);
+		g_string_append_printf(out, "%s-bytes-dropped %" G_GUINT64_FORMAT "\n", name, (guint64)stream->bytes_dropped);
+		g_string_append_printf(out, "%s-journald-buffered %zu\n", name, stream->journald_partial_buf_len);
+		g_string_append_printf(out, "%s-lines-suppressed %" G_GUINT64_FORMAT "\n", name, (guint64)stream->lines_suppressed);
+		g_string_append_printf(out, "%s-bytes-suppressed %" G_GUINT64_FORMAT "\n", name, (guint64)stream->bytes_suppressed);
+		g_string_append_printf(out, "%s-lines-filtered %" G_GUINT64_FORMAT "\n", name, (guint64)stream->lines_filtered);
+		g_string_append_printf(out, "%s-bytes-filtered %" G_GUINT64_FORMAT "\n", name, (guint64)stream->bytes_filtered);
+		g_string_append_printf(out, "%s-lines-aggregated %" G_GUINT64_FORMAT "\n", name, (guint64)stream->multiline_lines);
+		g_string_append_printf(out, "%s-lines-deduplicated %" G_GUINT64_FORMAT "\n", name, (guint64)stream->lines_deduplicated);
+	}
+}
+
+/* Stop the drivers that need it, before conmon exits */
+void stop_log_drivers(void)
+{
+	/* Last try for what is held back, also when sync_logs was skipped */
+	if (k8s_degraded) {
+		if (k8s_retry_timer != 0)
+			loop_remove(k8s_retry_timer);
+		k8s_retry_timer = 0;
+		if (!k8s_drain_spill())
+			nwarnf("Log file system still full at exit: %zu bytes held back and %" G_GUINT64_FORMAT " bytes lost", k8s_spill_buf->len,
+			       k8s_bytes_lost);
+	}
+
+	log_plugins_stop();
+	log_ring_close();
+	log_forward_close();
+}
+
 void sync_logs(void)
 {
+	/* Retry now what is held back while the file system is full; at exit,
+	 * stop_log_drivers has the last try */
+	if (k8s_degraded) {
+		if (k8s_retry_timer != 0)
+			loop_remove(k8s_retry_timer);
+		k8s_retry_cb(NULL);
+	}
+
 	/* Sync the logs to disk */
 	if (k8s_log_fd > 0)
 		if (fsync(k8s_log_fd) < 0)
 			nwarnf("Failed to sync log file before exit: %m");
+	log_plugins_flush();
+	log_forward_flush();
 }
@@ -10,8 +10,18 @@ bool write_to_logs(stdpipe_t pipe, char *buf, ssize_t num_read);
 void configure_log_drivers(gchar **log_drivers, int64_t log_size_max_, int64_t log_global_size_max_, char *cuuid_, char *name_, char *tag,
 			   gchar **labels);
 void sync_logs(void);
+void stop_log_drivers(void);
 gboolean logging_is_passthrough(void);
 gboolean logging_is_journald_enabled(void);
 void close_logging_fds(void);
 
+/* Called by for_each_log_line with a line without its newline */
+typedef void (*log_line_cb)(int64_t time_ns, const char *line, size_t len, bool partial, void *user_data);
+void for_each_log_line(const char *buf, ssize_t buflen, log_line_cb cb, void *user_data);
+
+/* Runtime tuning, used by the control socket */
+void pause_log_capture(gboolean paused);
+const char *set_logging_option(const char *key, const char *value);
+void describe_logging(GString *out);
+
 #endif /* !defined(CTR_LOGGING_H) */
@@ -1,15 +1,22 @@
+#define _GNU_SOURCE
+
 #include "ctr_stdio.h"
 #include "globals.h"
+#include "loop.h"
 #include "config.h"
 #include "conn_sock.h"
 #include "utils.h"
 #include "ctr_logging.h"
 #include "cli.h"
 
+#include <fcntl.h>
 #include <stdbool.h>
+#include <sys/ioctl.h>
 #include <sys/socket.h>
+#include <unistd.h>
 
 static gboolean tty_hup_timeout_scheduled = false;
+static int tty_peer_fd = -1;
 static bool read_stdio(int fd, stdpipe_t pipe, gboolean *eof);
 static void drain_log_buffers(stdpipe_t pipe);
 static gboolean tty_hup_timeout_cb(G_GNUC_UNUSED gpointer user_data);
@@ -39,7 +46,8 @@ gboolean stdio_cb(int fd, GIOCondition condition, gpointer user_data)
 		/* We got a HUP from the terminal main this means there
 		   are no open workers ptys atm, and we will get a lot
 		   of wakeups until we have one, switch to polling
-		   mode. */
+		   mode. This only happens when hold_tty_peer() could
+		   not open the peer. */
 
 		/* If we read some data this cycle, wait one more, maybe there
 		   is more in the buffer before we handle the hup */
@@ -48,7 +56,7 @@ gboolean stdio_cb(int fd, GIOCondition condition, gpointer user_data)
 		}
 
 		if (!tty_hup_timeout_scheduled) {
-			g_timeout_add(100, tty_hup_timeout_cb, NULL);
+			loop_add_timeout(100, tty_hup_timeout_cb, NULL);
 		}
 		tty_hup_timeout_scheduled = true;
 		return G_SOURCE_REMOVE;
@@ -67,25 +75,46 @@ gboolean stdio_cb(int fd, GIOCondition condition, gpointer user_data)
 		if (pipe == STDOUT_PIPE) {
 			mainfd_stdout = -1;
 			if (container_status >= 0 && mainfd_stderr < 0) {
-				g_main_loop_quit(main_loop);
+				loop_quit();
 			}
 		}
 		if (pipe == STDERR_PIPE) {
 			mainfd_stderr = -1;
 			if (container_status >= 0 && mainfd_stdout < 0) {
-				g_main_loop_quit(main_loop);
+				loop_quit();
 			}
 		}
 
-		close(fd);
+		loop_close_fd(fd);
 		return G_SOURCE_REMOVE;
 	}
 
 	return G_SOURCE_CONTINUE;
 }
 
+void hold_tty_peer(int console_fd)
+{
+	/* As long as we have the worker side of the tty open, the main side
+	   never reports HUP and we don't need to poll it. TIOCGPTPEER opens
+	   the pty the console belongs to; ptsname() would name a path in the
+	   devpts of the container, which is not the one we can see. */
+#ifdef TIOCGPTPEER
+	tty_peer_fd = ioctl(console_fd, TIOCGPTPEER, O_RDWR | O_NOCTTY | O_CLOEXEC);
+	if (tty_peer_fd < 0)
+		nwarn("Failed to open the tty peer, polling the tty while nobody has it open");
+#else
+	(void)console_fd;
+#endif
+}
+
 void drain_stdio()
 {
+	/* Let the main side of the tty report EOF once the buffer is empty */
+	if (tty_peer_fd >= 0) {
+		close(tty_peer_fd);
+		tty_peer_fd = -1;
+	}
+
 	if (mainfd_stdout != -1) {
 		g_unix_set_fd_nonblocking(mainfd_stdout, TRUE, NULL);
 		while (read_stdio(mainfd_stdout, STDOUT_PIPE, NULL))
@@ -160,6 +189,6 @@ static bool read_stdio(int fd, stdpipe_t pipe, gboolean *eof)
 static gboolean tty_hup_timeout_cb(G_GNUC_UNUSED gpointer user_data)
 {
 	tty_hup_timeout_scheduled = false;
-	g_unix_fd_add(mainfd_stdout, G_IO_IN, stdio_cb, GINT_TO_POINTER(STDOUT_PIPE));
+	loop_add_fd(mainfd_stdout, G_IO_IN, stdio_cb, GINT_TO_POINTER(STDOUT_PIPE));
 	return G_SOURCE_REMOVE;
 }
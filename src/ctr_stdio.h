@@ -5,6 +5,7 @@
 #include <stdint.h> /* int64_t */
 
 gboolean stdio_cb(int fd, GIOCondition condition, gpointer user_data);
+void hold_tty_peer(int console_fd);
 void drain_stdio();
 
 #endif // CTR_STDIO_H
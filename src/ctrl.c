@@ -3,8 +3,10 @@
 #include "ctrl.h"
 #include "utils.h"
 #include "globals.h"
+#include "loop.h"
 #include "config.h"
 #include "ctr_logging.h"
+#include "ctr_stdio.h"
 #include "conn_sock.h"
 #include "cmsg.h"
 #include "cli.h" // opt_bundle_path
@@ -40,7 +42,7 @@ gboolean terminal_accept_cb(int fd, G_GNUC_UNUSED GIOCondition condition, G_GNUC
 	if (unlink(csname) < 0)
 		nwarnf("failed to unlink %s", csname);
 
-	close(fd);
+	loop_close_fd(fd);
 
 	/* We exit if this fails. */
 	ndebugf("about to recvfd from connfd: %d", connfd);
@@ -72,6 +74,7 @@ exit:
 	mainfd_stdout = dup(console.fd);
 	if (mainfd_stdout < 0)
 		pexit("Failed to dup console file descriptor");
+	hold_tty_peer(console.fd);
 
 	/* Now that we have a fd to the tty, make sure we handle any pending data
 	 * that was already buffered. */
@@ -80,7 +83,7 @@ exit:
 	/* now that we've set mainfd_stdout, we can register the ctrl_winsz_cb
 	 * if we didn't set it here, we'd risk attempting to run ioctl on
 	 * a negative fd, and fail to resize the window */
-	g_unix_fd_add(winsz_fd_r, G_IO_IN, ctrl_winsz_cb, NULL);
+	loop_add_fd(winsz_fd_r, G_IO_IN, ctrl_winsz_cb, NULL);
 
 	/* Clean up everything */
 	close(connfd);
@@ -250,7 +253,7 @@ int setup_terminal_control_fifo()
 	int dummyfd = -1;
 	setup_fifo(&terminal_ctrl_fd, &dummyfd, "ctl", "terminal control fifo");
 	ndebugf("terminal_ctrl_fd: %d", terminal_ctrl_fd);
-	g_unix_fd_add(terminal_ctrl_fd, G_IO_IN, ctrl_cb, NULL);
+	loop_add_fd(terminal_ctrl_fd, G_IO_IN, ctrl_cb, NULL);
 
 	return dummyfd;
 }
@@ -0,0 +1,87 @@
+#define _GNU_SOURCE
+
+#include "events.h"
+#include "cli.h"
+#include "parent_pipe_fd.h"
+#include "utils.h"
+
+#include <errno.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+static int event_fd = -1;
+static struct sockaddr_un event_addr;
+static char *event_cid = NULL;
+static gint64 start_time_us = 0;
+static guint64 events_dropped = 0;
+
+void events_init(const char *socket_path)
+{
+	if (socket_path == NULL)
+		return;
+
+	if (strlen(socket_path) >= sizeof(event_addr.sun_path))
+		nexitf("Event socket path %s is too long", socket_path);
+
+	event_fd = socket(AF_UNIX, SOCK_DGRAM | SOCK_CLOEXEC | SOCK_NONBLOCK, 0);
+	if (event_fd < 0)
+		pexit("Failed to create event socket");
+
+	memset(&event_addr, 0, sizeof(event_addr));
+	event_addr.sun_family = AF_UNIX;
+	strcpy(event_addr.sun_path, socket_path);
+
+	event_cid = escape_json_string(opt_cid);
+}
+
+/* fields is either empty or starts with a comma */
+static void send_event(const char *type, const char *fields)
+{
+	if (event_fd < 0)
+		return;
+
+	_cleanup_free_ char *msg =
+		g_strdup_printf("{\"event\":\"%s\",\"cid\":\"%s\",\"time\":%" G_GINT64_FORMAT "%s}", type, event_cid, g_get_real_time() / 1000, fields);
+
+	/* Address every datagram, so a restarted manager picks up where it left. */
+	if (sendto(event_fd, msg, strlen(msg), MSG_NOSIGNAL, (struct sockaddr *)&event_addr, sizeof(event_addr)) < 0) {
+		events_dropped++;
+		ndebugf("Dropped %s event (%" G_GUINT64_FORMAT " so far): %m", type, events_dropped);
+	}
+}
+
+void events_send_start(pid_t pid)
+{
+	start_time_us = g_get_monotonic_time();
+
+	_cleanup_free_ char *fields = g_strdup_printf(",\"pid\":%d", pid);
+	send_event("start", fields);
+}
+
+void events_send_oom(void)
+{
+	send_event("oom", "");
+}
+
+void events_send_pressure(const char *resource)
+{
+	_cleanup_free_ char *fields = g_strdup_printf(",\"resource\":\"%s\"", resource);
+	send_event("pressure", fields);
+}
+
+void events_send_healthcheck(const char *status, int exit_code)
+{
+	_cleanup_free_ char *fields = g_strdup_printf(",\"status\":\"%s\",\"exit_code\":%d", status, exit_code);
+	send_event("healthcheck", fields);
+}
+
+void events_send_exit(int exit_status, gboolean timed_out)
+{
+	gint64 duration_ms = start_time_us > 0 ? (g_get_monotonic_time() - start_time_us) / 1000 : -1;
+
+	_cleanup_free_ char *fields = g_strdup_printf(",\"exit_status\":%d,\"timed_out\":%s,\"duration_ms\":%" G_GINT64_FORMAT, exit_status,
+						      timed_out ? "true" : "false", duration_ms);
+	send_event("exit", fields);
+}
@@ -0,0 +1,20 @@
+#if !defined(EVENTS_H)
+#define EVENTS_H
+
+#include <glib.h>      /* gboolean */
+#include <sys/types.h> /* pid_t */
+
+/*
+ * Lifecycle events pushed to a container manager over --event-socket.
+ * Every event is one datagram holding one JSON object; sending never blocks
+ * and events are dropped when nobody is listening.  The exit and oom files
+ * are still written, so the socket is purely an addition.
+ */
+void events_init(const char *socket_path);
+void events_send_start(pid_t pid);
+void events_send_oom(void);
+void events_send_pressure(const char *resource);
+void events_send_healthcheck(const char *status, int exit_code);
+void events_send_exit(int exit_status, gboolean timed_out);
+
+#endif // EVENTS_H
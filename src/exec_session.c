@@ -0,0 +1,492 @@
+#define _GNU_SOURCE
+
+#include "exec_session.h"
+#include "cli.h"
+#include "config.h"
+#include "conn_sock.h"
+#include "ctr_exit.h"
+#include "globals.h"
+#include "loop.h"
+#include "oom.h"
+#include "runtime_args.h"
+#include "runtime_library.h"
+#include "utils.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <signal.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+/*
+ * Exec sessions.
+ *
+ * With --exec-sessions the conmon monitoring a container also runs exec
+ * processes for it, so a container manager does not have to start a new
+ * conmon --exec (with its own attach socket, fifos and runtime setup) for
+ * every exec or exec-based healthcheck.
+ *
+ * Clients connect to the SOCK_SEQPACKET socket "exec" next to the attach
+ * socket and send one request message made of NUL-terminated fields, each
+ * starting with a one-character type:
+ *
+ *   p<path>   process.json passed to `runtime exec --process` (required)
+ *   o<arg>    extra argument for `runtime exec`, such as --preserve-fds=0
+ *   i         give the process a stdin pipe instead of /dev/null
+ *
+ * Every message conmon sends back starts with a type byte.  Output uses the
+ * same framing as the attach socket:
+ *
+ *   STDOUT_PIPE, STDERR_PIPE   output of the process
+ *   'S' "<session id> <pid>"   the process was started
+ *   'X' "<exit code>"          the process exited and its output was sent
+ *   'E' "<message>"            the session could not be started
+ *
+ * 'X' and 'E' are always the last message.  Messages sent by the client after
+ * the request are written to the process stdin; an empty message or shutting
+ * down the connection closes it.  Terminal sessions still need conmon --exec.
+ */
+
+#define EXEC_MSG_STARTED 'S'
+#define EXEC_MSG_EXIT 'X'
+#define EXEC_MSG_ERROR 'E'
+
+#define EXEC_MAX_REQUEST (64 * 1024)
+
+struct exec_session {
+	guint id;
+	int conn;
+	int stdin_fd;
+	int stdout_fd;
+	int stderr_fd;
+	pid_t runtime_pid;
+	pid_t exec_pid;
+	int exit_status; /* -1 while the process runs */
+	char *pid_file;
+	/* loop tags of the sources watching the fds above, 0 when unwatched */
+	guint conn_tag;
+	guint stdin_tag;
+	guint stdout_tag;
+	guint stderr_tag;
+	size_t in_len;
+	size_t in_off;
+	char in_buf[CONN_SOCK_BUF_SIZE];
+};
+
+/* conmon's pid -> exit handler table, shared with the container */
+static GHashTable *pid_handlers = NULL;
+static GHashTable *sessions_by_pid = NULL;
+/* Children reaped while a runtime was still writing their pidfile */
+static GHashTable *unclaimed_exits = NULL;
+static guint pending_runtimes = 0;
+static guint next_session_id = 1;
+
+static gboolean conn_stdin_cb(int fd, GIOCondition condition, gpointer user_data);
+
+static void watch_pid(struct exec_session *s, pid_t *pid, void (*cb)(GPid, int, gpointer))
+{
+	g_hash_table_insert(pid_handlers, pid, cb);
+	g_hash_table_insert(sessions_by_pid, pid, s);
+}
+
+static void unwatch_pid(pid_t *pid)
+{
+	if (*pid <= 0)
+		return;
+	g_hash_table_remove(pid_handlers, pid);
+	g_hash_table_remove(sessions_by_pid, pid);
+	*pid = -1;
+}
+
+static void unwatch_fd(guint *tag)
+{
+	if (*tag == 0)
+		return;
+	loop_remove(*tag);
+	*tag = 0;
+}
+
+static void close_session_fd(int *fd)
+{
+	if (*fd < 0)
+		return;
+	loop_close_fd(*fd);
+	*fd = -1;
+}
+
+static void session_free(struct exec_session *s)
+{
+	unwatch_pid(&s->runtime_pid);
+	unwatch_pid(&s->exec_pid);
+	unwatch_fd(&s->conn_tag);
+	unwatch_fd(&s->stdin_tag);
+	unwatch_fd(&s->stdout_tag);
+	unwatch_fd(&s->stderr_tag);
+	close_session_fd(&s->conn);
+	close_session_fd(&s->stdin_fd);
+	close_session_fd(&s->stdout_fd);
+	close_session_fd(&s->stderr_fd);
+	if (s->pid_file)
+		unlink(s->pid_file);
+	g_free(s->pid_file);
+	g_free(s);
+}
+
+static void send_msg(struct exec_session *s, char type, const char *data, size_t len)
+{
+	char buf[STDIO_BUF_SIZE + 1];
+
+	if (len > STDIO_BUF_SIZE)
+		len = STDIO_BUF_SIZE;
+	buf[0] = type;
+	memcpy(buf + 1, data, len);
+	/* The client may be gone; the process keeps running regardless. */
+	if (send(s->conn, buf, len + 1, MSG_NOSIGNAL) < 0)
+		ndebugf("Failed to write to exec session %u: %m", s->id);
+}
+
+static void send_text(struct exec_session *s, char type, const char *text)
+{
+	send_msg(s, type, text, strlen(text));
+}
+
+static void session_fail(struct exec_session *s, const char *message)
+{
+	nwarnf("Exec session %u failed: %s", s->id, message);
+	send_text(s, EXEC_MSG_ERROR, message);
+	session_free(s);
+}
+
+/* The session ends once the process exited and both output pipes hit EOF,
+ * just like conmon --exec. */
+static void session_maybe_finish(struct exec_session *s)
+{
+	if (s->exit_status < 0 || s->stdout_fd >= 0 || s->stderr_fd >= 0)
+		return;
+
+	_cleanup_free_ char *status = g_strdup_printf("%d", s->exit_status);
+	ninfof("Exec session %u exited with status %d", s->id, s->exit_status);
+	send_text(s, EXEC_MSG_EXIT, status);
+	session_free(s);
+}
+
+static gboolean output_cb(int fd, G_GNUC_UNUSED GIOCondition condition, gpointer user_data)
+{
+	struct exec_session *s = user_data;
+	stdpipe_t pipe = fd == s->stdout_fd ? STDOUT_PIPE : STDERR_PIPE;
+	char buf[STDIO_BUF_SIZE];
+
+	ssize_t num_read = read(fd, buf, sizeof(buf));
+	if (num_read < 0 && (errno == EAGAIN || errno == EINTR))
+		return G_SOURCE_CONTINUE;
+
+	if (num_read <= 0) {
+		if (pipe == STDOUT_PIPE)
+			s->stdout_tag = 0;
+		else
+			s->stderr_tag = 0;
+		close_session_fd(pipe == STDOUT_PIPE ? &s->stdout_fd : &s->stderr_fd);
+		session_maybe_finish(s);
+		return G_SOURCE_REMOVE;
+	}
+
+	send_msg(s, pipe, buf, num_read);
+	return G_SOURCE_CONTINUE;
+}
+
+static gboolean stdin_write_cb(int fd, G_GNUC_UNUSED GIOCondition condition, gpointer user_data)
+{
+	struct exec_session *s = user_data;
+
+	ssize_t w = write(fd, s->in_buf + s->in_off, s->in_len);
+	if (w < 0 && (errno == EAGAIN || errno == EINTR))
+		return G_SOURCE_CONTINUE;
+	if (w < 0) {
+		/* The process closed its stdin; drop whatever the client sends. */
+		ndebugf("Failed to write to stdin of exec session %u: %m", s->id);
+		s->stdin_tag = 0;
+		close_session_fd(&s->stdin_fd);
+		return G_SOURCE_REMOVE;
+	}
+
+	s->in_off += w;
+	s->in_len -= w;
+	if (s->in_len > 0)
+		return G_SOURCE_CONTINUE;
+
+	/* Only read more from the client once this buffer is written. */
+	s->stdin_tag = 0;
+	s->conn_tag = loop_add_fd(s->conn, G_IO_IN | G_IO_HUP | G_IO_ERR, conn_stdin_cb, s);
+	return G_SOURCE_REMOVE;
+}
+
+static gboolean conn_stdin_cb(int fd, GIOCondition condition, gpointer user_data)
+{
+	struct exec_session *s = user_data;
+	ssize_t num_read = 0;
+
+	if (condition & G_IO_IN) {
+		num_read = recv(fd, s->in_buf, sizeof(s->in_buf), 0);
+		if (num_read < 0 && (errno == EAGAIN || errno == EINTR))
+			return G_SOURCE_CONTINUE;
+	}
+
+	s->conn_tag = 0;
+	if (num_read <= 0 || s->stdin_fd < 0) {
+		close_session_fd(&s->stdin_fd);
+		return G_SOURCE_REMOVE;
+	}
+
+	s->in_off = 0;
+	s->in_len = num_read;
+	s->stdin_tag = loop_add_fd(s->stdin_fd, G_IO_OUT, stdin_write_cb, s);
+	return G_SOURCE_REMOVE;
+}
+
+static void exec_exit_cb(GPid pid, int status, G_GNUC_UNUSED gpointer user_data)
+{
+	struct exec_session *s = g_hash_table_lookup(sessions_by_pid, &pid);
+	if (s == NULL)
+		return;
+
+	unwatch_pid(&s->exec_pid);
+	s->exit_status = get_exit_status(status);
+	session_maybe_finish(s);
+}
+
+static void session_started(struct exec_session *s)
+{
+	_cleanup_gerror_ GError *err = NULL;
+	_cleanup_free_ char *contents = NULL;
+
+	if (!g_file_get_contents(s->pid_file, &contents, NULL, &err)) {
+		session_fail(s, err->message);
+		return;
+	}
+	unlink(s->pid_file);
+
+	pid_t pid = atoi(contents);
+	if (pid <= 0) {
+		session_fail(s, "runtime wrote an invalid pid");
+		return;
+	}
+
+	_cleanup_free_ char *started = g_strdup_printf("%u %d", s->id, pid);
+	send_text(s, EXEC_MSG_STARTED, started);
+	ninfof("Exec session %u started process %d", s->id, pid);
+
+	s->stdout_tag = loop_add_fd(s->stdout_fd, G_IO_IN, output_cb, s);
+	s->stderr_tag = loop_add_fd(s->stderr_fd, G_IO_IN, output_cb, s);
+	if (s->stdin_fd >= 0)
+		s->conn_tag = loop_add_fd(s->conn, G_IO_IN | G_IO_HUP | G_IO_ERR, conn_stdin_cb, s);
+
+	/* The process may have been reaped before the runtime told us its pid. */
+	int *status = g_hash_table_lookup(unclaimed_exits, &pid);
+	if (status != NULL) {
+		s->exit_status = get_exit_status(*status);
+		g_hash_table_remove(unclaimed_exits, &pid);
+		return;
+	}
+
+	s->exec_pid = pid;
+	watch_pid(s, &s->exec_pid, exec_exit_cb);
+}
+
+static void exec_runtime_exit_cb(GPid pid, int status, G_GNUC_UNUSED gpointer user_data)
+{
+	struct exec_session *s = g_hash_table_lookup(sessions_by_pid, &pid);
+	if (s == NULL)
+		return;
+
+	unwatch_pid(&s->runtime_pid);
+	pending_runtimes--;
+
+	if (!WIFEXITED(status) || WEXITSTATUS(status) != 0) {
+		char buf[BUF_SIZE];
+		g_unix_set_fd_nonblocking(s->stderr_fd, TRUE, NULL);
+		ssize_t num_read = read(s->stderr_fd, buf, sizeof(buf) - 1);
+		if (num_read > 0) {
+			buf[num_read] = '\0';
+			session_fail(s, buf);
+		} else {
+			_cleanup_free_ char *message = g_strdup_printf("runtime exec failed with status %d", get_exit_status(status));
+			session_fail(s, message);
+		}
+	} else {
+		session_started(s);
+	}
+
+	if (pending_runtimes == 0)
+		g_hash_table_remove_all(unclaimed_exits);
+}
+
+void exec_sessions_unclaimed_exit(pid_t pid, int status)
+{
+	if (pending_runtimes == 0)
+		return;
+
+	pid_t *k = g_malloc(sizeof(pid_t));
+	int *v = g_malloc(sizeof(int));
+	*k = pid;
+	*v = status;
+	g_hash_table_insert(unclaimed_exits, k, v);
+}
+
+/* Returns 0 once the runtime is running, or a negative errno. */
+static int start_session(struct exec_session *s, const char *process_spec, GPtrArray *exec_opts, gboolean want_stdin)
+{
+	int in[2] = {-1, -1}, out[2], err[2];
+
+	if (want_stdin) {
+		if (pipe2(in, O_CLOEXEC) < 0)
+			return -errno;
+		s->stdin_fd = in[1];
+		g_unix_set_fd_nonblocking(s->stdin_fd, TRUE, NULL);
+	}
+	if (pipe2(out, O_CLOEXEC) < 0) {
+		int saved_errno = errno;
+		if (in[0] >= 0)
+			close(in[0]);
+		return -saved_errno;
+	}
+	s->stdout_fd = out[0];
+	if (pipe2(err, O_CLOEXEC) < 0) {
+		int saved_errno = errno;
+		if (in[0] >= 0)
+			close(in[0]);
+		close(out[1]);
+		return -saved_errno;
+	}
+	s->stderr_fd = err[0];
+
+	_cleanup_free_ char *pid_dir = g_path_get_dirname(opt_container_pid_file);
+	_cleanup_free_ char *pid_name = g_strdup_printf("exec-%u.pid", s->id);
+	s->pid_file = g_build_filename(pid_dir, pid_name, NULL);
+
+	GPtrArray *runtime_argv = configure_exec_session_args(s->pid_file, process_spec, exec_opts);
+
+	/* Same as the create command: the runtime must not inherit our
+	 * signal mask, ignored SIGPIPE or oom_score_adj. */
+	pid_t pid = fork();
+	if (pid == 0) {
+		sigset_t mask;
+		sigemptyset(&mask);
+		sigprocmask(SIG_SETMASK, &mask, NULL);
+		signal(SIGPIPE, SIG_DFL);
+
+		if (dup2(in[0] >= 0 ? in[0] : dev_null_r, STDIN_FILENO) < 0 || dup2(out[1], STDOUT_FILENO) < 0
+		    || dup2(err[1], STDERR_FILENO) < 0)
+			_pexit("Failed to dup over exec session stdio");
+
+		reset_oom_adjust();
+		exec_runtime(runtime_argv);
+		_exit(127);
+	}
+	int saved_errno = errno;
+
+	g_ptr_array_free(runtime_argv, TRUE);
+	if (in[0] >= 0)
+		close(in[0]);
+	close(out[1]);
+	close(err[1]);
+
+	if (pid < 0)
+		return -saved_errno;
+
+	s->runtime_pid = pid;
+	watch_pid(s, &s->runtime_pid, exec_runtime_exit_cb);
+	pending_runtimes++;
+	return 0;
+}
+
+/* Returns 0 once the runtime is running, or a negative errno. */
+static int handle_request(struct exec_session *s, char *buf, ssize_t len)
+{
+	const char *process_spec = NULL;
+	gboolean want_stdin = FALSE;
+	int ret = -EINVAL;
+
+	if (len == 0 || len > EXEC_MAX_REQUEST || buf[len - 1] != '\0')
+		return -EINVAL;
+
+	GPtrArray *exec_opts = g_ptr_array_new();
+	for (char *field = buf; field < buf + len; field += strlen(field) + 1) {
+		switch (*field) {
+		case 'p':
+			process_spec = field + 1;
+			break;
+		case 'o':
+			g_ptr_array_add(exec_opts, field + 1);
+			break;
+		case 'i':
+			want_stdin = TRUE;
+			break;
+		default:
+			goto out;
+		}
+	}
+
+	if (process_spec != NULL && *process_spec != '\0')
+		ret = start_session(s, process_spec, exec_opts, want_stdin);
+out:
+	g_ptr_array_free(exec_opts, TRUE);
+	return ret;
+}
+
+static gboolean request_cb(int fd, GIOCondition condition, gpointer user_data)
+{
+	struct exec_session *s = user_data;
+
+	if (!(condition & G_IO_IN)) {
+		session_free(s);
+		return G_SOURCE_REMOVE;
+	}
+
+	_cleanup_free_ char *buf = g_malloc(EXEC_MAX_REQUEST);
+	ssize_t len = recv(fd, buf, EXEC_MAX_REQUEST, MSG_TRUNC);
+	if (len < 0 && (errno == EAGAIN || errno == EINTR))
+		return G_SOURCE_CONTINUE;
+
+	int ret = len < 0 ? -errno : handle_request(s, buf, len);
+	if (ret < 0) {
+		session_fail(s, strerror(-ret));
+		return G_SOURCE_REMOVE;
+	}
+
+	/* Stdin is only read once the process is running. */
+	s->conn_tag = 0;
+	return G_SOURCE_REMOVE;
+}
+
+static gboolean exec_accept_cb(int fd, G_GNUC_UNUSED GIOCondition condition, G_GNUC_UNUSED gpointer user_data)
+{
+	int conn = accept4(fd, NULL, NULL, SOCK_CLOEXEC);
+	if (conn < 0) {
+		if (errno != EWOULDBLOCK)
+			nwarn("Failed to accept client connection on exec socket");
+		return G_SOURCE_CONTINUE;
+	}
+
+	struct exec_session *s = g_new0(struct exec_session, 1);
+	s->id = next_session_id++;
+	s->conn = conn;
+	s->stdin_fd = s->stdout_fd = s->stderr_fd = -1;
+	s->runtime_pid = s->exec_pid = -1;
+	s->exit_status = -1;
+
+	s->conn_tag = loop_add_fd(conn, G_IO_IN | G_IO_HUP | G_IO_ERR, request_cb, s);
+	return G_SOURCE_CONTINUE;
+}
+
+void setup_exec_sessions(GHashTable *pid_to_handler)
+{
+	pid_handlers = pid_to_handler;
+	sessions_by_pid = g_hash_table_new(g_int_hash, g_int_equal);
+	unclaimed_exits = g_hash_table_new_full(g_int_hash, g_int_equal, g_free, g_free);
+
+	int fd = setup_exec_socket();
+	loop_add_fd(fd, G_IO_IN, exec_accept_cb, NULL);
+}
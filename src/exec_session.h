@@ -0,0 +1,13 @@
+#if !defined(EXEC_SESSION_H)
+#define EXEC_SESSION_H
+
+#include <glib.h>      /* GHashTable */
+#include <sys/types.h> /* pid_t */
+
+/* Start serving exec requests on the exec socket; see exec_session.c. */
+void setup_exec_sessions(GHashTable *pid_to_handler);
+
+/* Called for every reaped child that has no handler. */
+void exec_sessions_unclaimed_exit(pid_t pid, int status);
+
+#endif // EXEC_SESSION_H
@@ -19,5 +19,3 @@ int dev_null_r = -1;
 int dev_null_w = -1;
 
 gboolean timed_out = FALSE;
-
-GMainLoop *main_loop = NULL;
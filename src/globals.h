@@ -1,9 +1,14 @@
 #if !defined(GLOBALS_H)
 #define GLOBALS_H
 
-#include <glib.h> /* gboolean and GMainLoop */
-
-/* Global state */
+#include <glib.h> /* gboolean */
+
+/*
+ * Global state.  It is per process on purpose: one conmon monitors one
+ * container, and the engines rely on that (conmon pid, subreaper, exit
+ * command, exit of conmon as the end of the container).  Per-stream log
+ * state is in struct log_stream in ctr_logging.c.
+ */
 extern int runtime_status;
 extern int container_status;
 
@@ -24,7 +29,5 @@ extern int dev_null_w;
 
 extern gboolean timed_out;
 
-extern GMainLoop *main_loop;
-
 
 #endif // GLOBALS_H
@@ -5,8 +5,11 @@
 #include "ctr_logging.h"
 #include "parent_pipe_fd.h"
 #include "globals.h"
+#include "loop.h"
 #include "cli.h"
 #include "ctr_exit.h"
+#include "spawn.h"
+#include "events.h"
 
 #include <stdio.h>
 #include <stdlib.h>
@@ -20,6 +23,7 @@
 #include <sys/types.h>
 #include <fcntl.h>
 #include <limits.h>
+#include <poll.h>
 #include <glib.h>
 
 /* Healthcheck validation constants */
@@ -82,6 +86,10 @@ const char *healthcheck_status_strings[] = {"none", "starting", "healthy", "unhe
 /* Global healthcheck timer (one per conmon instance) */
 healthcheck_timer_t *active_healthcheck_timer = NULL;
 
+/* Status last pushed on the event socket; only transitions are worth waking
+ * the container manager for */
+static int last_event_status = -1;
+
 
 /* Cleanup healthcheck subsystem */
 void healthcheck_cleanup(void)
@@ -220,7 +228,7 @@ bool healthcheck_timer_start(healthcheck_timer_t *timer)
 	healthcheck_timer_callback(timer);
 
 	/* Set up the interval timer for subsequent healthchecks */
-	timer->timer_id = g_timeout_add_seconds(timer->config.interval, healthcheck_timer_callback, timer);
+	timer->timer_id = loop_add_timeout_seconds(timer->config.interval, healthcheck_timer_callback, timer);
 	if (timer->timer_id == 0) {
 		nwarn("Failed to create healthcheck timer");
 		timer->timer_active = false;
@@ -242,7 +250,7 @@ void healthcheck_timer_stop(healthcheck_timer_t *timer)
 
 	/* Remove the GLib timeout source */
 	if (timer->timer_id != 0) {
-		g_source_remove(timer->timer_id);
+		loop_remove(timer->timer_id);
 		timer->timer_id = 0;
 	}
 }
@@ -260,6 +268,46 @@ gboolean healthcheck_delayed_start_callback(gpointer user_data)
 	return G_SOURCE_REMOVE;
 }
 
+/* Wait up to timeout_seconds for the healthcheck command to exit.  With a
+ * pidfd this sleeps in poll(2) until the exit instead of checking every
+ * 100ms.  A command still running at the deadline is killed. */
+static bool healthcheck_wait(pid_t pid, int pidfd, int timeout_seconds, int *status, bool *timed_out)
+{
+	gint64 deadline = g_get_monotonic_time() + (gint64)timeout_seconds * 1000000;
+
+	*timed_out = false;
+	for (;;) {
+		pid_t ret = waitpid(pid, status, WNOHANG);
+		if (ret == pid)
+			return true;
+		if (ret < 0) {
+			if (errno == EINTR)
+				continue;
+			return false;
+		}
+
+		gint64 remaining = deadline - g_get_monotonic_time();
+		if (remaining <= 0)
+			break;
+
+		if (pidfd >= 0) {
+			struct pollfd pfd = {.fd = pidfd, .events = POLLIN};
+			if (poll(&pfd, 1, (remaining + 999) / 1000) < 0 && errno != EINTR)
+				return false;
+		} else {
+			usleep(MIN(remaining, 100000));
+		}
+	}
+
+	kill(pid, SIGKILL);
+	while (waitpid(pid, status, 0) < 0) {
+		if (errno != EINTR)
+			return false;
+	}
+	*timed_out = true;
+	return true;
+}
+
 /* Execute healthcheck command inside container using runtime */
 bool healthcheck_execute_command(const healthcheck_config_t *config, const char *container_id, const char *runtime_path, int *exit_code)
 {
@@ -272,152 +320,94 @@ bool healthcheck_execute_command(const healthcheck_config_t *config, const char
 
 	/* Create stderr pipe to capture error output */
 	int stderr_pipe[2];
-	if (pipe(stderr_pipe) == -1) {
+	if (pipe2(stderr_pipe, O_CLOEXEC) == -1) {
 		nwarnf("Failed to create pipe for healthcheck stderr: %s", strerror(errno));
 		return false;
 	}
 
-	/* Fork a child process to execute the healthcheck command inside container */
-	pid_t pid = fork();
-	if (pid == -1) {
-		nwarnf("Failed to fork process for healthcheck command: %s", strerror(errno));
-		close(stderr_pipe[0]);
-		close(stderr_pipe[1]);
-		return false;
+	/* Build runtime command for direct execution */
+	/* Format: runtime exec container_id command args... */
+	int argc = 0;
+	while (config->test[argc] != NULL) {
+		argc++;
 	}
 
-	if (pid == 0) {
-		/* Child process - execute the healthcheck command inside container */
-		close(stderr_pipe[0]); /* Close read end of stderr pipe */
+	/* runtime + exec + container_id + command + args + NULL */
+	_cleanup_free_ char **runtime_argv = g_new0(char *, 3 + argc + 1);
+	runtime_argv[0] = (char *)runtime_path; /* Runtime executable */
+	runtime_argv[1] = "exec";		/* Runtime subcommand */
+	runtime_argv[2] = (char *)container_id; /* Container ID */
+	for (int i = 0; i < argc; i++) {
+		runtime_argv[3 + i] = config->test[i];
+	}
 
-		/* Redirect stdout to /dev/null and stderr to pipe */
-		int devnull = open("/dev/null", O_WRONLY);
-		if (devnull != -1) {
-			dup2(devnull, STDOUT_FILENO);
-			close(devnull);
-		}
-		dup2(stderr_pipe[1], STDERR_FILENO); /* Redirect stderr to pipe */
-		close(stderr_pipe[1]);
+	/* stdout goes to /dev/null and stderr to the pipe */
+	_cleanup_close_ int devnull = open("/dev/null", O_WRONLY | O_CLOEXEC);
+	struct spawn_stdio stdio = {.in = -1, .out = devnull, .err = stderr_pipe[1]};
+	_cleanup_close_ int pidfd = -1;
 
-		/* Build runtime command for direct execution */
-		/* Format: runtime exec container_id command args... */
-		char **runtime_argv;
+	pid_t pid = spawn_process(runtime_argv, &stdio, TRUE, &pidfd);
+	close(stderr_pipe[1]);
+	if (pid == -1) {
+		nwarnf("Failed to spawn healthcheck command: %s", strerror(errno));
+		close(stderr_pipe[0]);
+		return false;
+	}
 
-		/* Count arguments needed */
-		int argc = 0;
-		while (config->test[argc] != NULL) {
-			argc++;
-		}
+	int status;
+	bool timed_out = false;
 
-		/* Allocate runtime command array: runtime + exec + container_id + command + args + NULL */
-		runtime_argv = calloc(3 + argc + 1, sizeof(char *));
-		if (runtime_argv == NULL) {
-			nwarn("Failed to allocate memory for runtime command");
-			_exit(127);
-		}
+	if (!healthcheck_wait(pid, pidfd, config->timeout, &status, &timed_out)) {
+		nwarnf("Failed to wait for healthcheck command: %s", strerror(errno));
+		close(stderr_pipe[0]);
+		return false;
+	}
+	if (timed_out)
+		nwarnf("Healthcheck command timed out after %d seconds: %s", config->timeout, config->test[0]);
 
-		runtime_argv[0] = (char *)runtime_path; /* Runtime executable */
-		runtime_argv[1] = "exec";		/* Runtime subcommand */
-		runtime_argv[2] = (char *)container_id; /* Container ID */
+	/* Read stderr output */
+	char stderr_buffer[4096];
+	ssize_t stderr_len = read(stderr_pipe[0], stderr_buffer, sizeof(stderr_buffer) - 1);
+	close(stderr_pipe[0]);
 
-		/* Copy healthcheck command and arguments */
-		for (int i = 0; i < argc; i++) {
-			runtime_argv[3 + i] = config->test[i];
-		}
-		runtime_argv[3 + argc] = NULL; /* NULL terminator */
-
-		/* Execute the runtime command */
-		if (execvp(runtime_path, runtime_argv) == -1) {
-			/* If execvp fails, exit with error code */
-			_exit(127); /* Command not found */
+	if (stderr_len > 0) {
+		stderr_buffer[stderr_len] = '\0';
+		/* Trim trailing newlines */
+		while (stderr_len > 0 && (stderr_buffer[stderr_len - 1] == '\n' || stderr_buffer[stderr_len - 1] == '\r')) {
+			stderr_buffer[--stderr_len] = '\0';
 		}
 	} else {
-		/* Parent process - wait for child to complete with timeout */
-		close(stderr_pipe[1]); /* Close write end of stderr pipe */
-		int status;
-		pid_t wait_result;
-		int timeout_seconds = config->timeout;
-		time_t start_time = time(NULL);
-		bool timed_out = false;
-
-		/* Wait for child with timeout */
-		while (true) {
-			wait_result = waitpid(pid, &status, WNOHANG);
-
-			if (wait_result == -1) {
-				nwarnf("Failed to wait for healthcheck command: %s", strerror(errno));
-				close(stderr_pipe[0]);
-				return false;
-			}
-
-			if (wait_result == pid) {
-				/* Child process has terminated */
-				break;
-			}
+		stderr_buffer[0] = '\0';
+	}
 
-			/* Check if timeout has been reached */
-			time_t current_time = time(NULL);
-			if (current_time - start_time >= timeout_seconds) {
-				nwarnf("Healthcheck command timed out after %d seconds: %s", timeout_seconds, config->test[0]);
-				/* Kill the child process */
-				kill(pid, SIGKILL);
-				/* Wait for it to actually terminate */
-				waitpid(pid, &status, 0);
-				timed_out = true;
-				break;
+	if (timed_out) {
+		/* Command timed out and was killed */
+		*exit_code = 124; /* Standard exit code for timeout */
+		return true;
+	} else if (WIFEXITED(status)) {
+		*exit_code = WEXITSTATUS(status);
+		if (*exit_code != 0) {
+			nwarnf("Healthcheck command failed (exit code %d): %s", *exit_code, config->test[0]);
+			if (stderr_len > 0) {
+				nwarnf("Healthcheck command stderr: %s", stderr_buffer);
 			}
-
-			/* Sleep for a short interval before checking again */
-			usleep(100000); /* 100ms */
 		}
-
-		/* Read stderr output */
-		char stderr_buffer[4096];
-		ssize_t stderr_len = read(stderr_pipe[0], stderr_buffer, sizeof(stderr_buffer) - 1);
-		close(stderr_pipe[0]);
-
+		return true;
+	} else if (WIFSIGNALED(status)) {
+		nwarnf("Healthcheck command terminated by signal %d: %s", WTERMSIG(status), config->test[0]);
 		if (stderr_len > 0) {
-			stderr_buffer[stderr_len] = '\0';
-			/* Trim trailing newlines */
-			while (stderr_len > 0 && (stderr_buffer[stderr_len - 1] == '\n' || stderr_buffer[stderr_len - 1] == '\r')) {
-				stderr_buffer[--stderr_len] = '\0';
-			}
-		} else {
-			stderr_buffer[0] = '\0';
+			nwarnf("Healthcheck command stderr: %s", stderr_buffer);
 		}
-
-		if (timed_out) {
-			/* Command timed out and was killed */
-			*exit_code = 124; /* Standard exit code for timeout */
-			return true;
-		} else if (WIFEXITED(status)) {
-			*exit_code = WEXITSTATUS(status);
-			if (*exit_code != 0) {
-				nwarnf("Healthcheck command failed (exit code %d): %s", *exit_code, config->test[0]);
-				if (stderr_len > 0) {
-					nwarnf("Healthcheck command stderr: %s", stderr_buffer);
-				}
-			}
-			return true;
-		} else if (WIFSIGNALED(status)) {
-			nwarnf("Healthcheck command terminated by signal %d: %s", WTERMSIG(status), config->test[0]);
-			if (stderr_len > 0) {
-				nwarnf("Healthcheck command stderr: %s", stderr_buffer);
-			}
-			*exit_code = 128 + WTERMSIG(status); /* Standard convention for signal termination */
-			return true;
-		} else {
-			nwarnf("Healthcheck command did not terminate normally: %s", config->test[0]);
-			if (stderr_len > 0) {
-				nwarnf("Healthcheck command stderr: %s", stderr_buffer);
-			}
-			*exit_code = -1;
-			return false;
+		*exit_code = 128 + WTERMSIG(status); /* Standard convention for signal termination */
+		return true;
+	} else {
+		nwarnf("Healthcheck command did not terminate normally: %s", config->test[0]);
+		if (stderr_len > 0) {
+			nwarnf("Healthcheck command stderr: %s", stderr_buffer);
 		}
+		*exit_code = -1;
+		return false;
 	}
-
-	/* This should never be reached */
-	return false;
 }
 
 /* Convert healthcheck status to string */
@@ -436,6 +426,11 @@ bool healthcheck_send_status_update(const char *container_id, int status, int ex
 		return false;
 	}
 
+	if (status != last_event_status) {
+		last_event_status = status;
+		events_send_healthcheck(healthcheck_status_to_string(status), exit_code);
+	}
+
 	/* Verify sync pipe is available before sending healthcheck updates */
 	if (sync_pipe_fd == -1) {
 		nwarnf("Sync pipe not available, skipping healthcheck status update for container %s", container_id);
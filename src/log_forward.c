@@ -0,0 +1,314 @@
+#define _GNU_SOURCE
+
+#include "log_forward.h"
+#include "ctr_logging.h"
+#include "loop.h"
+#include "utils.h"
+
+#include <errno.h>
+#include <poll.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+/* Time given to the collector to take what is still queued when conmon exits */
+#define LOG_FORWARD_CLOSE_TIMEOUT_MS 1000
+
+#define FRAME_HEADER 4
+
+static struct sockaddr_un forward_addr;
+static gboolean forward_open = FALSE;
+static int forward_fd = -1;
+static int flush_interval_ms = 0;
+static size_t buffer_size = 0;
+
+/* Frames not sent yet; the first sent bytes of them are already on the socket */
+static GByteArray *queue = NULL;
+static size_t sent = 0;
+
+static guint flush_timer = 0;
+static guint reconnect_timer = 0;
+static guint write_watch = 0;
+static guint hup_watch = 0;
+static guint backoff_ms = 0;
+
+static guint64 records_forwarded = 0;
+static guint64 records_dropped = 0;
+static guint64 bytes_dropped = 0;
+static guint64 connects = 0;
+
+static void schedule_reconnect(void);
+static void forward_send(void);
+
+static uint32_t frame_len(const guint8 *frame)
+{
+	return ((uint32_t)frame[0] << 24) | ((uint32_t)frame[1] << 16) | ((uint32_t)frame[2] << 8) | frame[3];
+}
+
+/* Remove the frames that are entirely on the socket */
+static void trim_sent_frames(void)
+{
+	size_t done = 0;
+
+	while (queue->len - done >= FRAME_HEADER) {
+		size_t size = FRAME_HEADER + frame_len(queue->data + done);
+		if (done + size > sent)
+			break;
+		done += size;
+		records_forwarded++;
+	}
+	if (done > 0) {
+		g_byte_array_remove_range(queue, 0, done);
+		sent -= done;
+	}
+}
+
+/* Drop the oldest frames until needed more bytes fit, sparing the one in flight */
+static void make_room(size_t needed)
+{
+	size_t start = 0;
+	size_t end;
+
+	if (sent > 0)
+		start = FRAME_HEADER + frame_len(queue->data);
+	end = start;
+	while (queue->len - (end - start) + needed > buffer_size && end < queue->len) {
+		size_t size = FRAME_HEADER + frame_len(queue->data + end);
+		end += size;
+		records_dropped++;
+		bytes_dropped += size - FRAME_HEADER;
+	}
+	if (end > start)
+		g_byte_array_remove_range(queue, start, end - start);
+}
+
+static void disconnect(void)
+{
+	if (forward_fd < 0)
+		return;
+
+	/* With the GLib loop closing the fd does not drop its watches */
+	if (hup_watch != 0)
+		loop_remove(hup_watch);
+	if (write_watch != 0)
+		loop_remove(write_watch);
+	hup_watch = write_watch = 0;
+	loop_close_fd(forward_fd);
+	forward_fd = -1;
+	/* The collector discards a frame it only got part of, send it again */
+	sent = 0;
+}
+
+static gboolean forward_hup_cb(G_GNUC_UNUSED int fd, G_GNUC_UNUSED GIOCondition condition, G_GNUC_UNUSED gpointer user_data)
+{
+	char buf[256];
+
+	/* The collector has nothing to say; anything but data means it is gone */
+	if (condition & G_IO_IN) {
+		ssize_t num_read = recv(forward_fd, buf, sizeof(buf), MSG_DONTWAIT);
+		if (num_read > 0 || (num_read < 0 && (errno == EAGAIN || errno == EINTR)))
+			return G_SOURCE_CONTINUE;
+	}
+	hup_watch = 0;
+	nwarnf("Log collector at %s closed the connection", forward_addr.sun_path);
+	disconnect();
+	schedule_reconnect();
+	return G_SOURCE_REMOVE;
+}
+
+static gboolean forward_write_cb(G_GNUC_UNUSED int fd, G_GNUC_UNUSED GIOCondition condition, G_GNUC_UNUSED gpointer user_data)
+{
+	write_watch = 0;
+	forward_send();
+	return G_SOURCE_REMOVE;
+}
+
+static gboolean try_connect(void)
+{
+	int fd = socket(AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+	if (fd < 0) {
+		nwarn("Failed to create the log forwarding socket");
+		return FALSE;
+	}
+	if (connect(fd, (struct sockaddr *)&forward_addr, sizeof(forward_addr)) < 0) {
+		/* Warn once per outage, not on every attempt */
+		if (backoff_ms == 0)
+			nwarnf("Failed to connect to the log collector at %s: %m", forward_addr.sun_path);
+		close(fd);
+		return FALSE;
+	}
+
+	if (connects++ > 0)
+		ninfof("Reconnected to the log collector at %s", forward_addr.sun_path);
+	forward_fd = fd;
+	backoff_ms = 0;
+	hup_watch = loop_add_fd(forward_fd, G_IO_IN | G_IO_HUP | G_IO_ERR, forward_hup_cb, NULL);
+	return TRUE;
+}
+
+static gboolean reconnect_cb(G_GNUC_UNUSED gpointer user_data)
+{
+	reconnect_timer = 0;
+	forward_send();
+	return G_SOURCE_REMOVE;
+}
+
+static void schedule_reconnect(void)
+{
+	/* Reconnecting is only worth a wakeup if there is something to send */
+	if (reconnect_timer != 0 || queue->len == 0)
+		return;
+	backoff_ms = backoff_ms == 0 ? LOG_FORWARD_BACKOFF_MIN_MS : MIN(backoff_ms * 2, LOG_FORWARD_BACKOFF_MAX_MS);
+	reconnect_timer = loop_add_timeout(backoff_ms, reconnect_cb, NULL);
+}
+
+/* Write as much of the queue as the socket takes without blocking */
+static void forward_send(void)
+{
+	if (forward_fd < 0) {
+		if (reconnect_timer != 0)
+			return;
+		if (!try_connect()) {
+			schedule_reconnect();
+			return;
+		}
+	}
+	if (write_watch != 0)
+		return;
+
+	while (sent < queue->len) {
+		ssize_t num_sent = send(forward_fd, queue->data + sent, queue->len - sent, MSG_DONTWAIT | MSG_NOSIGNAL);
+		if (num_sent < 0) {
+			if (errno == EINTR)
+				continue;
+			if (errno == EAGAIN) {
+				write_watch = loop_add_fd(forward_fd, G_IO_OUT, forward_write_cb, NULL);
+				break;
+			}
+			nwarnf("Failed to forward logs to %s: %m", forward_addr.sun_path);
+			disconnect();
+			schedule_reconnect();
+			return;
+		}
+		sent += num_sent;
+	}
+	trim_sent_frames();
+}
+
+static gboolean flush_timer_cb(G_GNUC_UNUSED gpointer user_data)
+{
+	flush_timer = 0;
+	forward_send();
+	return G_SOURCE_REMOVE;
+}
+
+void log_forward_open(const char *path, int flush_interval_ms_, int64_t buffer_size_)
+{
+	if (strlen(path) >= sizeof(forward_addr.sun_path))
+		nexitf("Log forwarding socket path %s is too long", path);
+	forward_addr.sun_family = AF_UNIX;
+	strncpy(forward_addr.sun_path, path, sizeof(forward_addr.sun_path) - 1);
+	flush_interval_ms = flush_interval_ms_;
+	buffer_size = buffer_size_;
+	queue = g_byte_array_new();
+	/* Connect with the first batch: the collector may well start after us */
+	forward_open = TRUE;
+}
+
+gboolean log_forward_is_open(void)
+{
+	return forward_open;
+}
+
+/* user_data is the prefix of the frames */
+static void queue_frame(G_GNUC_UNUSED int64_t time_ns, const char *line, size_t line_len, bool partial, void *user_data)
+{
+	const char *prefix = user_data;
+	size_t prefix_len = strlen(prefix);
+	size_t len = prefix_len + 2 + line_len;
+	guint8 header[FRAME_HEADER] = {len >> 24, len >> 16, len >> 8, len};
+
+	if (FRAME_HEADER + len > buffer_size) {
+		records_dropped++;
+		bytes_dropped += len;
+		return;
+	}
+	if (queue->len + FRAME_HEADER + len > buffer_size)
+		make_room(FRAME_HEADER + len);
+
+	g_byte_array_append(queue, header, FRAME_HEADER);
+	g_byte_array_append(queue, (const guint8 *)prefix, prefix_len);
+	g_byte_array_append(queue, (const guint8 *)(partial ? "P " : "F "), 2);
+	g_byte_array_append(queue, (const guint8 *)line, line_len);
+}
+
+void log_forward_write(const char *prefix, const char *buf, ssize_t buflen)
+{
+	for_each_log_line(buf, buflen, queue_frame, (void *)prefix);
+
+	if (queue->len - sent >= LOG_FORWARD_BATCH_SIZE)
+		forward_send();
+	else if (flush_timer == 0)
+		flush_timer = loop_add_timeout(flush_interval_ms, flush_timer_cb, NULL);
+}
+
+void log_forward_flush(void)
+{
+	if (!forward_open)
+		return;
+	if (flush_timer != 0) {
+		loop_remove(flush_timer);
+		flush_timer = 0;
+	}
+	forward_send();
+}
+
+void log_forward_describe(GString *out)
+{
+	if (!forward_open)
+		return;
+	g_string_append_printf(out, "forward-connected %d\n", forward_fd >= 0 ? 1 : 0);
+	g_string_append_printf(out, "forward-bytes-queued %u\n", queue->len);
+	g_string_append_printf(out, "forward-records-forwarded %" G_GUINT64_FORMAT "\n", records_forwarded);
+	g_string_append_printf(out, "forward-records-dropped %" G_GUINT64_FORMAT "\n", records_dropped);
+	g_string_append_printf(out, "forward-bytes-dropped %" G_GUINT64_FORMAT "\n", bytes_dropped);
+	g_string_append_printf(out, "forward-connects %" G_GUINT64_FORMAT "\n", connects);
+}
+
+void log_forward_close(void)
+{
+	gint64 deadline = g_get_monotonic_time() + LOG_FORWARD_CLOSE_TIMEOUT_MS * 1000;
+
+	if (!forward_open)
+		return;
+
+	if (forward_fd < 0)
+		try_connect();
+	while (forward_fd >= 0 && sent < queue->len) {
+		struct pollfd pfd = {.fd = forward_fd, .events = POLLOUT};
+		int timeout_ms = (deadline - g_get_monotonic_time()) / 1000;
+
+		if (timeout_ms <= 0 || poll(&pfd, 1, timeout_ms) <= 0 || (pfd.revents & (POLLERR | POLLHUP)))
+			break;
+		ssize_t num_sent = send(forward_fd, queue->data + sent, queue->len - sent, MSG_DONTWAIT | MSG_NOSIGNAL);
+		if (num_sent < 0 && errno != EAGAIN && errno != EINTR)
+			break;
+		if (num_sent > 0)
+			sent += num_sent;
+	}
+	trim_sent_frames();
+
+	if (queue->len > 0)
+		nwarnf("Dropped %u bytes of logs that could not be forwarded to %s", queue->len, forward_addr.sun_path);
+	if (flush_timer != 0)
+		loop_remove(flush_timer);
+	if (reconnect_timer != 0)
+		loop_remove(reconnect_timer);
+	flush_timer = reconnect_timer = 0;
+	disconnect();
+	g_byte_array_free(queue, TRUE);
+	queue = NULL;
+	forward_open = FALSE;
+}
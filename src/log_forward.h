@@ -0,0 +1,39 @@
+#if !defined(LOG_FORWARD_H)
+#define LOG_FORWARD_H
+
+#include <glib.h>
+#include <stdint.h>
+#include <sys/types.h>
+
+/*
+ * Forwarding of container output to a local collector (--log-path
+ * forward:<socket>) over a unix stream socket.
+ *
+ * Every line is sent as one frame: a 32 bit big endian length followed by
+ * the line in the k8s-file format, "<timestamp> <stream> <F|P> <line>",
+ * without the newline.  This is the "length_delimited" framing of Vector's
+ * socket source, and trivial to split for anything else.  Frames are queued
+ * and written in batches every flush interval, or as soon as a batch is
+ * complete.  While the collector is away the queue is kept, up to its size;
+ * after that the oldest frames are dropped and counted.  conmon reconnects
+ * with an exponential backoff, and only while it has something to send.
+ */
+
+/* Bytes queued before a batch is written without waiting for the timer */
+#define LOG_FORWARD_BATCH_SIZE (64 * 1024)
+
+#define LOG_FORWARD_BACKOFF_MIN_MS 100
+#define LOG_FORWARD_BACKOFF_MAX_MS (30 * 1000)
+
+void log_forward_open(const char *path, int flush_interval_ms, int64_t buffer_size);
+gboolean log_forward_is_open(void);
+
+/* Queue the lines in buf; prefix is the "<timestamp> <stream> " of k8s-file. */
+void log_forward_write(const char *prefix, const char *buf, ssize_t buflen);
+void log_forward_flush(void);
+void log_forward_describe(GString *out);
+
+/* Try to send what is still queued, for a bounded time, and disconnect. */
+void log_forward_close(void);
+
+#endif // LOG_FORWARD_H
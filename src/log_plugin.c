@@ -0,0 +1,150 @@
+#define _GNU_SOURCE
+
+#include "log_plugin.h"
+#include "log_sink_plugin.h"
+#include "cli.h"
+#include "ctr_logging.h"
+
+#include <dlfcn.h>
+#include <string.h>
+
+/* Records passed to a sink in one call */
+#define LOG_PLUGIN_BATCH 64
+
+struct log_plugin {
+	char *path;
+	void *opaque;
+	conmon_log_sink_write_cb write_cb;
+	conmon_log_sink_flush_cb flush_cb;
+	conmon_log_sink_reopen_cb reopen_cb;
+	conmon_log_sink_stop_cb stop_cb;
+};
+
+static GPtrArray *log_plugins = NULL;
+
+void log_plugin_load(const char *spec, const char *cid, const char *name)
+{
+	const char *colon = strchr(spec, ':');
+	_cleanup_free_ char *path = colon ? g_strndup(spec, colon - spec) : g_strdup(spec);
+	struct conmon_log_sink_conf conf = {
+		.config = colon ? colon + 1 : "",
+		.container_id = cid,
+		.container_name = name,
+		.bundle_path = opt_bundle_path,
+	};
+
+	if (*path == '\0')
+		nexit("log-path plugin requires the path of a shared object");
+
+	/* The handle stays open for the lifetime of conmon. */
+	void *handle = dlopen(path, RTLD_NOW);
+	if (handle == NULL)
+		nexitf("cannot load `%s`: %s", path, dlerror());
+
+	conmon_log_sink_version_cb version_cb = (conmon_log_sink_version_cb)dlsym(handle, "conmon_log_sink_version");
+	if (version_cb == NULL)
+		nexitf("log sink `%s` doesn't export `conmon_log_sink_version`", path);
+	if (version_cb() != CONMON_LOG_SINK_VERSION)
+		nexitf("invalid version supported by the log sink `%s`", path);
+
+	struct log_plugin *plugin = g_new0(struct log_plugin, 1);
+	plugin->write_cb = (conmon_log_sink_write_cb)dlsym(handle, "conmon_log_sink_write");
+	if (plugin->write_cb == NULL)
+		nexitf("log sink `%s` doesn't export `conmon_log_sink_write`", path);
+	plugin->flush_cb = (conmon_log_sink_flush_cb)dlsym(handle, "conmon_log_sink_flush");
+	plugin->reopen_cb = (conmon_log_sink_reopen_cb)dlsym(handle, "conmon_log_sink_reopen");
+	plugin->stop_cb = (conmon_log_sink_stop_cb)dlsym(handle, "conmon_log_sink_stop");
+
+	conmon_log_sink_start_cb start_cb = (conmon_log_sink_start_cb)dlsym(handle, "conmon_log_sink_start");
+	if (start_cb != NULL && start_cb(&plugin->opaque, &conf, sizeof(conf)) != 0)
+		nexitf("error starting the log sink `%s`", path);
+
+	plugin->path = path;
+	path = NULL;
+	if (log_plugins == NULL)
+		log_plugins = g_ptr_array_new();
+	g_ptr_array_add(log_plugins, plugin);
+	ndebugf("loaded log sink %s", plugin->path);
+}
+
+gboolean log_plugins_loaded(void)
+{
+	return log_plugins != NULL;
+}
+
+static int write_batch(const struct conmon_log_sink_record *records, size_t n_records)
+{
+	int ret = 0;
+
+	for (guint i = 0; i < log_plugins->len; i++) {
+		struct log_plugin *plugin = g_ptr_array_index(log_plugins, i);
+		if (plugin->write_cb(plugin->opaque, records, n_records) != 0) {
+			nwarnf("log sink `%s` failed to write %zu records", plugin->path, n_records);
+			ret = -1;
+		}
+	}
+	return ret;
+}
+
+struct batch {
+	struct conmon_log_sink_record records[LOG_PLUGIN_BATCH];
+	size_t n_records;
+	int stream;
+	int ret;
+};
+
+static void add_record(int64_t time_ns, const char *line, size_t len, bool partial, void *user_data)
+{
+	struct batch *batch = user_data;
+
+	batch->records[batch->n_records++] = (struct conmon_log_sink_record){
+		.stream = batch->stream,
+		.partial = partial,
+		.time_ns = time_ns,
+		.data = line,
+		.len = len,
+	};
+	if (batch->n_records == LOG_PLUGIN_BATCH) {
+		batch->ret |= write_batch(batch->records, batch->n_records);
+		batch->n_records = 0;
+	}
+}
+
+int log_plugins_write(stdpipe_t pipe, const char *buf, ssize_t buflen)
+{
+	struct batch batch = {
+		.stream = pipe == STDERR_PIPE ? CONMON_LOG_SINK_STDERR : CONMON_LOG_SINK_STDOUT,
+	};
+
+	for_each_log_line(buf, buflen, add_record, &batch);
+	if (batch.n_records > 0)
+		batch.ret |= write_batch(batch.records, batch.n_records);
+	return batch.ret;
+}
+
+void log_plugins_flush(void)
+{
+	for (guint i = 0; log_plugins != NULL && i < log_plugins->len; i++) {
+		struct log_plugin *plugin = g_ptr_array_index(log_plugins, i);
+		if (plugin->flush_cb != NULL && plugin->flush_cb(plugin->opaque) != 0)
+			nwarnf("log sink `%s` failed to flush", plugin->path);
+	}
+}
+
+void log_plugins_reopen(void)
+{
+	for (guint i = 0; log_plugins != NULL && i < log_plugins->len; i++) {
+		struct log_plugin *plugin = g_ptr_array_index(log_plugins, i);
+		if (plugin->reopen_cb != NULL && plugin->reopen_cb(plugin->opaque) != 0)
+			nwarnf("log sink `%s` failed to reopen", plugin->path);
+	}
+}
+
+void log_plugins_stop(void)
+{
+	for (guint i = 0; log_plugins != NULL && i < log_plugins->len; i++) {
+		struct log_plugin *plugin = g_ptr_array_index(log_plugins, i);
+		if (plugin->stop_cb != NULL && plugin->stop_cb(plugin->opaque) != 0)
+			nwarnf("log sink `%s` failed to stop", plugin->path);
+	}
+}
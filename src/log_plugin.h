@@ -0,0 +1,16 @@
+#if !defined(LOG_PLUGIN_H)
+#define LOG_PLUGIN_H
+
+#include "utils.h" /* stdpipe_t */
+
+/* Load and start the sink in spec, "<so>[:<config>]"; exits on failure. */
+void log_plugin_load(const char *spec, const char *cid, const char *name);
+gboolean log_plugins_loaded(void);
+
+/* Pass the lines in buf to every sink; see src/log_sink_plugin.h. */
+int log_plugins_write(stdpipe_t pipe, const char *buf, ssize_t buflen);
+void log_plugins_flush(void);
+void log_plugins_reopen(void);
+void log_plugins_stop(void);
+
+#endif // LOG_PLUGIN_H
@@ -0,0 +1,177 @@
+#define _GNU_SOURCE
+
+#include "log_ring.h"
+#include "ctr_logging.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <signal.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <unistd.h>
+
+#define RECORD_ALIGN 8
+
+static struct log_ring_header *ring = NULL;
+static char *ring_data = NULL;
+static size_t ring_map_size = 0;
+/* The backing file on tmpfs, and the link to it in the bundle directory */
+static char *ring_path = NULL;
+static char *ring_link = NULL;
+
+static uint64_t record_size(uint32_t len)
+{
+	return sizeof(struct log_ring_record) + ((len + RECORD_ALIGN - 1) & ~(uint64_t)(RECORD_ALIGN - 1));
+}
+
+void log_ring_open(const char *id, const char *run_dir, const char *link_dir, uint64_t size)
+{
+	uint64_t data_size = LOG_RING_MIN_SIZE;
+
+	while (data_size < size && data_size < LOG_RING_MAX_SIZE)
+		data_size <<= 1;
+
+	/* The pages must not be written back to disk behind the readers */
+	_cleanup_free_ char *file_name = g_strdup_printf("conmon-%s.log-ring", id);
+	const char *dir = access(LOG_RING_SHM_DIR, W_OK) == 0 ? LOG_RING_SHM_DIR : run_dir;
+	ring_path = g_build_filename(dir, file_name, NULL);
+
+	/*
+	 * A reader may still have the ring of an earlier conmon mapped; shrinking
+	 * that file would get it a SIGBUS, so start from a new one.
+	 */
+	if (unlink(ring_path) < 0 && errno != ENOENT)
+		pexitf("Failed to remove the old log ring %s", ring_path);
+	_cleanup_close_ int fd = open(ring_path, O_RDWR | O_CREAT | O_EXCL | O_CLOEXEC, 0600);
+	if (fd < 0)
+		pexitf("Failed to create log ring %s", ring_path);
+
+	ring_map_size = sizeof(struct log_ring_header) + data_size;
+	if (ftruncate(fd, ring_map_size) < 0)
+		pexitf("Failed to size log ring %s", ring_path);
+	void *map = mmap(NULL, ring_map_size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+	if (map == MAP_FAILED)
+		pexitf("Failed to map log ring %s", ring_path);
+
+	ring_link = g_build_filename(link_dir, "log-ring", NULL);
+	if (unlink(ring_link) < 0 && errno != ENOENT)
+		pexitf("Failed to remove the old log ring %s", ring_link);
+	if (symlink(ring_path, ring_link) < 0)
+		pexitf("Failed to link the log ring %s to %s", ring_path, ring_link);
+
+	ring = map;
+	ring_data = (char *)map + sizeof(struct log_ring_header);
+	ring->version = LOG_RING_VERSION;
+	ring->header_size = sizeof(struct log_ring_header);
+	ring->data_size = data_size;
+	/* Readers check the magic last */
+	__atomic_thread_fence(__ATOMIC_RELEASE);
+	memcpy(ring->magic, LOG_RING_MAGIC, sizeof(ring->magic));
+}
+
+gboolean log_ring_is_open(void)
+{
+	return ring != NULL;
+}
+
+/* Move tail past the records that writing up to head + n would overwrite */
+static void make_room(uint64_t head, uint64_t n)
+{
+	uint64_t tail = ring->tail;
+
+	while (head + n - tail > ring->data_size) {
+		uint64_t offset = tail % ring->data_size;
+		uint64_t left = ring->data_size - offset;
+
+		if (left < sizeof(struct log_ring_record)) {
+			tail += left;
+		} else {
+			const struct log_ring_record *record = (const struct log_ring_record *)(ring_data + offset);
+			tail += record->stream == 0 ? left : record_size(record->len);
+		}
+	}
+	__atomic_store_n(&ring->tail, tail, __ATOMIC_RELEASE);
+	/* The tail must be visible before the old records are overwritten */
+	__atomic_thread_fence(__ATOMIC_SEQ_CST);
+}
+
+static void append_record(int stream, uint16_t flags, int64_t time_ns, const char *data, uint32_t len)
+{
+	uint64_t head = ring->head;
+	uint64_t size = record_size(len);
+	uint64_t left = ring->data_size - head % ring->data_size;
+
+	if (left < size) {
+		make_room(head, left);
+		if (left >= sizeof(struct log_ring_record)) {
+			struct log_ring_record *pad = (struct log_ring_record *)(ring_data + head % ring->data_size);
+			*pad = (struct log_ring_record){.seq = ring->records, .len = left - sizeof(*pad)};
+		}
+		head += left;
+		__atomic_store_n(&ring->head, head, __ATOMIC_RELEASE);
+	}
+
+	make_room(head, size);
+	struct log_ring_record *record = (struct log_ring_record *)(ring_data + head % ring->data_size);
+	*record = (struct log_ring_record){
+		.seq = ring->records++,
+		.time_ns = time_ns,
+		.len = len,
+		.stream = stream,
+		.flags = flags,
+	};
+	memcpy(record + 1, data, len);
+	__atomic_store_n(&ring->head, head + size, __ATOMIC_RELEASE);
+}
+
+static void append_line(int64_t time_ns, const char *line, size_t len, bool partial, void *user_data)
+{
+	int stream = GPOINTER_TO_INT(user_data);
+
+	append_record(stream, partial ? LOG_RING_PARTIAL : 0, time_ns, line, len);
+}
+
+int log_ring_write(stdpipe_t pipe, const char *buf, ssize_t buflen)
+{
+	int stream = pipe == STDERR_PIPE ? LOG_RING_STDERR : LOG_RING_STDOUT;
+
+	for_each_log_line(buf, buflen, append_line, GINT_TO_POINTER(stream));
+	return 0;
+}
+
+void log_ring_describe(GString *out)
+{
+	if (ring == NULL)
+		return;
+
+	g_string_append_printf(out, "ring-head %" G_GUINT64_FORMAT "\n", (guint64)ring->head);
+	g_string_append_printf(out, "ring-tail %" G_GUINT64_FORMAT "\n", (guint64)ring->tail);
+	g_string_append_printf(out, "ring-records %" G_GUINT64_FORMAT "\n", (guint64)ring->records);
+	for (int i = 0; i < LOG_RING_READERS; i++) {
+		int32_t pid = __atomic_load_n(&ring->readers[i].pid, __ATOMIC_ACQUIRE);
+		uint64_t position = __atomic_load_n(&ring->readers[i].position, __ATOMIC_RELAXED);
+
+		/* Skip readers that went away without releasing their slot */
+		if (pid <= 0 || (kill(pid, 0) < 0 && errno == ESRCH))
+			continue;
+		g_string_append_printf(out, "ring-reader-%d-lag %" G_GUINT64_FORMAT "\n", (int)pid,
+				       (guint64)(ring->head > position ? ring->head - position : 0));
+	}
+}
+
+void log_ring_close(void)
+{
+	if (ring == NULL)
+		return;
+	__atomic_store_n(&ring->closed, 1, __ATOMIC_RELEASE);
+	munmap(ring, ring_map_size);
+	ring = NULL;
+	ring_data = NULL;
+
+	/* Readers that have it mapped go on until they see closed */
+	unlink(ring_link);
+	unlink(ring_path);
+	g_free(ring_link);
+	g_free(ring_path);
+	ring_link = ring_path = NULL;
+}
@@ -0,0 +1,87 @@
+#if !defined(LOG_RING_H)
+#define LOG_RING_H
+
+#include "utils.h"  /* stdpipe_t */
+#include <stdint.h> /* uint32_t, uint64_t */
+
+/*
+ * Shared memory log ring.  With --log-path ring[:<size>] conmon also
+ * publishes every line it logs as a record in a file on tmpfs, in /dev/shm or
+ * else in the socket directory path.  The symlink "log-ring" in the bundle
+ * directory, which is reachable through the socket directory like the attach
+ * socket, points to it.  The file is kept mapped; log agents map it read-write
+ * and follow it without reading the log file back from disk.  conmon creates
+ * a new file when it starts and removes it when it exits.
+ *
+ * The file starts with a struct log_ring_header in host byte order, followed
+ * by data_size bytes of data.  Positions are byte counts since the ring was
+ * created; position p is at offset p % data_size of the data.  conmon is the
+ * only writer.  A record is a struct log_ring_record followed by len bytes of
+ * line, padded to 8 bytes.  A record never wraps: if fewer than
+ * sizeof(struct log_ring_record) bytes are left before the end of the data
+ * the reader skips to the start, and if more are left but the record does
+ * not fit, a padding record with stream 0 fills them.
+ *
+ * Records between tail and head are complete.  The writer moves head, with
+ * release semantics, after a record is written, and moves tail past the
+ * records it is about to overwrite before it overwrites them.  A reader
+ * copies the record at its position, then reads tail again (acquire): if
+ * tail went past the position the copy may be torn, the reader was lapped
+ * and goes on from tail.
+ *
+ * Readers that want their lag reported claim a slot in readers by storing
+ * their pid into a zero pid, or the pid of a process that is gone, and store
+ * their position after every batch.
+ * The lag of each reader is reported on the control socket.
+ * hack/conmon-log-ring.py follows a ring.
+ */
+
+#define LOG_RING_MAGIC "CONMONLR"
+#define LOG_RING_VERSION 1
+#define LOG_RING_READERS 8
+#define LOG_RING_DEFAULT_SIZE (1024 * 1024)
+#define LOG_RING_MIN_SIZE (64 * 1024)
+#define LOG_RING_MAX_SIZE (1024 * 1024 * 1024)
+#define LOG_RING_SHM_DIR "/dev/shm"
+
+#define LOG_RING_STDOUT 1
+#define LOG_RING_STDERR 2
+#define LOG_RING_PARTIAL 1 /* flags: the line goes on in the next record of the stream */
+
+struct log_ring_reader {
+	int32_t pid;
+	uint32_t reserved;
+	uint64_t position;
+};
+
+struct log_ring_header {
+	char magic[8];
+	uint32_t version;
+	uint32_t header_size; /* offset of the data in the file */
+	uint64_t data_size;   /* a power of two */
+	uint64_t head;
+	uint64_t tail;
+	uint64_t records;
+	uint32_t closed; /* set when conmon is done with the ring */
+	uint32_t reserved;
+	struct log_ring_reader readers[LOG_RING_READERS];
+};
+
+struct log_ring_record {
+	uint64_t seq;	  /* counts from 0, padding repeats the next seq */
+	int64_t time_ns;  /* CLOCK_REALTIME */
+	uint32_t len;	  /* of the line, without padding and newline */
+	uint16_t stream;  /* LOG_RING_STDOUT, LOG_RING_STDERR or 0 for padding */
+	uint16_t flags;
+};
+
+/* The file is named after id, in run_dir if /dev/shm cannot be used, and
+ * linked from link_dir.  size is rounded up to a power of two, up to
+ * LOG_RING_MAX_SIZE; exits on failure. */
+void log_ring_open(const char *id, const char *run_dir, const char *link_dir, uint64_t size);
+gboolean log_ring_is_open(void);
+int log_ring_write(stdpipe_t pipe, const char *buf, ssize_t buflen);
+void log_ring_describe(GString *out);
+void log_ring_close(void);
+
+#endif // LOG_RING_H
@@ -0,0 +1,66 @@
+#ifndef LOG_SINK_PLUGIN_H
+#define LOG_SINK_PLUGIN_H
+
+#include <stddef.h> /* size_t */
+#include <stdint.h> /* int64_t */
+
+/*
+ * Interface of a log sink loaded with --log-path plugin:<so>[:<config>].
+ *
+ * The sink gets the container output after conmon split it into lines and ran
+ * it through the log filters, in the same order the other log drivers write
+ * it.  Every call is made on conmon's main loop; a sink must not block it.
+ * Only write is required, the other functions are called if exported.
+ */
+
+/* Version of this interface. */
+#define CONMON_LOG_SINK_VERSION 1
+
+struct conmon_log_sink_conf {
+	/* Everything after the second colon of --log-path, or "" */
+	const char *config;
+	const char *container_id;
+	/* NULL if conmon was not given --name */
+	const char *container_name;
+	const char *bundle_path;
+};
+
+#define CONMON_LOG_SINK_STDOUT 1
+#define CONMON_LOG_SINK_STDERR 2
+
+struct conmon_log_sink_record {
+	/* CONMON_LOG_SINK_STDOUT or CONMON_LOG_SINK_STDERR */
+	int stream;
+	/* Non-zero if the line goes on in the next record of the stream */
+	int partial;
+	/* CLOCK_REALTIME, in nanoseconds since the epoch */
+	int64_t time_ns;
+	/* The line without its newline; only valid during the call */
+	const char *data;
+	size_t len;
+};
+
+/* Retrieve the interface version implemented by the sink.  It MUST be
+   exported as conmon_log_sink_version and return CONMON_LOG_SINK_VERSION. */
+typedef int (*conmon_log_sink_version_cb)(void);
+
+/* Configure the sink.  *opaque is passed to the successive calls.  Exported
+   as conmon_log_sink_start.  A non-zero return makes conmon fail to start. */
+typedef int (*conmon_log_sink_start_cb)(void **opaque, const struct conmon_log_sink_conf *conf, size_t size_configuration);
+
+/* Write a batch of records.  It MUST be exported as conmon_log_sink_write.
+   A non-zero return is logged as a warning; the records are not retried. */
+typedef int (*conmon_log_sink_write_cb)(void *opaque, const struct conmon_log_sink_record *records, size_t n_records);
+
+/* Make what was written durable, when conmon syncs its log files.  Exported
+   as conmon_log_sink_flush. */
+typedef int (*conmon_log_sink_flush_cb)(void *opaque);
+
+/* Rotate or reopen the output, when the log files are reopened.  Exported as
+   conmon_log_sink_reopen. */
+typedef int (*conmon_log_sink_reopen_cb)(void *opaque);
+
+/* Stop the sink before conmon exits.  Exported as conmon_log_sink_stop. */
+typedef int (*conmon_log_sink_stop_cb)(void *opaque);
+
+#endif // LOG_SINK_PLUGIN_H
@@ -0,0 +1,527 @@
+#include "loop.h"
+#include "utils.h"
+
+#include <errno.h>
+#include <glib.h>
+#include <glib-unix.h>
+#include <stdint.h>
+#include <unistd.h>
+
+#ifdef __linux__
+#include <sys/prctl.h>
+#endif
+
+void loop_set_timer_slack(guint slack_ms)
+{
+#ifdef PR_SET_TIMERSLACK
+	if (prctl(PR_SET_TIMERSLACK, (unsigned long)slack_ms * 1000000UL, 0, 0, 0) < 0)
+		pwarn("Failed to set the timer slack");
+#else
+	(void)slack_ms;
+#endif
+}
+
+#ifndef USE_EPOLL_LOOP
+
+/* GLib backend: the default, and the only one available outside Linux. */
+
+static GMainLoop *main_loop = NULL;
+
+void loop_init(void)
+{
+	main_loop = g_main_loop_new(NULL, FALSE);
+}
+
+void loop_run(void)
+{
+	g_main_loop_run(main_loop);
+}
+
+void loop_quit(void)
+{
+	g_main_loop_quit(main_loop);
+}
+
+guint loop_add_fd(int fd, GIOCondition condition, GUnixFDSourceFunc cb, gpointer user_data)
+{
+	return g_unix_fd_add(fd, condition, cb, user_data);
+}
+
+guint loop_add_timeout(guint interval_ms, GSourceFunc cb, gpointer user_data)
+{
+	return g_timeout_add(interval_ms, cb, user_data);
+}
+
+guint loop_add_timeout_seconds(guint interval, GSourceFunc cb, gpointer user_data)
+{
+	return g_timeout_add_seconds(interval, cb, user_data);
+}
+
+guint loop_add_idle(GSourceFunc cb, gpointer user_data)
+{
+	return g_idle_add(cb, user_data);
+}
+
+void loop_remove(guint tag)
+{
+	g_source_remove(tag);
+}
+
+void loop_close_fd(int fd)
+{
+	/* Nothing to unregister: GLib rebuilds its poll set on every iteration. */
+	close(fd);
+}
+
+#else /* USE_EPOLL_LOOP */
+
+#ifndef __linux__
+#error the epoll event loop is only available on Linux
+#endif
+
+#include <sys/epoll.h>
+
+/*
+ * Native epoll backend.
+ *
+ * Every fd gets a single epoll registration (a "watch") no matter how many
+ * sources are attached to it, and the registration is only modified when the
+ * union of the requested conditions changes.  Registrations are level
+ * triggered: the stdio and socket callbacks read one buffer per dispatch and
+ * rely on being called again while data is pending, exactly as with GLib.
+ *
+ * Sources are referred to by tag, never by pointer, while callbacks run: a
+ * callback is free to remove any source (including its own) or close fds,
+ * and the dispatcher looks the tag up again before touching the source.
+ */
+
+#define MAX_EVENTS 32
+
+typedef enum {
+	SOURCE_FD,
+	SOURCE_TIMEOUT,
+	SOURCE_IDLE,
+} source_kind_t;
+
+struct loop_source {
+	guint tag;
+	source_kind_t kind;
+	gpointer user_data;
+
+	/* SOURCE_FD */
+	int fd;
+	GIOCondition condition;
+	GUnixFDSourceFunc fd_cb;
+
+	/* SOURCE_TIMEOUT and SOURCE_IDLE */
+	GSourceFunc cb;
+	gint64 interval_us;
+	gint64 deadline_us;
+	gboolean whole_seconds; /* fire on whole seconds of the monotonic clock */
+};
+
+struct loop_watch {
+	int fd;
+	guint32 serial;	   /* distinguishes reuse of the same fd number */
+	guint32 registered; /* epoll events currently registered */
+	gboolean polled;    /* fd cannot be added to epoll (e.g. a regular file) */
+	GPtrArray *tags;
+};
+
+static int epoll_fd = -1;
+static gboolean running = FALSE;
+static guint next_tag = 0;
+static guint32 next_serial = 0;
+
+static GHashTable *sources = NULL; /* tag -> struct loop_source */
+static GHashTable *watches = NULL; /* fd -> struct loop_watch */
+static GPtrArray *timers = NULL;   /* tags of SOURCE_TIMEOUT sources */
+static GPtrArray *idles = NULL;	   /* tags of SOURCE_IDLE sources */
+static guint polled_watches = 0;
+
+static guint32 condition_to_epoll(GIOCondition condition)
+{
+	guint32 events = 0;
+
+	if (condition & G_IO_IN)
+		events |= EPOLLIN;
+	if (condition & G_IO_OUT)
+		events |= EPOLLOUT;
+	if (condition & G_IO_PRI)
+		events |= EPOLLPRI;
+	return events;
+}
+
+static GIOCondition epoll_to_condition(guint32 events)
+{
+	GIOCondition condition = 0;
+
+	if (events & EPOLLIN)
+		condition |= G_IO_IN;
+	if (events & EPOLLOUT)
+		condition |= G_IO_OUT;
+	if (events & EPOLLPRI)
+		condition |= G_IO_PRI;
+	if (events & EPOLLERR)
+		condition |= G_IO_ERR;
+	if (events & (EPOLLHUP | EPOLLRDHUP))
+		condition |= G_IO_HUP;
+	return condition;
+}
+
+static guint alloc_tag(void)
+{
+	do {
+		next_tag++;
+	} while (next_tag == 0 || g_hash_table_lookup(sources, GUINT_TO_POINTER(next_tag)) != NULL);
+	return next_tag;
+}
+
+static struct loop_source *lookup_source(guint tag)
+{
+	return g_hash_table_lookup(sources, GUINT_TO_POINTER(tag));
+}
+
+static void watch_update(struct loop_watch *watch)
+{
+	guint32 events = 0;
+
+	for (guint i = 0; i < watch->tags->len; i++) {
+		struct loop_source *source = lookup_source(GPOINTER_TO_UINT(g_ptr_array_index(watch->tags, i)));
+		if (source != NULL)
+			events |= condition_to_epoll(source->condition);
+	}
+
+	if (watch->tags->len == 0) {
+		if (watch->polled)
+			polled_watches--;
+		else if (epoll_ctl(epoll_fd, EPOLL_CTL_DEL, watch->fd, NULL) < 0 && errno != EBADF && errno != ENOENT)
+			nwarnf("Failed to remove fd %d from epoll", watch->fd);
+		g_hash_table_remove(watches, GINT_TO_POINTER(watch->fd));
+		g_ptr_array_free(watch->tags, TRUE);
+		g_free(watch);
+		return;
+	}
+
+	if (watch->polled || events == watch->registered)
+		return;
+
+	struct epoll_event ev = {
+		.events = events,
+		.data.u64 = ((uint64_t)watch->serial << 32) | (uint32_t)watch->fd,
+	};
+	if (epoll_ctl(epoll_fd, EPOLL_CTL_MOD, watch->fd, &ev) < 0)
+		pexitf("Failed to modify epoll registration of fd %d", watch->fd);
+	watch->registered = events;
+}
+
+static void source_destroy(struct loop_source *source)
+{
+	gpointer tag = GUINT_TO_POINTER(source->tag);
+
+	g_hash_table_remove(sources, tag);
+
+	switch (source->kind) {
+	case SOURCE_FD: {
+		struct loop_watch *watch = g_hash_table_lookup(watches, GINT_TO_POINTER(source->fd));
+		if (watch != NULL) {
+			g_ptr_array_remove(watch->tags, tag);
+			watch_update(watch);
+		}
+		break;
+	}
+	case SOURCE_TIMEOUT:
+		g_ptr_array_remove(timers, tag);
+		break;
+	case SOURCE_IDLE:
+		g_ptr_array_remove(idles, tag);
+		break;
+	}
+
+	g_free(source);
+}
+
+static struct loop_source *source_new(source_kind_t kind, gpointer user_data)
+{
+	struct loop_source *source = g_new0(struct loop_source, 1);
+
+	source->tag = alloc_tag();
+	source->kind = kind;
+	source->user_data = user_data;
+	source->fd = -1;
+	g_hash_table_insert(sources, GUINT_TO_POINTER(source->tag), source);
+	return source;
+}
+
+void loop_init(void)
+{
+	epoll_fd = epoll_create1(EPOLL_CLOEXEC);
+	if (epoll_fd < 0)
+		pexit("Failed to create epoll instance");
+
+	sources = g_hash_table_new(g_direct_hash, g_direct_equal);
+	watches = g_hash_table_new(g_direct_hash, g_direct_equal);
+	timers = g_ptr_array_new();
+	idles = g_ptr_array_new();
+}
+
+void loop_quit(void)
+{
+	running = FALSE;
+}
+
+guint loop_add_fd(int fd, GIOCondition condition, GUnixFDSourceFunc cb, gpointer user_data)
+{
+	struct loop_watch *watch = g_hash_table_lookup(watches, GINT_TO_POINTER(fd));
+
+	if (watch == NULL) {
+		watch = g_new0(struct loop_watch, 1);
+		watch->fd = fd;
+		watch->serial = ++next_serial;
+		watch->tags = g_ptr_array_new();
+
+		struct epoll_event ev = {
+			.events = condition_to_epoll(condition),
+			.data.u64 = ((uint64_t)watch->serial << 32) | (uint32_t)fd,
+		};
+		if (epoll_ctl(epoll_fd, EPOLL_CTL_ADD, fd, &ev) == 0) {
+			watch->registered = ev.events;
+		} else if (errno == EPERM) {
+			/* poll(2) reports regular files as always ready; do the same. */
+			watch->polled = TRUE;
+			polled_watches++;
+		} else {
+			pexitf("Failed to add fd %d to epoll", fd);
+		}
+		g_hash_table_insert(watches, GINT_TO_POINTER(fd), watch);
+	}
+
+	struct loop_source *source = source_new(SOURCE_FD, user_data);
+	source->fd = fd;
+	source->condition = condition;
+	source->fd_cb = cb;
+
+	g_ptr_array_add(watch->tags, GUINT_TO_POINTER(source->tag));
+	watch_update(watch);
+	return source->tag;
+}
+
+/*
+ * Like g_timeout_add_seconds(), second timers are rounded up to whole
+ * seconds.  The monotonic clock is shared by the whole node, so every timer
+ * of every conmon due in the same second fires on the same tick, and the
+ * timer slack lets the kernel merge those wakeups further.
+ */
+static void timer_schedule(struct loop_source *source, gint64 now)
+{
+	source->deadline_us = now + source->interval_us;
+	if (source->whole_seconds)
+		source->deadline_us = (source->deadline_us + G_USEC_PER_SEC - 1) / G_USEC_PER_SEC * G_USEC_PER_SEC;
+}
+
+static guint add_timer(gint64 interval_us, gboolean whole_seconds, GSourceFunc cb, gpointer user_data)
+{
+	struct loop_source *source = source_new(SOURCE_TIMEOUT, user_data);
+
+	source->cb = cb;
+	source->interval_us = interval_us;
+	source->whole_seconds = whole_seconds;
+	timer_schedule(source, g_get_monotonic_time());
+	g_ptr_array_add(timers, GUINT_TO_POINTER(source->tag));
+	return source->tag;
+}
+
+guint loop_add_timeout(guint interval_ms, GSourceFunc cb, gpointer user_data)
+{
+	return add_timer((gint64)interval_ms * 1000, FALSE, cb, user_data);
+}
+
+guint loop_add_timeout_seconds(guint interval, GSourceFunc cb, gpointer user_data)
+{
+	return add_timer((gint64)interval * G_USEC_PER_SEC, TRUE, cb, user_data);
+}
+
+guint loop_add_idle(GSourceFunc cb, gpointer user_data)
+{
+	struct loop_source *source = source_new(SOURCE_IDLE, user_data);
+
+	source->cb = cb;
+	g_ptr_array_add(idles, GUINT_TO_POINTER(source->tag));
+	return source->tag;
+}
+
+void loop_remove(guint tag)
+{
+	struct loop_source *source = lookup_source(tag);
+
+	if (source == NULL) {
+		ndebugf("Source ID %u was not found when attempting to remove it", tag);
+		return;
+	}
+	source_destroy(source);
+}
+
+void loop_close_fd(int fd)
+{
+	struct loop_watch *watch = g_hash_table_lookup(watches, GINT_TO_POINTER(fd));
+
+	/* Drop the registration before the fd number can be reused, otherwise
+	 * the kernel keeps reporting events for the old file description. */
+	while (watch != NULL) {
+		struct loop_source *source = lookup_source(GPOINTER_TO_UINT(g_ptr_array_index(watch->tags, 0)));
+		if (source == NULL)
+			break;
+		source_destroy(source);
+		watch = g_hash_table_lookup(watches, GINT_TO_POINTER(fd));
+	}
+	close(fd);
+}
+
+/* Dispatch every fd source of WATCH interested in REVENTS. */
+static void dispatch_watch(struct loop_watch *watch, GIOCondition revents)
+{
+	int fd = watch->fd;
+	guint32 serial = watch->serial;
+	guint n = watch->tags->len;
+	guint tags[n > 0 ? n : 1];
+
+	for (guint i = 0; i < n; i++)
+		tags[i] = GPOINTER_TO_UINT(g_ptr_array_index(watch->tags, i));
+
+	for (guint i = 0; i < n; i++) {
+		/* An earlier callback may have closed the fd and another one may
+		 * since have been registered under the same number. */
+		watch = g_hash_table_lookup(watches, GINT_TO_POINTER(fd));
+		if (watch == NULL || watch->serial != serial)
+			return;
+
+		struct loop_source *source = lookup_source(tags[i]);
+		if (source == NULL)
+			continue;
+
+		GIOCondition ready = revents & (source->condition | G_IO_HUP | G_IO_ERR | G_IO_NVAL);
+		if (!ready)
+			continue;
+
+		if (source->fd_cb(fd, ready, source->user_data) == G_SOURCE_REMOVE) {
+			source = lookup_source(tags[i]);
+			if (source != NULL)
+				source_destroy(source);
+		}
+	}
+}
+
+static void dispatch_polled(void)
+{
+	GHashTableIter iter;
+	gpointer value;
+	GPtrArray *ready = g_ptr_array_new();
+
+	g_hash_table_iter_init(&iter, watches);
+	while (g_hash_table_iter_next(&iter, NULL, &value)) {
+		struct loop_watch *watch = value;
+		if (watch->polled)
+			g_ptr_array_add(ready, GINT_TO_POINTER(watch->fd));
+	}
+
+	for (guint i = 0; i < ready->len; i++) {
+		struct loop_watch *watch = g_hash_table_lookup(watches, g_ptr_array_index(ready, i));
+		if (watch != NULL && watch->polled)
+			dispatch_watch(watch, G_IO_IN | G_IO_OUT);
+	}
+	g_ptr_array_free(ready, TRUE);
+}
+
+/* Run the due callbacks of LIST (timers or idles) from a snapshot of its tags. */
+static guint dispatch_sources(GPtrArray *list, gint64 now)
+{
+	guint n = list->len;
+	guint tags[n > 0 ? n : 1];
+	guint dispatched = 0;
+
+	for (guint i = 0; i < n; i++)
+		tags[i] = GPOINTER_TO_UINT(g_ptr_array_index(list, i));
+
+	for (guint i = 0; i < n; i++) {
+		struct loop_source *source = lookup_source(tags[i]);
+		if (source == NULL)
+			continue;
+		if (source->kind == SOURCE_TIMEOUT && source->deadline_us > now)
+			continue;
+
+		dispatched++;
+		gboolean keep = source->cb(source->user_data);
+
+		source = lookup_source(tags[i]);
+		if (source == NULL)
+			continue;
+		if (keep == G_SOURCE_REMOVE)
+			source_destroy(source);
+		else if (source->kind == SOURCE_TIMEOUT)
+			timer_schedule(source, g_get_monotonic_time());
+	}
+	return dispatched;
+}
+
+static int next_timeout_ms(void)
+{
+	gint64 deadline = -1;
+
+	if (idles->len > 0 || polled_watches > 0)
+		return 0;
+
+	for (guint i = 0; i < timers->len; i++) {
+		struct loop_source *source = lookup_source(GPOINTER_TO_UINT(g_ptr_array_index(timers, i)));
+		if (source != NULL && (deadline < 0 || source->deadline_us < deadline))
+			deadline = source->deadline_us;
+	}
+	if (deadline < 0)
+		return -1;
+
+	gint64 now = g_get_monotonic_time();
+	if (deadline <= now)
+		return 0;
+	/* round up so we never wake up just before a deadline */
+	gint64 ms = (deadline - now + 999) / 1000;
+	return ms > INT_MAX ? INT_MAX : (int)ms;
+}
+
+static void loop_iterate(void)
+{
+	struct epoll_event events[MAX_EVENTS];
+	int nfds;
+
+	do {
+		nfds = epoll_wait(epoll_fd, events, MAX_EVENTS, next_timeout_ms());
+	} while (nfds < 0 && errno == EINTR);
+	if (nfds < 0)
+		pexit("Failed to wait for events");
+
+	for (int i = 0; i < nfds; i++) {
+		int fd = (int)(uint32_t)events[i].data.u64;
+		guint32 serial = (guint32)(events[i].data.u64 >> 32);
+		struct loop_watch *watch = g_hash_table_lookup(watches, GINT_TO_POINTER(fd));
+
+		if (watch == NULL || watch->serial != serial)
+			continue;
+		dispatch_watch(watch, epoll_to_condition(events[i].events));
+	}
+
+	if (polled_watches > 0)
+		dispatch_polled();
+
+	guint fired = dispatch_sources(timers, g_get_monotonic_time());
+
+	/* Like GLib idles, only run when nothing else was ready. */
+	if (nfds == 0 && fired == 0 && polled_watches == 0)
+		dispatch_sources(idles, 0);
+}
+
+void loop_run(void)
+{
+	running = TRUE;
+	while (running)
+		loop_iterate();
+}
+
+#endif /* USE_EPOLL_LOOP */
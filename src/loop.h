@@ -0,0 +1,34 @@
+#if !defined(LOOP_H)
+#define LOOP_H
+
+#include <glib.h> /* gboolean, gpointer, GIOCondition and GSourceFunc */
+#include <glib-unix.h> /* GUnixFDSourceFunc */
+
+/*
+ * The event loop conmon runs on.  By default this is a thin wrapper around
+ * the GLib main loop.  Building with USE_EPOLL_LOOP selects a native epoll
+ * engine instead, which keeps one registration per fd and avoids allocating
+ * a GSource and rebuilding the poll array every time a source is re-armed.
+ *
+ * Callbacks keep the GLib signatures and return G_SOURCE_CONTINUE or
+ * G_SOURCE_REMOVE.  Tags returned by the loop_add_* functions are never 0.
+ */
+void loop_init(void);
+void loop_run(void);
+void loop_quit(void);
+
+guint loop_add_fd(int fd, GIOCondition condition, GUnixFDSourceFunc cb, gpointer user_data);
+guint loop_add_timeout(guint interval_ms, GSourceFunc cb, gpointer user_data);
+guint loop_add_timeout_seconds(guint interval, GSourceFunc cb, gpointer user_data);
+guint loop_add_idle(GSourceFunc cb, gpointer user_data);
+void loop_remove(guint tag);
+
+/* Let the kernel defer timer wakeups by up to slack_ms so that they can be
+ * merged with other wakeups on the node (Linux only). */
+void loop_set_timer_slack(guint slack_ms);
+
+/* Close an fd that may still have sources attached to it.  Any such source
+ * is dropped first, so the fd must not be used by the caller afterwards. */
+void loop_close_fd(int fd);
+
+#endif // LOOP_H
@@ -0,0 +1,147 @@
+#include "multimatch.h"
+#include "utils.h"
+
+#include <string.h>
+
+#define REGEX_PREFIX "re:"
+
+struct multimatch {
+	/* Bytes that occur in no substring share class 0 */
+	guint8 classes[256];
+	guint n_classes;
+	/* Aho-Corasick automaton, with the failure links folded into the
+	 * transitions so that every byte is a single table lookup */
+	guint n_states;
+	guint32 *delta; /* n_states * n_classes */
+	bool *accepting;
+	GRegex *regex;
+};
+
+static gboolean is_regex(const gchar *pattern)
+{
+	return g_str_has_prefix(pattern, REGEX_PREFIX);
+}
+
+static void build_automaton(struct multimatch *mm, gchar **patterns)
+{
+	guint max_states = 1;
+
+	for (gchar **p = patterns; *p != NULL; p++) {
+		if (is_regex(*p))
+			continue;
+		for (const guchar *c = (const guchar *)*p; *c != '\0'; c++) {
+			if (mm->classes[*c] == 0)
+				mm->classes[*c] = mm->n_classes++;
+		}
+		max_states += strlen(*p);
+	}
+
+	/* Build the trie.  The root is never the target of an edge, so 0 marks a
+	 * missing edge while building. */
+	mm->delta = g_new0(guint32, (gsize)max_states * mm->n_classes);
+	mm->accepting = g_new0(bool, max_states);
+	mm->n_states = 1;
+	for (gchar **p = patterns; *p != NULL; p++) {
+		if (is_regex(*p))
+			continue;
+		guint32 state = 0;
+		for (const guchar *c = (const guchar *)*p; *c != '\0'; c++) {
+			guint32 *next = &mm->delta[state * mm->n_classes + mm->classes[*c]];
+			if (*next == 0)
+				*next = mm->n_states++;
+			state = *next;
+		}
+		mm->accepting[state] = true;
+	}
+
+	/* Breadth first, so the failure state of a state is complete before
+	 * the state itself is visited. */
+	_cleanup_free_ guint32 *fail = g_new0(guint32, mm->n_states);
+	_cleanup_free_ guint32 *queue = g_new(guint32, mm->n_states);
+	guint head = 0, tail = 0;
+
+	for (guint c = 0; c < mm->n_classes; c++) {
+		if (mm->delta[c] != 0)
+			queue[tail++] = mm->delta[c];
+	}
+	while (head < tail) {
+		guint32 state = queue[head++];
+		guint32 *row = &mm->delta[state * mm->n_classes];
+		const guint32 *fail_row = &mm->delta[fail[state] * mm->n_classes];
+
+		mm->accepting[state] = mm->accepting[state] || mm->accepting[fail[state]];
+		for (guint c = 0; c < mm->n_classes; c++) {
+			if (row[c] != 0) {
+				fail[row[c]] = fail_row[c];
+				queue[tail++] = row[c];
+			} else {
+				row[c] = fail_row[c];
+			}
+		}
+	}
+}
+
+static gboolean build_regex(struct multimatch *mm, gchar **patterns, GError **error)
+{
+	GString *alternation = NULL;
+
+	for (gchar **p = patterns; *p != NULL; p++) {
+		if (!is_regex(*p))
+			continue;
+		if (alternation == NULL)
+			alternation = g_string_new(NULL);
+		else
+			g_string_append_c(alternation, '|');
+		g_string_append_printf(alternation, "(?:%s)", *p + strlen(REGEX_PREFIX));
+	}
+	if (alternation == NULL)
+		return TRUE;
+
+	mm->regex = g_regex_new(alternation->str, G_REGEX_OPTIMIZE | G_REGEX_RAW, 0, error);
+	g_string_free(alternation, TRUE);
+	return mm->regex != NULL;
+}
+
+struct multimatch *multimatch_new(gchar **patterns, GError **error)
+{
+	for (gchar **p = patterns; *p != NULL; p++) {
+		if (**p == '\0' || g_str_equal(*p, REGEX_PREFIX)) {
+			g_set_error_literal(error, G_OPTION_ERROR, G_OPTION_ERROR_BAD_VALUE, "empty pattern");
+			return NULL;
+		}
+	}
+
+	struct multimatch *mm = g_new0(struct multimatch, 1);
+	mm->n_classes = 1;
+	build_automaton(mm, patterns);
+	if (!build_regex(mm, patterns, error)) {
+		multimatch_free(mm);
+		return NULL;
+	}
+	return mm;
+}
+
+bool multimatch_search(const struct multimatch *mm, const char *text, size_t len)
+{
+	/* Only the root state: there are no substrings */
+	if (mm->n_states > 1) {
+		guint32 state = 0;
+		for (size_t i = 0; i < len; i++) {
+			state = mm->delta[state * mm->n_classes + mm->classes[(guchar)text[i]]];
+			if (mm->accepting[state])
+				return true;
+		}
+	}
+	return mm->regex != NULL && g_regex_match_full(mm->regex, text, len, 0, 0, NULL, NULL);
+}
+
+void multimatch_free(struct multimatch *mm)
+{
+	if (mm == NULL)
+		return;
+	g_free(mm->delta);
+	g_free(mm->accepting);
+	if (mm->regex != NULL)
+		g_regex_unref(mm->regex);
+	g_free(mm);
+}
@@ -0,0 +1,21 @@
+#if !defined(MULTIMATCH_H)
+#define MULTIMATCH_H
+
+#include <glib.h>    /* gchar */
+#include <stdbool.h> /* bool */
+#include <stddef.h>  /* size_t */
+
+/*
+ * A set of patterns matched against a line in one pass.  Patterns are
+ * substrings, or regular expressions if they start with "re:".  The
+ * substrings are compiled into a single Aho-Corasick automaton and the
+ * regular expressions into a single alternation.
+ */
+struct multimatch;
+
+/* Returns NULL and sets *error if a pattern is empty or not a valid regex. */
+struct multimatch *multimatch_new(gchar **patterns, GError **error);
+bool multimatch_search(const struct multimatch *mm, const char *text, size_t len);
+void multimatch_free(struct multimatch *mm);
+
+#endif // MULTIMATCH_H
@@ -6,8 +6,6 @@
 
 int sync_pipe_fd = -1;
 
-static char *escape_json_string(const char *str);
-
 int get_pipe_fd_from_env(const char *envname)
 {
 	char *endptr = NULL;
@@ -72,7 +70,7 @@ void write_or_close_sync_fd(int *fd, int res, const char *message)
 	}
 }
 
-static char *escape_json_string(const char *str)
+char *escape_json_string(const char *str)
 {
 	if (str == NULL) {
 		return NULL;
@@ -4,6 +4,7 @@
 
 void write_or_close_sync_fd(int *fd, int res, const char *message);
 int get_pipe_fd_from_env(const char *envname);
+char *escape_json_string(const char *str);
 extern int sync_pipe_fd;
 
 
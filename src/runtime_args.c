@@ -86,6 +86,35 @@ GPtrArray *configure_runtime_args(const char *const csname)
 	return runtime_argv;
 }
 
+/*
+ * Arguments for an exec session started by the monitoring conmon (see
+ * exec_session.c).  The strings are borrowed, so the caller keeps them alive
+ * until the returned array is freed.
+ */
+GPtrArray *configure_exec_session_args(const char *pid_file, const char *process_spec, GPtrArray *exec_opts)
+{
+	GPtrArray *runtime_argv = g_ptr_array_new();
+	add_argv(runtime_argv, opt_runtime_path, NULL);
+
+	if (opt_runtime_args) {
+		size_t n_runtime_args = 0;
+		while (opt_runtime_args[n_runtime_args])
+			add_argv(runtime_argv, opt_runtime_args[n_runtime_args++], NULL);
+	}
+
+	add_argv(runtime_argv, "exec", "--pid-file", pid_file, "--process", process_spec, "--detach", NULL);
+
+	for (guint i = 0; exec_opts != NULL && i < exec_opts->len; i++)
+		add_argv(runtime_argv, g_ptr_array_index(exec_opts, i), NULL);
+
+	add_argv(runtime_argv, opt_cid, NULL);
+	end_argv(runtime_argv);
+
+	print_argv(runtime_argv);
+
+	return runtime_argv;
+}
+
 static void print_argv(GPtrArray *runtime_argv)
 {
 	if (log_level != TRACE_LEVEL)
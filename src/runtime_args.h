@@ -4,5 +4,6 @@
 #include <glib.h>
 
 GPtrArray *configure_runtime_args(const char *const csname);
+GPtrArray *configure_exec_session_args(const char *pid_file, const char *process_spec, GPtrArray *exec_opts);
 
 #endif // RUNTIME_ARGS_H
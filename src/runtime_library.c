@@ -0,0 +1,78 @@
+#define _GNU_SOURCE
+
+#include "runtime_library.h"
+#include "runtime_library_plugin.h"
+#include "utils.h"
+#include "close_fds.h"
+
+#include <dlfcn.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+static conmon_runtime_main_cb runtime_main = NULL;
+
+void runtime_library_load(const char *path)
+{
+	/* The handle stays open for the lifetime of conmon. */
+	void *handle = dlopen(path, RTLD_NOW);
+	if (handle == NULL)
+		nexitf("cannot load `%s`: %s", path, dlerror());
+
+	conmon_runtime_version_cb version_cb = (conmon_runtime_version_cb)dlsym(handle, "conmon_runtime_version");
+	if (version_cb == NULL)
+		nexitf("runtime library `%s` doesn't export `conmon_runtime_version`", path);
+	if (version_cb() != CONMON_RUNTIME_LIBRARY_VERSION)
+		nexitf("invalid version supported by the runtime library `%s`", path);
+
+	runtime_main = (conmon_runtime_main_cb)dlsym(handle, "conmon_runtime_main");
+	if (runtime_main == NULL)
+		nexitf("runtime library `%s` doesn't export `conmon_runtime_main`", path);
+
+	ndebugf("loaded runtime library %s", path);
+}
+
+/* Number of fds from 3 on that the runtime passes to the container: the
+ * --preserve-fds of the runtime options and the socket activation fds. */
+static int inherited_fds(GPtrArray *runtime_argv)
+{
+	int n = 0;
+
+	for (guint i = 0; i + 1 < runtime_argv->len; i++) {
+		const char *arg = g_ptr_array_index(runtime_argv, i);
+		if (g_str_has_prefix(arg, "--preserve-fds="))
+			n = MAX(n, atoi(arg + strlen("--preserve-fds=")));
+		else if (strcmp(arg, "--preserve-fds") == 0 && i + 2 < runtime_argv->len)
+			n = MAX(n, atoi(g_ptr_array_index(runtime_argv, i + 1)));
+	}
+
+	const char *listen_fds = getenv("LISTEN_FDS");
+	if (listen_fds != NULL && getenv("LISTEN_PID") != NULL)
+		n = MAX(n, atoi(listen_fds));
+
+	return n;
+}
+
+void exec_runtime(GPtrArray *runtime_argv)
+{
+	if (runtime_main != NULL) {
+		/*
+		 * Nothing closes our O_CLOEXEC fds without an execv, so the
+		 * library would see the log files, sockets and pipes of conmon.
+		 * Only stdio and the fds meant for the container are kept.
+		 */
+		int n_keep = inherited_fds(runtime_argv);
+		_cleanup_free_ int *keep = g_new(int, MAX(n_keep, 1));
+		for (int i = 0; i < n_keep; i++)
+			keep[i] = 3 + i;
+		close_all_fds_ge_than_except(3, keep, n_keep);
+
+		int ret = runtime_main(runtime_argv->len - 1, (char **)runtime_argv->pdata);
+		/* Skip conmon's atexit handlers, they belong to the parent. */
+		fflush(NULL);
+		_exit(ret);
+	}
+
+	execv(g_ptr_array_index(runtime_argv, 0), (char **)runtime_argv->pdata);
+}
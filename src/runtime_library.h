@@ -0,0 +1,17 @@
+#if !defined(RUNTIME_LIBRARY_H)
+#define RUNTIME_LIBRARY_H
+
+#include <glib.h> /* GPtrArray */
+
+/* Load the runtime library at path; exits on failure. */
+void runtime_library_load(const char *path);
+
+/*
+ * Run the runtime with the NULL-terminated runtime_argv in the current,
+ * forked, process: through the runtime library if one is loaded, otherwise
+ * by executing the runtime binary.  Returns only if the binary could not be
+ * executed.
+ */
+void exec_runtime(GPtrArray *runtime_argv);
+
+#endif // RUNTIME_LIBRARY_H
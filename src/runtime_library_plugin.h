@@ -0,0 +1,28 @@
+#ifndef RUNTIME_LIBRARY_PLUGIN_H
+#define RUNTIME_LIBRARY_PLUGIN_H
+
+/*
+ * Interface of a runtime library loaded with --runtime-library.
+ *
+ * Instead of executing the runtime binary, conmon calls the library in the
+ * child it forked for the runtime, with the same arguments, standard streams
+ * and environment the binary would have been executed with.  This saves the
+ * exec and dynamic linking of the runtime for every create, restore and exec.
+ * A library for crun only has to hand the arguments to libcrun the way the
+ * crun command line does.
+ */
+
+/* Version of this interface. */
+#define CONMON_RUNTIME_LIBRARY_VERSION 1
+
+/* Retrieve the interface version implemented by the library.  It MUST be
+   exported as conmon_runtime_version and return CONMON_RUNTIME_LIBRARY_VERSION. */
+typedef int (*conmon_runtime_version_cb)(void);
+
+/* Run the runtime command in argv (argv[0] is the --runtime path) and return
+   its exit status.  It MUST be exported as conmon_runtime_main.  Called in a
+   forked child that exits with the returned status; the library must not
+   rely on atexit handlers. */
+typedef int (*conmon_runtime_main_cb)(int argc, char **argv);
+
+#endif // RUNTIME_LIBRARY_PLUGIN_H
@@ -6,6 +6,9 @@
 #endif
 
 #include <errno.h>
+#include <poll.h>
+#include <pthread.h>
+#include <sys/eventfd.h>
 #include <sys/ioctl.h>
 #include <sys/wait.h>
 #include <sys/mount.h>
@@ -30,39 +33,96 @@
 #define SECCOMP_USER_NOTIF_FLAG_CONTINUE (1UL << 0)
 #endif
 
+/* Bucket i of a latency histogram counts times below 2^i us, the last one the rest */
+#define LATENCY_BUCKETS 16
+
+/* Once full, the decision cache starts over */
+#define DECISION_CACHE_MAX 1024
+#define SECCOMP_ARGS 6
+
 static struct seccomp_notify_context_s *seccomp_notify_ctx;
 
+struct histogram {
+	guint64 buckets[LATENCY_BUCKETS];
+	guint64 count;
+	guint64 sum_us;
+	guint64 max_us;
+};
+
 struct plugin {
+	char *path;
 	void *handle;
 	void *opaque;
 	run_oci_seccomp_notify_handle_request_cb handle_request_cb;
+	/* Time spent in handle_request_cb, under stats_lock */
+	struct histogram time;
+};
+
+/* A handler thread, with its own request and response buffers. */
+struct worker {
+	pthread_t thread;
+	struct seccomp_notify_context_s *ctx;
+	struct seccomp_notif_resp *sresp;
+	struct seccomp_notif *sreq;
+};
+
+struct decision_key {
+	int nr;
+	uint32_t arch;
+	uint32_t arg_mask;
+	uint64_t args[SECCOMP_ARGS];
+};
+
+struct decision {
+	struct decision_key key;
+	int64_t val;
+	int32_t error;
+	uint32_t flags;
 };
 
 struct seccomp_notify_context_s {
 	struct plugin *plugins;
 	size_t n_plugins;
 
-	struct seccomp_notif_resp *sresp;
-	struct seccomp_notif *sreq;
+	/* Responses marked with RUN_OCI_SECCOMP_NOTIFY_HANDLE_CACHEABLE */
+	pthread_mutex_t cache_lock;
+	GHashTable *arg_masks; /* nr << 32 | arch -> arguments the decision depends on */
+	GHashTable *decisions; /* struct decision_key -> struct decision */
+	guint64 cache_hits;
+	guint64 cache_misses;
+
+	/* Telemetry, dumped by seccomp_notify_dump_stats() */
+	pthread_mutex_t stats_lock;
+	GHashTable *syscalls; /* nr -> guint64 count */
+	struct histogram latency;
+	guint64 notifications;
+	guint64 enotsup;
+	guint64 plugin_errors;
+	guint64 delayed;
+	guint64 send_errors;
+	guint in_flight;
+	guint in_flight_peak;
+
 	struct seccomp_notif_sizes sizes;
+
+	int seccomp_fd;
+	/* Written to stop the workers */
+	int stop_fd;
+	/* Held from polling the listener to SECCOMP_IOCTL_NOTIF_RECV, which
+	   ignores O_NONBLOCK and would otherwise block a worker that lost
+	   the race for a notification. */
+	pthread_mutex_t recv_lock;
+	struct worker *workers;
+	size_t n_workers;
 };
 
 static inline void *xmalloc0(size_t size);
 static void cleanup_seccomp_plugins();
+static int seccomp_notify_start_workers(struct seccomp_notify_context_s *ctx, int seccomp_fd, size_t n_workers);
 
 static int seccomp_syscall(unsigned int op, unsigned int flags, void *args);
-
-gboolean seccomp_cb(int fd, GIOCondition condition, G_GNUC_UNUSED gpointer user_data)
-{
-	if (condition & G_IO_IN) {
-		if (seccomp_notify_ctx == NULL)
-			return G_SOURCE_REMOVE;
-
-		int ret = seccomp_notify_plugins_event(seccomp_notify_ctx, fd);
-		return ret == 0 ? G_SOURCE_CONTINUE : G_SOURCE_REMOVE;
-	}
-	return G_SOURCE_CONTINUE;
-}
+static guint decision_key_hash(gconstpointer key);
+static gboolean decision_key_equal(gconstpointer a, gconstpointer b);
 
 gboolean seccomp_accept_cb(int fd, G_GNUC_UNUSED GIOCondition condition, G_GNUC_UNUSED gpointer user_data)
 {
@@ -99,8 +159,13 @@ gboolean seccomp_accept_cb(int fd, G_GNUC_UNUSED GIOCondition condition, G_GNUC_
 		return G_SOURCE_CONTINUE;
 	}
 
-	g_unix_set_fd_nonblocking(listener.fd, TRUE, NULL);
-	g_unix_fd_add(listener.fd, G_IO_IN | G_IO_HUP, seccomp_cb, NULL);
+	/* The workers run the plugins, the main loop never does. */
+	if (seccomp_notify_start_workers(seccomp_notify_ctx, listener.fd, opt_seccomp_notify_threads) < 0) {
+		nwarn("Failed to start the seccomp notification handlers");
+		/* This closes the listener too */
+		cleanup_seccomp_plugins();
+		return G_SOURCE_CONTINUE;
+	}
 	atexit(cleanup_seccomp_plugins);
 
 	return G_SOURCE_CONTINUE;
@@ -113,13 +178,19 @@ int seccomp_notify_plugins_load(struct seccomp_notify_context_s **out, const cha
 	char *it, *saveptr;
 	size_t s;
 
+	ctx->seccomp_fd = -1;
+	ctx->stop_fd = -1;
+	pthread_mutex_init(&ctx->recv_lock, NULL);
+	pthread_mutex_init(&ctx->cache_lock, NULL);
+	pthread_mutex_init(&ctx->stats_lock, NULL);
+	ctx->syscalls = g_hash_table_new_full(g_direct_hash, g_direct_equal, NULL, g_free);
+	ctx->arg_masks = g_hash_table_new_full(g_int64_hash, g_int64_equal, g_free, NULL);
+	ctx->decisions = g_hash_table_new_full(decision_key_hash, decision_key_equal, NULL, g_free);
+
 	if (seccomp_syscall(SECCOMP_GET_NOTIF_SIZES, 0, &ctx->sizes) < 0) {
 		pexit("Failed to get notifications size");
 	}
 
-	ctx->sreq = xmalloc0(ctx->sizes.seccomp_notif);
-	ctx->sresp = xmalloc0(ctx->sizes.seccomp_notif_resp);
-
 	ctx->n_plugins = 1;
 	for (it = b; it; it = strchr(it, ':'))
 		ctx->n_plugins++;
@@ -135,6 +206,7 @@ int seccomp_notify_plugins_load(struct seccomp_notify_context_s **out, const cha
 		run_oci_seccomp_notify_start_cb start_cb;
 		void *opq = NULL;
 
+		ctx->plugins[s].path = strdup(it);
 		ctx->plugins[s].handle = dlopen(it, RTLD_NOW);
 		if (ctx->plugins[s].handle == NULL) {
 			pexitf("cannot load `%s`: %s", it, dlerror());
@@ -174,50 +246,222 @@ int seccomp_notify_plugins_load(struct seccomp_notify_context_s **out, const cha
 	return 0;
 }
 
-int seccomp_notify_plugins_event(struct seccomp_notify_context_s *ctx, int seccomp_fd)
+static void histogram_add(struct histogram *h, guint64 us)
+{
+	int bucket = 0;
+
+	while (bucket < LATENCY_BUCKETS - 1 && us >= (1ULL << bucket))
+		bucket++;
+	h->buckets[bucket]++;
+	h->count++;
+	h->sum_us += us;
+	h->max_us = MAX(h->max_us, us);
+}
+
+static void histogram_print(GString *out, const char *name, const struct histogram *h)
+{
+	g_string_append_printf(out, "%s count=%" G_GUINT64_FORMAT " sum_us=%" G_GUINT64_FORMAT " max_us=%" G_GUINT64_FORMAT, name,
+			       h->count, h->sum_us, h->max_us);
+	for (int i = 0; i < LATENCY_BUCKETS - 1; i++)
+		g_string_append_printf(out, " lt_%llu=%" G_GUINT64_FORMAT, 1ULL << i, h->buckets[i]);
+	g_string_append_printf(out, " inf=%" G_GUINT64_FORMAT "\n", h->buckets[LATENCY_BUCKETS - 1]);
+}
+
+static void stats_count(struct seccomp_notify_context_s *ctx, guint64 *counter)
+{
+	pthread_mutex_lock(&ctx->stats_lock);
+	(*counter)++;
+	pthread_mutex_unlock(&ctx->stats_lock);
+}
+
+static void stats_begin(struct seccomp_notify_context_s *ctx, const struct seccomp_notif *sreq)
+{
+	pthread_mutex_lock(&ctx->stats_lock);
+	ctx->notifications++;
+	ctx->in_flight++;
+	ctx->in_flight_peak = MAX(ctx->in_flight_peak, ctx->in_flight);
+
+	guint64 *count = g_hash_table_lookup(ctx->syscalls, GINT_TO_POINTER(sreq->data.nr));
+	if (count == NULL) {
+		count = g_new0(guint64, 1);
+		g_hash_table_insert(ctx->syscalls, GINT_TO_POINTER(sreq->data.nr), count);
+	}
+	(*count)++;
+	pthread_mutex_unlock(&ctx->stats_lock);
+}
+
+static void stats_end(struct seccomp_notify_context_s *ctx, gint64 start)
+{
+	pthread_mutex_lock(&ctx->stats_lock);
+	ctx->in_flight--;
+	histogram_add(&ctx->latency, g_get_monotonic_time() - start);
+	pthread_mutex_unlock(&ctx->stats_lock);
+}
+
+/* Receive the next pending notification into sreq.  Returns 1 if there was
+ * one, 0 if the listener is drained and -1 on errors. */
+static int seccomp_notify_recv(struct seccomp_notify_context_s *ctx, struct seccomp_notif *sreq)
+{
+	struct pollfd pfd = {.fd = ctx->seccomp_fd, .events = POLLIN};
+	int ret = 0;
+
+	pthread_mutex_lock(&ctx->recv_lock);
+	if (poll(&pfd, 1, 0) > 0 && (pfd.revents & POLLIN)) {
+		memset(sreq, 0, ctx->sizes.seccomp_notif);
+		ret = ioctl(ctx->seccomp_fd, SECCOMP_IOCTL_NOTIF_RECV, sreq) < 0 ? -1 : 1;
+		/* The trapped task went away before we got to it */
+		if (ret < 0 && (errno == ENOENT || errno == EINTR))
+			ret = 0;
+		else if (ret < 0)
+			nwarnf("Failed to read notification from %d", ctx->seccomp_fd);
+	}
+	pthread_mutex_unlock(&ctx->recv_lock);
+	return ret;
+}
+
+static guint decision_key_hash(gconstpointer key)
+{
+	const struct decision_key *k = key;
+	guint h = k->nr * 31 + k->arch;
+
+	for (int i = 0; i < SECCOMP_ARGS; i++)
+		h = h * 31 + (guint)(k->args[i] ^ (k->args[i] >> 32));
+	return h;
+}
+
+static gboolean decision_key_equal(gconstpointer a, gconstpointer b)
+{
+	return memcmp(a, b, sizeof(struct decision_key)) == 0;
+}
+
+static void decision_key_init(struct decision_key *key, const struct seccomp_notif *sreq, uint32_t arg_mask)
+{
+	memset(key, 0, sizeof(*key));
+	key->nr = sreq->data.nr;
+	key->arch = sreq->data.arch;
+	key->arg_mask = arg_mask;
+	for (int i = 0; i < SECCOMP_ARGS; i++) {
+		if (arg_mask & (1U << i))
+			key->args[i] = sreq->data.args[i];
+	}
+}
+
+static gint64 syscall_key(const struct seccomp_notif *sreq)
+{
+	return (gint64)sreq->data.nr << 32 | sreq->data.arch;
+}
+
+/* Fill sresp from the cache.  Returns true on a hit. */
+static bool decision_cache_lookup(struct seccomp_notify_context_s *ctx, const struct seccomp_notif *sreq,
+				  struct seccomp_notif_resp *sresp)
+{
+	gint64 sc = syscall_key(sreq);
+	gpointer arg_mask;
+	bool hit = false;
+
+	pthread_mutex_lock(&ctx->cache_lock);
+	if (g_hash_table_lookup_extended(ctx->arg_masks, &sc, NULL, &arg_mask)) {
+		struct decision_key key;
+
+		decision_key_init(&key, sreq, GPOINTER_TO_UINT(arg_mask));
+		struct decision *d = g_hash_table_lookup(ctx->decisions, &key);
+		if (d != NULL) {
+			sresp->val = d->val;
+			sresp->error = d->error;
+			sresp->flags = d->flags;
+			hit = true;
+		}
+	}
+	if (hit)
+		ctx->cache_hits++;
+	else
+		ctx->cache_misses++;
+	pthread_mutex_unlock(&ctx->cache_lock);
+	return hit;
+}
+
+static void decision_cache_insert(struct seccomp_notify_context_s *ctx, const struct seccomp_notif *sreq,
+				  const struct seccomp_notif_resp *sresp, uint32_t arg_mask)
+{
+	struct decision *d = g_new0(struct decision, 1);
+	gint64 *sc = g_new(gint64, 1);
+
+	*sc = syscall_key(sreq);
+	decision_key_init(&d->key, sreq, arg_mask);
+	d->val = sresp->val;
+	d->error = sresp->error;
+	d->flags = sresp->flags;
+
+	pthread_mutex_lock(&ctx->cache_lock);
+	if (g_hash_table_size(ctx->decisions) >= DECISION_CACHE_MAX) {
+		g_hash_table_remove_all(ctx->decisions);
+		g_hash_table_remove_all(ctx->arg_masks);
+	}
+	/* A plugin that changes the mask of a syscall makes older entries unreachable */
+	g_hash_table_insert(ctx->arg_masks, sc, GUINT_TO_POINTER(arg_mask));
+	g_hash_table_insert(ctx->decisions, &d->key, d);
+	pthread_mutex_unlock(&ctx->cache_lock);
+}
+
+int seccomp_notify_plugins_event(struct seccomp_notify_context_s *ctx, int seccomp_fd, struct seccomp_notif *sreq,
+				 struct seccomp_notif_resp *sresp)
 {
 	size_t i;
 	int ret;
 	bool handled = false;
+	int cache_flags = 0;
 
-	memset(ctx->sreq, 0, ctx->sizes.seccomp_notif);
-	memset(ctx->sresp, 0, ctx->sizes.seccomp_notif_resp);
+	memset(sresp, 0, ctx->sizes.seccomp_notif_resp);
 
-	ret = ioctl(seccomp_fd, SECCOMP_IOCTL_NOTIF_RECV, ctx->sreq);
-	if (ret < 0) {
-		if (errno == ENOENT)
-			return 0;
-		nwarnf("Failed to read notification from %d", seccomp_fd);
-		return -1;
+	/* Don't act on behalf of a task that is gone, its pid may be reused already */
+	if (ioctl(seccomp_fd, SECCOMP_IOCTL_NOTIF_ID_VALID, &sreq->id) < 0)
+		return 0;
+
+	if (decision_cache_lookup(ctx, sreq, sresp)) {
+		handled = true;
+		goto send;
 	}
 
 	for (i = 0; i < ctx->n_plugins; i++) {
 		if (ctx->plugins[i].handle_request_cb) {
 			int resp_handled = 0;
 			int ret;
+			gint64 start = g_get_monotonic_time();
 
-			ret = ctx->plugins[i].handle_request_cb(ctx->plugins[i].opaque, &ctx->sizes, ctx->sreq, ctx->sresp, seccomp_fd,
+			ret = ctx->plugins[i].handle_request_cb(ctx->plugins[i].opaque, &ctx->sizes, sreq, sresp, seccomp_fd,
 								&resp_handled);
+
+			pthread_mutex_lock(&ctx->stats_lock);
+			histogram_add(&ctx->plugins[i].time, g_get_monotonic_time() - start);
+			pthread_mutex_unlock(&ctx->stats_lock);
 			if (ret != 0) {
+				/* Answer anyway, or the task stays blocked in the syscall */
 				nwarnf("Failed to handle seccomp notification from fd %d", seccomp_fd);
-				return -1;
+				stats_count(ctx, &ctx->plugin_errors);
+				memset(sresp, 0, ctx->sizes.seccomp_notif_resp);
+				sresp->error = -ENOTSUP;
+				goto send;
 			}
 
-			switch (resp_handled) {
+			switch (resp_handled & RUN_OCI_SECCOMP_NOTIFY_HANDLE_ACTION_MASK) {
 			case RUN_OCI_SECCOMP_NOTIFY_HANDLE_NOT_HANDLED:
 				break;
 
 			case RUN_OCI_SECCOMP_NOTIFY_HANDLE_SEND_RESPONSE:
 				handled = true;
+				/* The last plugin to fill the response decides whether it can be cached */
+				cache_flags = resp_handled;
 				break;
 
 			/* The plugin will take care of it.  */
 			case RUN_OCI_SECCOMP_NOTIFY_HANDLE_DELAYED_RESPONSE:
+				stats_count(ctx, &ctx->delayed);
 				return 0;
 
 			case RUN_OCI_SECCOMP_NOTIFY_HANDLE_SEND_RESPONSE_AND_CONTINUE:
-				ctx->sresp->flags |= SECCOMP_USER_NOTIF_FLAG_CONTINUE;
+				sresp->flags |= SECCOMP_USER_NOTIF_FLAG_CONTINUE;
 				handled = true;
+				cache_flags = resp_handled;
 				break;
 
 			default:
@@ -228,21 +472,99 @@ int seccomp_notify_plugins_event(struct seccomp_notify_context_s *ctx, int secco
 
 	/* No plugin could handle the request.  */
 	if (!handled) {
-		ctx->sresp->error = -ENOTSUP;
-		ctx->sresp->flags = 0;
+		sresp->error = -ENOTSUP;
+		sresp->flags = 0;
+		stats_count(ctx, &ctx->enotsup);
+	} else if (cache_flags & RUN_OCI_SECCOMP_NOTIFY_HANDLE_CACHEABLE) {
+		decision_cache_insert(ctx, sreq, sresp, (cache_flags / RUN_OCI_SECCOMP_NOTIFY_CACHE_ARG(0)) & ((1U << SECCOMP_ARGS) - 1));
 	}
 
-	ctx->sresp->id = ctx->sreq->id;
-	ret = ioctl(seccomp_fd, SECCOMP_IOCTL_NOTIF_SEND, ctx->sresp);
+send:
+	sresp->id = sreq->id;
+	ret = ioctl(seccomp_fd, SECCOMP_IOCTL_NOTIF_SEND, sresp);
 	if (ret < 0) {
 		if (errno == ENOENT)
 			return 0;
+		ret = -errno;
+		stats_count(ctx, &ctx->send_errors);
 		nwarnf("Failed to send seccomp notification on fd %d", seccomp_fd);
-		return -errno;
+		return ret;
 	}
 	return 0;
 }
 
+static void *seccomp_notify_worker(void *arg)
+{
+	struct worker *w = arg;
+	struct seccomp_notify_context_s *ctx = w->ctx;
+	struct pollfd fds[2] = {
+		{.fd = ctx->seccomp_fd, .events = POLLIN},
+		{.fd = ctx->stop_fd, .events = POLLIN},
+	};
+
+	for (;;) {
+		if (poll(fds, 2, -1) < 0) {
+			if (errno == EINTR)
+				continue;
+			nwarn("Failed to poll the seccomp listener");
+			break;
+		}
+		if (fds[1].revents)
+			break;
+
+		/* Drain the listener, another worker may take some of them */
+		int ret;
+		while ((ret = seccomp_notify_recv(ctx, w->sreq)) > 0) {
+			gint64 start = g_get_monotonic_time();
+
+			stats_begin(ctx, w->sreq);
+			int event_ret = seccomp_notify_plugins_event(ctx, ctx->seccomp_fd, w->sreq, w->sresp);
+			stats_end(ctx, start);
+			if (event_ret < 0)
+				break;
+		}
+
+		/* Every task using the filter is gone */
+		if (ret < 0 || (fds[0].revents & (POLLHUP | POLLERR | POLLNVAL)))
+			break;
+	}
+	return NULL;
+}
+
+static int seccomp_notify_start_workers(struct seccomp_notify_context_s *ctx, int seccomp_fd, size_t n_workers)
+{
+	sigset_t all, old;
+
+	ctx->seccomp_fd = seccomp_fd;
+	ctx->stop_fd = eventfd(0, EFD_CLOEXEC);
+	if (ctx->stop_fd < 0)
+		return -1;
+
+	ctx->workers = xmalloc0(sizeof(struct worker) * n_workers);
+
+	/* Signals are handled by the main loop through the signalfd */
+	sigfillset(&all);
+	pthread_sigmask(SIG_BLOCK, &all, &old);
+	for (size_t i = 0; i < n_workers; i++) {
+		struct worker *w = &ctx->workers[i];
+
+		w->ctx = ctx;
+		w->sreq = xmalloc0(ctx->sizes.seccomp_notif);
+		w->sresp = xmalloc0(ctx->sizes.seccomp_notif_resp);
+		errno = pthread_create(&w->thread, NULL, seccomp_notify_worker, w);
+		if (errno != 0) {
+			nwarn("Failed to create seccomp notification handler thread");
+			free(w->sreq);
+			free(w->sresp);
+			break;
+		}
+		ctx->n_workers++;
+	}
+	pthread_sigmask(SIG_SETMASK, &old, NULL);
+
+	return ctx->n_workers > 0 ? 0 : -1;
+}
+
 int seccomp_notify_plugins_free(struct seccomp_notify_context_s *ctx)
 {
 	size_t i;
@@ -252,8 +574,33 @@ int seccomp_notify_plugins_free(struct seccomp_notify_context_s *ctx)
 		return -1;
 	}
 
-	free(ctx->sreq);
-	free(ctx->sresp);
+	/* Let the workers finish the request they are on before the plugins stop */
+	if (ctx->stop_fd >= 0) {
+		uint64_t one = 1;
+		if (write(ctx->stop_fd, &one, sizeof(one)) < 0)
+			nwarn("Failed to stop the seccomp notification handlers");
+	}
+	for (i = 0; i < ctx->n_workers; i++) {
+		pthread_join(ctx->workers[i].thread, NULL);
+		free(ctx->workers[i].sreq);
+		free(ctx->workers[i].sresp);
+	}
+	free(ctx->workers);
+
+	if (ctx->cache_hits > 0 || g_hash_table_size(ctx->decisions) > 0)
+		ninfof("Seccomp decision cache: %" G_GUINT64_FORMAT " hits, %" G_GUINT64_FORMAT " misses", ctx->cache_hits,
+		       ctx->cache_misses);
+	g_hash_table_destroy(ctx->decisions);
+	g_hash_table_destroy(ctx->arg_masks);
+	pthread_mutex_destroy(&ctx->cache_lock);
+	g_hash_table_destroy(ctx->syscalls);
+	pthread_mutex_destroy(&ctx->stats_lock);
+
+	if (ctx->stop_fd >= 0)
+		close(ctx->stop_fd);
+	if (ctx->seccomp_fd >= 0)
+		close(ctx->seccomp_fd);
+	pthread_mutex_destroy(&ctx->recv_lock);
 
 	for (i = 0; i < ctx->n_plugins; i++) {
 		if (ctx->plugins && ctx->plugins[i].handle) {
@@ -264,6 +611,8 @@ int seccomp_notify_plugins_free(struct seccomp_notify_context_s *ctx)
 				cb(ctx->plugins[i].opaque);
 			dlclose(ctx->plugins[i].handle);
 		}
+		if (ctx->plugins)
+			free(ctx->plugins[i].path);
 	}
 
 	free(ctx);
@@ -271,6 +620,53 @@ int seccomp_notify_plugins_free(struct seccomp_notify_context_s *ctx)
 	return 0;
 }
 
+void seccomp_notify_dump_stats(void)
+{
+	_cleanup_gerror_ GError *err = NULL;
+	struct seccomp_notify_context_s *ctx = seccomp_notify_ctx;
+	GHashTableIter iter;
+	gpointer key, value;
+
+	if (ctx == NULL || opt_bundle_path == NULL)
+		return;
+
+	GString *out = g_string_new(NULL);
+
+	pthread_mutex_lock(&ctx->cache_lock);
+	g_string_append_printf(out, "cache_hits %" G_GUINT64_FORMAT "\ncache_misses %" G_GUINT64_FORMAT "\ncache_entries %u\n", ctx->cache_hits,
+			       ctx->cache_misses, g_hash_table_size(ctx->decisions));
+	pthread_mutex_unlock(&ctx->cache_lock);
+
+	pthread_mutex_lock(&ctx->stats_lock);
+	g_string_append_printf(out,
+			       "notifications %" G_GUINT64_FORMAT "\n"
+			       "enotsup %" G_GUINT64_FORMAT "\n"
+			       "plugin_errors %" G_GUINT64_FORMAT "\n"
+			       "delayed %" G_GUINT64_FORMAT "\n"
+			       "send_errors %" G_GUINT64_FORMAT "\n"
+			       "in_flight %u\n"
+			       "in_flight_peak %u\n"
+			       "workers %zu\n",
+			       ctx->notifications, ctx->enotsup, ctx->plugin_errors, ctx->delayed, ctx->send_errors, ctx->in_flight, ctx->in_flight_peak,
+			       ctx->n_workers);
+	histogram_print(out, "latency", &ctx->latency);
+	for (size_t i = 0; i < ctx->n_plugins; i++) {
+		if (ctx->plugins[i].path == NULL)
+			continue;
+		_cleanup_free_ char *name = g_strdup_printf("plugin %s", ctx->plugins[i].path);
+		histogram_print(out, name, &ctx->plugins[i].time);
+	}
+	g_hash_table_iter_init(&iter, ctx->syscalls);
+	while (g_hash_table_iter_next(&iter, &key, &value))
+		g_string_append_printf(out, "syscall %d %" G_GUINT64_FORMAT "\n", GPOINTER_TO_INT(key), *(guint64 *)value);
+	pthread_mutex_unlock(&ctx->stats_lock);
+
+	_cleanup_free_ char *path = g_build_filename(opt_bundle_path, "seccomp-notify-stats", NULL);
+	if (!g_file_set_contents(path, out->str, out->len, &err))
+		nwarnf("Failed to write %s: %s", path, err->message);
+	g_string_free(out, TRUE);
+}
+
 static void cleanup_seccomp_plugins()
 {
 	if (seccomp_notify_ctx) {
@@ -302,6 +698,10 @@ static int seccomp_syscall(unsigned int op, unsigned int flags, void *args)
 	return syscall(__NR_seccomp, op, flags, args);
 }
 #else
+void seccomp_notify_dump_stats(void)
+{
+}
+
 gboolean seccomp_accept_cb(G_GNUC_UNUSED int fd, G_GNUC_UNUSED GIOCondition condition, G_GNUC_UNUSED gpointer user_data)
 {
 	pexit("seccomp support not available");
@@ -20,6 +20,15 @@ struct seccomp_notify_conf_s {
 /* Specify SECCOMP_USER_NOTIF_FLAG_CONTINUE in the flags.  */
 #define RUN_OCI_SECCOMP_NOTIFY_HANDLE_SEND_RESPONSE_AND_CONTINUE 3
 
+/* Optional flags, OR-ed into HANDLED with RUN_OCI_SECCOMP_NOTIFY_HANDLE_SEND_RESPONSE or
+   RUN_OCI_SECCOMP_NOTIFY_HANDLE_SEND_RESPONSE_AND_CONTINUE.  CACHEABLE lets conmon answer every later
+   request for the same syscall and architecture with this response, without calling the plugins, as long
+   as the arguments selected with RUN_OCI_SECCOMP_NOTIFY_CACHE_ARG are the same too.  Only use it for
+   responses that depend on nothing but those.  */
+#define RUN_OCI_SECCOMP_NOTIFY_HANDLE_CACHEABLE (1 << 8)
+#define RUN_OCI_SECCOMP_NOTIFY_CACHE_ARG(n) (1 << (9 + (n)))
+#define RUN_OCI_SECCOMP_NOTIFY_HANDLE_ACTION_MASK 0xff
+
 /* Configure the plugin.  Return an opaque pointer that will be used for successive calls.  */
 typedef int (*run_oci_seccomp_notify_start_cb)(void **opaque, struct seccomp_notify_conf_s *conf, size_t size_configuration);
 
@@ -0,0 +1,96 @@
+#define _GNU_SOURCE
+
+#include "spawn.h"
+#include "utils.h"
+
+#include <errno.h>
+#include <signal.h>
+#include <spawn.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+extern char **environ;
+
+int open_pidfd(pid_t pid)
+{
+#ifdef __NR_pidfd_open
+	/* pidfd_open(2) fds are always close-on-exec */
+	return syscall(__NR_pidfd_open, pid, 0);
+#else
+	(void)pid;
+	errno = ENOSYS;
+	return -1;
+#endif
+}
+
+static int add_dup2(posix_spawn_file_actions_t *actions, int fd, int target)
+{
+	if (fd < 0)
+		return 0;
+	return posix_spawn_file_actions_adddup2(actions, fd, target);
+}
+
+pid_t spawn_process(char *const argv[], const struct spawn_stdio *stdio, gboolean search_path, int *pidfd)
+{
+	posix_spawn_file_actions_t actions;
+	posix_spawnattr_t attr;
+	sigset_t mask, defaults;
+	pid_t pid = -1;
+	int ret;
+
+	if (pidfd)
+		*pidfd = -1;
+
+	if ((ret = posix_spawn_file_actions_init(&actions)) != 0) {
+		errno = ret;
+		return -1;
+	}
+	if ((ret = posix_spawnattr_init(&attr)) != 0) {
+		posix_spawn_file_actions_destroy(&actions);
+		errno = ret;
+		return -1;
+	}
+
+	if (stdio != NULL) {
+		if ((ret = add_dup2(&actions, stdio->in, STDIN_FILENO)) != 0 || (ret = add_dup2(&actions, stdio->out, STDOUT_FILENO)) != 0
+		    || (ret = add_dup2(&actions, stdio->err, STDERR_FILENO)) != 0)
+			goto out;
+	}
+
+	/*
+	 * conmon blocks SIGCHLD, SIGUSR1 and SIGUSR2 for its signalfd and ignores
+	 * SIGPIPE; neither survives into the child.
+	 */
+	sigemptyset(&mask);
+	sigemptyset(&defaults);
+	sigaddset(&defaults, SIGPIPE);
+	sigaddset(&defaults, SIGCHLD);
+	if ((ret = posix_spawnattr_setsigmask(&attr, &mask)) != 0 || (ret = posix_spawnattr_setsigdefault(&attr, &defaults)) != 0
+	    || (ret = posix_spawnattr_setflags(&attr, POSIX_SPAWN_SETSIGMASK | POSIX_SPAWN_SETSIGDEF)) != 0)
+		goto out;
+
+	/* glibc implements this with CLONE_VM | CLONE_VFORK, so the cost does
+	 * not depend on how much memory conmon has mapped. */
+	if (search_path)
+		ret = posix_spawnp(&pid, argv[0], &actions, &attr, argv, environ);
+	else
+		ret = posix_spawn(&pid, argv[0], &actions, &attr, argv, environ);
+	if (ret != 0) {
+		pid = -1;
+		goto out;
+	}
+
+	/* The child cannot be reaped (and its pid reused) before we wait for it. */
+	if (pidfd) {
+		*pidfd = open_pidfd(pid);
+		if (*pidfd < 0)
+			ndebugf("pidfd_open(%d) failed: %m", pid);
+	}
+
+out:
+	posix_spawnattr_destroy(&attr);
+	posix_spawn_file_actions_destroy(&actions);
+	if (ret != 0)
+		errno = ret;
+	return pid;
+}
@@ -0,0 +1,27 @@
+#if !defined(SPAWN_H)
+#define SPAWN_H
+
+#include <glib.h>      /* gboolean */
+#include <sys/types.h> /* pid_t */
+
+/* Standard streams of a spawned process; -1 keeps conmon's own. */
+struct spawn_stdio {
+	int in;
+	int out;
+	int err;
+};
+
+/*
+ * Start argv[0] (looked up in PATH when search_path is set) without copying
+ * conmon's address space.  The child starts with an empty signal mask and
+ * default SIGPIPE/SIGCHLD handling.  If pidfd is not NULL it receives a pidfd
+ * for the child, or -1 when the kernel does not support them.
+ *
+ * Returns the pid of the child, or -1 with errno set.
+ */
+pid_t spawn_process(char *const argv[], const struct spawn_stdio *stdio, gboolean search_path, int *pidfd);
+
+/* Returns a close-on-exec pidfd for pid, or -1 with errno set. */
+int open_pidfd(pid_t pid);
+
+#endif // SPAWN_H
@@ -0,0 +1,209 @@
+#define _GNU_SOURCE
+
+#include "stats.h"
+#include "loop.h"
+#include "utils.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <glib.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <unistd.h>
+
+enum { STAT_CPU, STAT_MEMORY_CURRENT, STAT_MEMORY_PEAK, STAT_IO, STAT_PIDS, N_STAT_FILES };
+
+static const char *const stat_file_names[N_STAT_FILES] = {"cpu.stat", "memory.current", "memory.peak", "io.stat", "pids.current"};
+static int stat_fds[N_STAT_FILES] = {-1, -1, -1, -1, -1};
+
+static struct stats_file *stats_map = NULL;
+static char *stats_dir = NULL;
+static guint stats_timer = 0;
+static uint64_t memory_peak = 0;
+static uint64_t pids_peak = 0;
+
+/* Returns FALSE if the file is missing or the cgroup is gone. */
+static gboolean read_stat_file(int i, char *buf, size_t size)
+{
+	if (stat_fds[i] < 0)
+		return FALSE;
+
+	ssize_t num_read = pread(stat_fds[i], buf, size - 1, 0);
+	if (num_read < 0) {
+		/* Files of a removed cgroup fail with ENODEV */
+		if (errno != ENODEV)
+			nwarnf("Failed to read %s", stat_file_names[i]);
+		return FALSE;
+	}
+	buf[num_read] = '\0';
+	return TRUE;
+}
+
+/* Value of a "<key> <value>" line of a flat keyed file such as cpu.stat */
+static uint64_t keyed_value(const char *buf, const char *key)
+{
+	size_t key_len = strlen(key);
+
+	const char *line = buf;
+	while (line != NULL) {
+		if (strncmp(line, key, key_len) == 0 && line[key_len] == ' ')
+			return strtoull(line + key_len + 1, NULL, 10);
+		line = strchr(line, '\n');
+		if (line != NULL)
+			line++;
+	}
+	return 0;
+}
+
+/* Sum of a "key=value" field over all the devices listed in io.stat */
+static uint64_t nested_sum(const char *buf, const char *field)
+{
+	uint64_t sum = 0;
+	size_t field_len = strlen(field);
+
+	for (const char *p = strstr(buf, field); p != NULL; p = strstr(p + field_len, field))
+		sum += strtoull(p + field_len, NULL, 10);
+	return sum;
+}
+
+static gboolean take_sample(struct stats_sample *sample)
+{
+	char buf[4096];
+
+	memset(sample, 0, sizeof(*sample));
+	sample->time_us = g_get_real_time();
+
+	/* cpu.stat always exists, so it tells whether the cgroup is still there */
+	if (!read_stat_file(STAT_CPU, buf, sizeof(buf)))
+		return FALSE;
+	sample->cpu_usage_usec = keyed_value(buf, "usage_usec");
+	sample->cpu_user_usec = keyed_value(buf, "user_usec");
+	sample->cpu_system_usec = keyed_value(buf, "system_usec");
+
+	if (read_stat_file(STAT_MEMORY_CURRENT, buf, sizeof(buf)))
+		sample->memory_current = strtoull(buf, NULL, 10);
+	/* memory.peak is only there since Linux 5.19, fall back to our samples */
+	if (read_stat_file(STAT_MEMORY_PEAK, buf, sizeof(buf)))
+		sample->memory_peak = strtoull(buf, NULL, 10);
+	memory_peak = MAX(memory_peak, MAX(sample->memory_peak, sample->memory_current));
+	sample->memory_peak = memory_peak;
+
+	if (read_stat_file(STAT_IO, buf, sizeof(buf))) {
+		sample->io_rbytes = nested_sum(buf, " rbytes=");
+		sample->io_wbytes = nested_sum(buf, " wbytes=");
+	}
+
+	if (read_stat_file(STAT_PIDS, buf, sizeof(buf)))
+		sample->pids_current = strtoull(buf, NULL, 10);
+	pids_peak = MAX(pids_peak, sample->pids_current);
+
+	return TRUE;
+}
+
+static void publish_sample(const struct stats_sample *sample)
+{
+	/* seqlock: odd while the sample is being written */
+	__atomic_store_n(&stats_map->seq, stats_map->seq + 1, __ATOMIC_RELAXED);
+	__atomic_thread_fence(__ATOMIC_RELEASE);
+
+	stats_map->latest = *sample;
+	stats_map->history[stats_map->samples % STATS_HISTORY] = *sample;
+	stats_map->samples++;
+
+	__atomic_store_n(&stats_map->seq, stats_map->seq + 1, __ATOMIC_RELEASE);
+}
+
+static gboolean stats_cb(G_GNUC_UNUSED gpointer user_data)
+{
+	struct stats_sample sample;
+
+	if (!take_sample(&sample)) {
+		ndebug("Cgroup is gone, stopping the resource sampler");
+		stats_timer = 0;
+		return G_SOURCE_REMOVE;
+	}
+	publish_sample(&sample);
+	return G_SOURCE_CONTINUE;
+}
+
+void stats_start(const char *cgroup_path, const char *dir, int interval)
+{
+	if (cgroup_path == NULL) {
+		nwarn("Resource sampling needs the cgroup v2 path of the container");
+		return;
+	}
+
+	for (int i = 0; i < N_STAT_FILES; i++) {
+		_cleanup_free_ char *path = g_build_filename(cgroup_path, stat_file_names[i], NULL);
+		stat_fds[i] = open(path, O_RDONLY | O_CLOEXEC);
+		if (stat_fds[i] < 0 && errno != ENOENT)
+			nwarnf("Failed to open %s", path);
+	}
+
+	_cleanup_free_ char *path = g_build_filename(dir, "stats", NULL);
+	_cleanup_close_ int fd = open(path, O_RDWR | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+	if (fd < 0) {
+		nwarnf("Failed to create %s", path);
+		return;
+	}
+	if (ftruncate(fd, sizeof(struct stats_file)) < 0) {
+		nwarnf("Failed to size %s", path);
+		return;
+	}
+	void *map = mmap(NULL, sizeof(struct stats_file), PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+	if (map == MAP_FAILED) {
+		nwarnf("Failed to map %s", path);
+		return;
+	}
+
+	stats_map = map;
+	memcpy(stats_map->magic, STATS_MAGIC, sizeof(stats_map->magic));
+	stats_map->version = STATS_VERSION;
+	stats_map->history_len = STATS_HISTORY;
+	stats_map->interval_us = (uint64_t)interval * G_USEC_PER_SEC;
+	stats_dir = g_strdup(dir);
+
+	stats_cb(NULL);
+	stats_timer = loop_add_timeout_seconds(interval, stats_cb, NULL);
+}
+
+void stats_finish(void)
+{
+	_cleanup_gerror_ GError *err = NULL;
+	struct stats_sample sample;
+
+	if (stats_map == NULL)
+		return;
+
+	if (stats_timer != 0)
+		loop_remove(stats_timer);
+	if (take_sample(&sample))
+		publish_sample(&sample);
+
+	const struct stats_sample *last = &stats_map->latest;
+	_cleanup_free_ char *summary = g_strdup_printf("cpu_usage_usec %" G_GUINT64_FORMAT "\n"
+						       "cpu_user_usec %" G_GUINT64_FORMAT "\n"
+						       "cpu_system_usec %" G_GUINT64_FORMAT "\n"
+						       "memory_peak %" G_GUINT64_FORMAT "\n"
+						       "io_rbytes %" G_GUINT64_FORMAT "\n"
+						       "io_wbytes %" G_GUINT64_FORMAT "\n"
+						       "pids_peak %" G_GUINT64_FORMAT "\n"
+						       "samples %" G_GUINT64_FORMAT "\n",
+						       (guint64)last->cpu_usage_usec, (guint64)last->cpu_user_usec,
+						       (guint64)last->cpu_system_usec, (guint64)memory_peak, (guint64)last->io_rbytes,
+						       (guint64)last->io_wbytes, (guint64)pids_peak, (guint64)stats_map->samples);
+	_cleanup_free_ char *path = g_build_filename(stats_dir, "stats-summary", NULL);
+	if (!g_file_set_contents(path, summary, -1, &err))
+		nwarnf("Failed to write %s: %s", path, err->message);
+
+	munmap(stats_map, sizeof(struct stats_file));
+	stats_map = NULL;
+	g_free(stats_dir);
+	stats_dir = NULL;
+	for (int i = 0; i < N_STAT_FILES; i++) {
+		if (stat_fds[i] >= 0)
+			close(stat_fds[i]);
+		stat_fds[i] = -1;
+	}
+}
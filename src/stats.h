@@ -0,0 +1,52 @@
+#if !defined(STATS_H)
+#define STATS_H
+
+#include <stdint.h> /* uint32_t, uint64_t */
+
+/*
+ * Resource sampler.  With --stats-interval, conmon keeps the cgroup v2 stat
+ * files of the container open, re-reads them with pread() every interval and
+ * publishes the samples in the file "stats" in the bundle directory, which it
+ * keeps mapped.  Readers map or read the file and never touch the cgroup.
+ *
+ * The file holds one struct stats_file in host byte order.  The writer bumps
+ * seq to an odd value before changing anything and to the next even value
+ * afterwards: a reader copies the struct and retries if seq was odd or changed
+ * in between.  history is a ring of the last STATS_HISTORY samples, the latest
+ * one at index (samples - 1) % STATS_HISTORY.  hack/conmon-stats.py reads it.
+ *
+ * When the container exits, the totals and peaks are written to
+ * "stats-summary" next to it, one "<key> <value>" line each.
+ */
+
+#define STATS_MAGIC "CONMONST"
+#define STATS_VERSION 1
+#define STATS_HISTORY 64
+
+struct stats_sample {
+	uint64_t time_us; /* CLOCK_REALTIME */
+	uint64_t cpu_usage_usec;
+	uint64_t cpu_user_usec;
+	uint64_t cpu_system_usec;
+	uint64_t memory_current;
+	uint64_t memory_peak;
+	uint64_t io_rbytes;
+	uint64_t io_wbytes;
+	uint64_t pids_current;
+};
+
+struct stats_file {
+	char magic[8];
+	uint32_t version;
+	uint32_t history_len;
+	uint64_t interval_us;
+	uint64_t seq;
+	uint64_t samples;
+	struct stats_sample latest;
+	struct stats_sample history[STATS_HISTORY];
+};
+
+void stats_start(const char *cgroup_path, const char *dir, int interval);
+void stats_finish(void);
+
+#endif // STATS_H
@@ -0,0 +1,49 @@
+#define _GNU_SOURCE
+
+#include "trace.h"
+#include "utils.h"
+
+#include <glib.h>
+
+#define TRACE_MAX_PHASES 32
+
+struct trace_point {
+	const char *phase;
+	gint64 time;
+};
+
+static gint64 trace_t0 = 0;
+static struct trace_point trace_points[TRACE_MAX_PHASES];
+static guint n_trace_points = 0;
+
+void trace_start(void)
+{
+	trace_t0 = g_get_monotonic_time();
+	n_trace_points = 0;
+}
+
+void trace_phase(const char *phase)
+{
+	if (n_trace_points == TRACE_MAX_PHASES)
+		return;
+	trace_points[n_trace_points].phase = phase;
+	trace_points[n_trace_points].time = g_get_monotonic_time();
+	n_trace_points++;
+}
+
+void trace_write(const char *dir)
+{
+	_cleanup_gerror_ GError *err = NULL;
+
+	if (dir == NULL)
+		return;
+
+	GString *out = g_string_sized_new(n_trace_points * 32);
+	for (guint i = 0; i < n_trace_points; i++)
+		g_string_append_printf(out, "%" G_GINT64_FORMAT " %s\n", trace_points[i].time - trace_t0, trace_points[i].phase);
+
+	_cleanup_free_ char *path = g_build_filename(dir, "conmon-startup.trace", NULL);
+	if (!g_file_set_contents(path, out->str, out->len, &err))
+		nwarnf("Failed to write startup trace %s: %s", path, err->message);
+	g_string_free(out, TRUE);
+}
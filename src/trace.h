@@ -0,0 +1,15 @@
+#if !defined(TRACE_H)
+#define TRACE_H
+
+/*
+ * Startup trace.  Phases are always recorded (a clock read each), and with
+ * --startup-trace they are written to conmon-startup.trace in the bundle
+ * directory once the container pid was reported, one "<usec> <phase>" line
+ * each, relative to the start of conmon, or to the fork of a monitor by the
+ * zygote.
+ */
+void trace_start(void);
+void trace_phase(const char *phase);
+void trace_write(const char *dir);
+
+#endif // TRACE_H
@@ -16,6 +16,24 @@ log_level_t log_level = WARN_LEVEL;
 char *log_cid = NULL;
 gboolean use_syslog = FALSE;
 
+/* Map the name of a log level to its log_level_t, FALSE if it is unknown */
+gboolean parse_log_level(const char *level_name, log_level_t *level)
+{
+	if (!strcasecmp(level_name, "error") || !strcasecmp(level_name, "fatal") || !strcasecmp(level_name, "panic"))
+		*level = EXIT_LEVEL;
+	else if (!strcasecmp(level_name, "warn") || !strcasecmp(level_name, "warning"))
+		*level = WARN_LEVEL;
+	else if (!strcasecmp(level_name, "info"))
+		*level = INFO_LEVEL;
+	else if (!strcasecmp(level_name, "debug"))
+		*level = DEBUG_LEVEL;
+	else if (!strcasecmp(level_name, "trace"))
+		*level = TRACE_LEVEL;
+	else
+		return FALSE;
+	return TRUE;
+}
+
 /* Set the log level for this call. log level defaults to warning.
    parse the string value of level_name to the appropriate log_level_t enum value
 */
@@ -26,25 +44,13 @@ void set_conmon_logs(char *level_name, char *cid_, gboolean syslog_, char *tag)
 	else
 		log_cid = g_strdup_printf("%s: %s", cid_, tag);
 	use_syslog = syslog_;
-	// log_level is initialized as Warning, no need to set anything
-	if (level_name == NULL)
-		return;
-	if (!strcasecmp(level_name, "error") || !strcasecmp(level_name, "fatal") || !strcasecmp(level_name, "panic")) {
-		log_level = EXIT_LEVEL;
-		return;
-	} else if (!strcasecmp(level_name, "warn") || !strcasecmp(level_name, "warning")) {
+	/* A zygote child may still have the level of the zygote */
+	if (level_name == NULL) {
 		log_level = WARN_LEVEL;
 		return;
-	} else if (!strcasecmp(level_name, "info")) {
-		log_level = INFO_LEVEL;
-		return;
-	} else if (!strcasecmp(level_name, "debug")) {
-		log_level = DEBUG_LEVEL;
-		return;
-	} else if (!strcasecmp(level_name, "trace")) {
-		log_level = TRACE_LEVEL;
-		return;
 	}
+	if (parse_log_level(level_name, &log_level))
+		return;
 	ntracef("set log level to %s", level_name);
 	nexitf("No such log level %s", level_name);
 }
@@ -59,6 +65,7 @@ static void get_signal_descriptor_mask(sigset_t *set)
 	sigemptyset(set);
 	sigaddset(set, SIGCHLD);
 	sigaddset(set, SIGUSR1);
+	sigaddset(set, SIGUSR2);
 	sigprocmask(SIG_BLOCK, set, NULL);
 }
 
@@ -102,11 +109,12 @@ int get_signal_descriptor()
 	return signalfd(-1, &set, SFD_CLOEXEC);
 }
 
-void drop_signal_event(int fd)
+int drop_signal_event(int fd)
 {
 	struct signalfd_siginfo siginfo;
 	ssize_t s = read(fd, &siginfo, sizeof siginfo);
 	g_assert_cmpint(s, ==, sizeof siginfo);
+	return siginfo.ssi_signo;
 }
 
 #endif
@@ -146,13 +154,14 @@ int get_signal_descriptor()
 	return kq;
 }
 
-void drop_signal_event(int kq)
+int drop_signal_event(int kq)
 {
 	struct kevent kev;
 	int n = kevent(kq, NULL, 0, &kev, 1, NULL);
 	if (n != 1) {
 		pexit("failed to read signal event");
 	}
+	return kev.ident;
 }
 
 #endif
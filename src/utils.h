@@ -204,6 +204,9 @@ extern gboolean use_syslog;
 */
 void set_conmon_logs(char *level_name, char *cid_, gboolean syslog_, char *tag);
 
+/* Returns FALSE if level_name is not a known log level */
+gboolean parse_log_level(const char *level_name, log_level_t *level);
+
 #define _cleanup_(x) __attribute__((cleanup(x)))
 
 static inline void freep(void *p)
@@ -262,6 +265,7 @@ int set_subreaper(gboolean enabled);
 int set_pdeathsig(int sig);
 
 int get_signal_descriptor();
-void drop_signal_event(int fd);
+/* Returns the signal number */
+int drop_signal_event(int fd);
 
 #endif /* !defined(UTILS_H) */
@@ -0,0 +1,284 @@
+#define _GNU_SOURCE
+
+#include "zygote.h"
+#include "utils.h"
+#include "cli.h"
+#include "cmsg.h"
+#include "close_fds.h"
+#include "trace.h"
+
+#include <errno.h>
+#include <glib.h>
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/time.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+/*
+ * Zygote mode.
+ *
+ * conmon --zygote-socket PATH starts a server that has already paid for
+ * exec, dynamic linking, locale setup and the close_fds scan, and forks a
+ * ready child for every container start request it receives.  The child
+ * then runs exactly the code path a freshly exec'd conmon would run.
+ *
+ * A request is a single SOCK_SEQPACKET message made of NUL-terminated
+ * fields, each starting with a one-character type:
+ *
+ *   a<arg>         next command-line argument (argv[0] excluded)
+ *   e<NAME=VALUE>  environment variable; the child gets exactly these
+ *   c<dir>         working directory of the child
+ *   f<NAME>        an fd follows in its own message (see cmsg.c).  NAME is
+ *                  stdin, stdout or stderr for the standard streams, or the
+ *                  environment variable to set to the fd number, such as
+ *                  _OCI_SYNCPIPE or _OCI_STARTPIPE.
+ *
+ * The fds are sent in the order of their f fields.  The server replies with
+ * one message holding the pid of the forked child in decimal, or a negative
+ * errno.  The child is not a child of the client: as with a cold start, the
+ * client learns about the container through the sync pipe and the pidfiles.
+ */
+
+#define ZYGOTE_MAX_REQUEST (256 * 1024)
+#define ZYGOTE_MAX_FDS 16
+#define ZYGOTE_RECV_TIMEOUT_SECS 5
+
+struct zygote_request {
+	GPtrArray *args;
+	GPtrArray *env;
+	char *cwd;
+	char *fd_names[ZYGOTE_MAX_FDS];
+	int fds[ZYGOTE_MAX_FDS];
+	guint n_fds;
+};
+
+static void request_free(struct zygote_request *req)
+{
+	g_ptr_array_free(req->args, TRUE);
+	g_ptr_array_free(req->env, TRUE);
+	g_free(req->cwd);
+	for (guint i = 0; i < req->n_fds; i++) {
+		g_free(req->fd_names[i]);
+		if (req->fds[i] >= 0)
+			close(req->fds[i]);
+	}
+}
+
+static gboolean valid_fd_name(const char *name)
+{
+	if (!strcmp(name, "stdin") || !strcmp(name, "stdout") || !strcmp(name, "stderr"))
+		return TRUE;
+	if (*name == '\0')
+		return FALSE;
+	for (const char *p = name; *p; p++) {
+		if (!(*p == '_' || (*p >= 'A' && *p <= 'Z') || (p != name && *p >= '0' && *p <= '9')))
+			return FALSE;
+	}
+	return TRUE;
+}
+
+/* Returns 0 on success, or a negative errno to report to the client. */
+static int read_request(int conn, struct zygote_request *req)
+{
+	_cleanup_free_ char *buf = g_malloc(ZYGOTE_MAX_REQUEST);
+
+	ssize_t len = recv(conn, buf, ZYGOTE_MAX_REQUEST, MSG_TRUNC);
+	if (len < 0)
+		return -errno;
+	if (len == 0 || len > ZYGOTE_MAX_REQUEST || buf[len - 1] != '\0')
+		return -EINVAL;
+
+	for (char *field = buf; field < buf + len; field += strlen(field) + 1) {
+		char *value = field + 1;
+		switch (*field) {
+		case 'a':
+			g_ptr_array_add(req->args, g_strdup(value));
+			break;
+		case 'e':
+			if (strchr(value, '=') == NULL)
+				return -EINVAL;
+			g_ptr_array_add(req->env, g_strdup(value));
+			break;
+		case 'c':
+			g_free(req->cwd);
+			req->cwd = g_strdup(value);
+			break;
+		case 'f':
+			if (req->n_fds == ZYGOTE_MAX_FDS || !valid_fd_name(value))
+				return -EINVAL;
+			req->fd_names[req->n_fds] = g_strdup(value);
+			req->fds[req->n_fds] = -1;
+			req->n_fds++;
+			break;
+		default:
+			return -EINVAL;
+		}
+	}
+
+	for (guint i = 0; i < req->n_fds; i++) {
+		struct file_t file = recvfd(conn);
+		if (file.fd < 0)
+			return errno ? -errno : -EIO;
+		req->fds[i] = file.fd;
+		gboolean matches = !strcmp(file.name, req->fd_names[i]);
+		free(file.name);
+		if (!matches)
+			return -EINVAL;
+	}
+	return 0;
+}
+
+/* Runs in the forked child: turn the request into the process state a cold
+ * start would have had. */
+static void install_request(struct zygote_request *req, int *argc, char ***argv)
+{
+	static const char *const std_names[] = {"stdin", "stdout", "stderr"};
+
+	signal(SIGCHLD, SIG_DFL);
+
+	if (clearenv() != 0)
+		pexit("Failed to clear the environment");
+	for (guint i = 0; i < req->env->len; i++) {
+		if (putenv(g_ptr_array_index(req->env, i)) != 0)
+			pexit("Failed to set the environment");
+	}
+	/* putenv keeps the strings */
+	g_ptr_array_set_free_func(req->env, NULL);
+
+	if (req->cwd != NULL && chdir(req->cwd) < 0)
+		pexitf("Failed to change directory to %s", req->cwd);
+
+	for (guint i = 0; i < req->n_fds; i++) {
+		gboolean is_std = FALSE;
+		for (int std = 0; std < 3; std++) {
+			if (strcmp(req->fd_names[i], std_names[std]))
+				continue;
+			if (dup2(req->fds[i], std) < 0)
+				pexitf("Failed to install %s", std_names[std]);
+			is_std = TRUE;
+		}
+		if (is_std)
+			continue;
+
+		_cleanup_free_ char *value = g_strdup_printf("%d", req->fds[i]);
+		if (setenv(req->fd_names[i], value, 1) != 0)
+			pexitf("Failed to set %s", req->fd_names[i]);
+		/* owned by the container monitor from now on */
+		req->fds[i] = -1;
+	}
+
+	GPtrArray *new_argv = g_ptr_array_new();
+	g_ptr_array_add(new_argv, (*argv)[0]);
+	for (guint i = 0; i < req->args->len; i++)
+		g_ptr_array_add(new_argv, g_strdup(g_ptr_array_index(req->args, i)));
+	g_ptr_array_add(new_argv, NULL);
+
+	*argc = new_argv->len - 1;
+	*argv = (char **)g_ptr_array_free(new_argv, FALSE);
+
+	request_free(req);
+}
+
+static void reply(int conn, long value)
+{
+	char msg[32];
+	int len = snprintf(msg, sizeof(msg), "%ld", value);
+
+	if (send(conn, msg, len, MSG_NOSIGNAL) < 0)
+		pwarn("Failed to reply to zygote client");
+}
+
+static int bind_zygote_socket(const char *path)
+{
+	struct sockaddr_un addr = {0};
+
+	if (strlen(path) >= sizeof(addr.sun_path))
+		nexitf("Zygote socket path %s is too long", path);
+
+	int fd = socket(AF_UNIX, SOCK_SEQPACKET | SOCK_CLOEXEC, 0);
+	if (fd < 0)
+		pexit("Failed to create zygote socket");
+
+	addr.sun_family = AF_UNIX;
+	strcpy(addr.sun_path, path);
+
+	if (unlink(path) < 0 && errno != ENOENT)
+		pexitf("Failed to remove existing zygote socket %s", path);
+	if (bind(fd, (struct sockaddr *)&addr, sizeof(addr)) < 0)
+		pexitf("Failed to bind zygote socket %s", path);
+	if (chmod(path, 0600) < 0)
+		pexitf("Failed to change permissions of zygote socket %s", path);
+	if (listen(fd, SOMAXCONN) < 0)
+		pexitf("Failed to listen on zygote socket %s", path);
+
+	return fd;
+}
+
+void run_zygote(const char *path, int *argc, char ***argv)
+{
+	set_conmon_logs(opt_log_level, "zygote", opt_syslog, NULL);
+
+	/* Whatever the server inherited must not leak into the containers, and
+	 * fds received later may reuse the numbers recorded at startup. */
+	close_other_fds();
+	forget_other_fds();
+
+	/* Children are monitors of their own containers; nobody waits for them. */
+	signal(SIGCHLD, SIG_IGN);
+	signal(SIGPIPE, SIG_IGN);
+
+	int listen_fd = bind_zygote_socket(path);
+	ninfof("Zygote listening on %s", path);
+
+	for (;;) {
+		int conn = accept4(listen_fd, NULL, NULL, SOCK_CLOEXEC);
+		if (conn < 0) {
+			if (errno != EINTR && errno != ECONNABORTED)
+				pwarn("Failed to accept zygote connection");
+			continue;
+		}
+
+		struct timeval tv = {.tv_sec = ZYGOTE_RECV_TIMEOUT_SECS};
+		if (setsockopt(conn, SOL_SOCKET, SO_RCVTIMEO, &tv, sizeof(tv)) < 0)
+			pwarn("Failed to set zygote receive timeout");
+
+		struct zygote_request req = {
+			.args = g_ptr_array_new_with_free_func(g_free),
+			.env = g_ptr_array_new_with_free_func(g_free),
+		};
+
+		int ret = read_request(conn, &req);
+		if (ret < 0) {
+			nwarnf("Rejecting zygote request: %s", strerror(-ret));
+			reply(conn, ret);
+			goto next;
+		}
+
+		pid_t pid = fork();
+		if (pid < 0) {
+			pwarn("Failed to fork for zygote request");
+			reply(conn, -errno);
+			goto next;
+		}
+		if (pid == 0) {
+			/* The startup of this monitor begins here, not when the zygote started */
+			trace_start();
+			close(conn);
+			close(listen_fd);
+			install_request(&req, argc, argv);
+			opt_zygote_socket = NULL;
+			return;
+		}
+
+		ndebugf("Zygote forked %d", pid);
+		reply(conn, pid);
+	next:
+		request_free(&req);
+		close(conn);
+	}
+}
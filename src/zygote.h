@@ -0,0 +1,9 @@
+#if !defined(ZYGOTE_H)
+#define ZYGOTE_H
+
+/* Serve container start requests on the unix socket at path.  Only returns
+ * in a forked child, with *argc and *argv replaced by the request's argument
+ * vector, and the request's environment and fds installed. */
+void run_zygote(const char *path, int *argc, char ***argv);
+
+#endif // ZYGOTE_H
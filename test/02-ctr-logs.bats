@@ -161,6 +161,23 @@ run_conmon_with_log_opts() {
     assert "${output}" =~ "######"
 }
 
+@test "ctr logs: journald multiline entries" {
+    setup_container_env "echo 'Exception in main'; echo '  at a'; echo '  at b'; echo done"
+    run_conmon_with_default_args \
+        --log-path "journald:" \
+        --log-multiline-continue '^\s'
+
+    run journalctl --user CONTAINER_ID_FULL="$CTR_ID" -o json
+    assert "$(echo "$output" | grep -c '"MESSAGE"')" == 2
+    assert "${output}" =~ "Exception in main\\n  at a\\n  at b"
+}
+
+@test "ctr logs: invalid multiline pattern should fail" {
+    run_conmon_with_log_opts --log-path "journald:" --log-multiline-start '('
+    assert_failure
+    assert_output_contains "Invalid --log-multiline-start pattern"
+}
+
 @test "ctr logs: k8s partial message" {
     # Print a message longer than the conmon buffer.
     # It should split it into multiple partial messages.
@@ -173,3 +190,21 @@ run_conmon_with_log_opts() {
     assert "${output}" =~ "stdout P"
     assert "${output}" =~ "stdout F"
 }
+
+@test "ctr logs: k8s write-behind keeps the whole log" {
+    setup_container_env "/busybox seq 1 20000"
+    run_conmon_with_default_args \
+        --log-path "k8s-file:$LOG_PATH" \
+        --log-writeback-bytes 4096 \
+        --log-writeback-interval 1
+
+    assert_file_exists "$LOG_PATH"
+    run grep -c " F [0-9]*$" "$LOG_PATH"
+    assert "$output" == 20000
+}
+
+@test "ctr logs: negative writeback bytes should fail" {
+    run_conmon_with_log_opts --log-path "k8s-file:$LOG_PATH" --log-writeback-bytes -1
+    assert_failure
+    assert_output_contains "Log writeback settings must be greater than or equal to 0"
+}
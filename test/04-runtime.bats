@@ -122,3 +122,15 @@ teardown() {
     assert "${output}" =~ "\"message\":"
     assert "${output}" =~ "runc create failed"
 }
+
+@test "runtime: --startup-trace records the startup phases" {
+    run_conmon_with_default_args --log-path "k8s-file:$LOG_PATH" --startup-trace
+
+    assert_file_exists "$BUNDLE_PATH/conmon-startup.trace"
+    run cat "$BUNDLE_PATH/conmon-startup.trace"
+    assert "${lines[0]}" =~ "^[0-9]+ cli parsed$"
+    assert "$output" =~ "[0-9]+ runtime forked"
+    assert "$output" =~ "[0-9]+ endpoints ready"
+    assert "$output" =~ "[0-9]+ runtime exited"
+    assert "$output" =~ "[0-9]+ pid reported"
+}
@@ -195,4 +195,27 @@ EOF
         # We're not on cgroup v2, tests should be skipped
         skip "Not on cgroup v2 system"
     fi
-}
\ No newline at end of file
+}
+
+@test "OOM detection: pressure stall outside the PSI window is rejected" {
+    run_conmon --cid "$CTR_ID" --cuuid "$CTR_ID" --runtime /bin/true --pressure-stall 5000
+    assert_failure
+    assert_output_contains "Pressure stall must be between 0 and 2000 milliseconds"
+}
+
+@test "OOM detection: pressure stall trigger fires on CPU contention" {
+    check_runtime_binary
+    if ! cat /proc/pressure/cpu >/dev/null 2>&1; then
+        skip "PSI is not available on this kernel"
+    fi
+
+    # Keep more busy loops runnable than there are CPUs, so that the
+    # container's tasks wait for a CPU most of the time.
+    local spinners=$(($(nproc) * 2))
+    setup_container_env "i=0; while [ \$i -lt $spinners ]; do /busybox sh -c 'while :; do :; done' & i=\$((i + 1)); done; /busybox sleep 3"
+
+    run_conmon_with_default_args --pressure-stall 100
+    [ -f "$BUNDLE_PATH/pressure-cpu" ]
+    run cat "$BUNDLE_PATH/pressure-cpu"
+    assert_output_contains "some avg10="
+}
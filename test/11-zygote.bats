@@ -0,0 +1,125 @@
+#!/usr/bin/env bats
+
+load test_helper
+
+ZYGOTE_CLIENT="$BATS_TEST_DIRNAME/../hack/zygote-client.py"
+
+setup() {
+    check_conmon_binary
+    check_runtime_binary
+    if ! command -v python3 >/dev/null 2>&1; then
+        skip "python3 is required for the zygote client"
+    fi
+    setup_container_env "/busybox echo hello from zygote"
+    export ZYGOTE_SOCKET="$TEST_TMPDIR/zygote.sock"
+    start_zygote
+}
+
+# Start a zygote with the given extra options
+start_zygote() {
+    rm -f "$ZYGOTE_SOCKET"
+    "$CONMON_BINARY" --zygote-socket "$ZYGOTE_SOCKET" --log-level debug "$@" &
+    ZYGOTE_PID=$!
+    for _ in $(seq 1 50); do
+        [ -S "$ZYGOTE_SOCKET" ] && break
+        sleep 0.1
+    done
+}
+
+teardown() {
+    kill "$ZYGOTE_PID" 2>/dev/null || true
+    wait "$ZYGOTE_PID" 2>/dev/null || true
+    cleanup_test_env
+}
+
+@test "zygote: container started through the zygote logs and reports its pid" {
+    start_oci_sync_pipe_reader
+    run python3 "$ZYGOTE_CLIENT" "$ZYGOTE_SOCKET" -- \
+        --cid "$CTR_ID" \
+        --cuuid "$CTR_ID" \
+        --runtime "$RUNTIME_BINARY" \
+        --bundle "$BUNDLE_PATH" \
+        --socket-dir-path "$SOCKET_PATH" \
+        --log-level trace \
+        --container-pidfile "$PID_FILE" \
+        --conmon-pidfile "$CONMON_PID_FILE" \
+        --log-path "k8s-file:$LOG_PATH" 6>"$OCI_SYNCPIPE_PATH"
+    assert_success
+    assert "$output" =~ "^[0-9]+$"
+
+    wait_for_runtime_status "$CTR_ID" created
+    [ -f "$CONMON_PID_FILE" ]
+    run_runtime start "$CTR_ID"
+    wait_for_runtime_status "$CTR_ID" stopped
+
+    run cat "$TEST_TMPDIR/syncpipe-output"
+    assert "$output" =~ "\"pid\": [0-9]+"
+
+    run cat "$LOG_PATH"
+    assert "$output" =~ "hello from zygote"
+
+    # The zygote keeps serving after handing out a container.
+    kill -0 "$ZYGOTE_PID"
+}
+
+@test "zygote: the startup trace starts when the monitor is forked" {
+    # Let the zygote idle for longer than the whole startup takes
+    sleep 2
+    start_oci_sync_pipe_reader
+    run python3 "$ZYGOTE_CLIENT" "$ZYGOTE_SOCKET" -- \
+        --cid "$CTR_ID" \
+        --cuuid "$CTR_ID" \
+        --runtime "$RUNTIME_BINARY" \
+        --bundle "$BUNDLE_PATH" \
+        --socket-dir-path "$SOCKET_PATH" \
+        --container-pidfile "$PID_FILE" \
+        --conmon-pidfile "$CONMON_PID_FILE" \
+        --log-path "k8s-file:$LOG_PATH" \
+        --startup-trace 6>"$OCI_SYNCPIPE_PATH"
+    assert_success
+    wait_for_runtime_status "$CTR_ID" created
+    run_runtime start "$CTR_ID"
+    wait_for_runtime_status "$CTR_ID" stopped
+
+    assert_file_exists "$BUNDLE_PATH/conmon-startup.trace"
+    run awk '$2 == "cli" { print $1 }' "$BUNDLE_PATH/conmon-startup.trace"
+    assert "$output" -lt 1000000
+}
+
+@test "zygote: options of the zygote do not carry over to its containers" {
+    kill "$ZYGOTE_PID"
+    wait "$ZYGOTE_PID" || true
+    start_zygote --startup-trace --log-drop-pattern hello
+
+    start_oci_sync_pipe_reader
+    run python3 "$ZYGOTE_CLIENT" "$ZYGOTE_SOCKET" -- \
+        --cid "$CTR_ID" \
+        --cuuid "$CTR_ID" \
+        --runtime "$RUNTIME_BINARY" \
+        --bundle "$BUNDLE_PATH" \
+        --socket-dir-path "$SOCKET_PATH" \
+        --container-pidfile "$PID_FILE" \
+        --conmon-pidfile "$CONMON_PID_FILE" \
+        --log-path "k8s-file:$LOG_PATH" 6>"$OCI_SYNCPIPE_PATH"
+    assert_success
+    wait_for_runtime_status "$CTR_ID" created
+    run_runtime start "$CTR_ID"
+    wait_for_conmon_exit
+
+    run cat "$LOG_PATH"
+    assert "$output" =~ "hello from zygote"
+    [ ! -f "$BUNDLE_PATH/conmon-startup.trace" ]
+}
+
+@test "zygote: malformed request is rejected" {
+    run python3 - "$ZYGOTE_SOCKET" <<'EOF'
+import socket, sys
+s = socket.socket(socket.AF_UNIX, socket.SOCK_SEQPACKET)
+s.connect(sys.argv[1])
+s.send(b"xbogus\0")
+print(s.recv(32).decode())
+EOF
+    assert_success
+    assert "$output" == "-22"
+    kill -0 "$ZYGOTE_PID"
+}
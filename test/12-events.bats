@@ -0,0 +1,60 @@
+#!/usr/bin/env bats
+
+load test_helper
+
+setup() {
+    check_conmon_binary
+    check_runtime_binary
+    if ! command -v python3 >/dev/null 2>&1; then
+        skip "python3 is required to listen on the event socket"
+    fi
+    setup_container_env "/busybox true"
+    export EVENT_SOCKET="$TEST_TMPDIR/events.sock"
+    export EVENT_LOG="$TEST_TMPDIR/events.log"
+
+    python3 - "$EVENT_SOCKET" "$EVENT_LOG" <<'EOF' &
+import json, socket, sys
+s = socket.socket(socket.AF_UNIX, socket.SOCK_DGRAM)
+s.bind(sys.argv[1])
+s.settimeout(20)
+with open(sys.argv[2], "w") as out:
+    while True:
+        msg = s.recv(4096).decode()
+        out.write(msg + "\n")
+        out.flush()
+        if json.loads(msg)["event"] == "exit":
+            break
+EOF
+    LISTENER_PID=$!
+    for _ in $(seq 1 50); do
+        [ -S "$EVENT_SOCKET" ] && break
+        sleep 0.1
+    done
+}
+
+teardown() {
+    kill "$LISTENER_PID" 2>/dev/null || true
+    cleanup_test_env
+}
+
+@test "event socket: start and exit are pushed" {
+    run_conmon_with_default_args --event-socket "$EVENT_SOCKET" --exit-dir "$TEST_TMPDIR"
+    wait "$LISTENER_PID"
+
+    run cat "$EVENT_LOG"
+    assert "$output" =~ "\"event\":\"start\",\"cid\":\"$CTR_ID\""
+    assert "$output" =~ "\"event\":\"exit\",\"cid\":\"$CTR_ID\""
+    assert "$output" =~ "\"exit_status\":0,\"timed_out\":false"
+
+    # The exit file is still written for existing consumers.
+    [ -f "$TEST_TMPDIR/$CTR_ID" ]
+}
+
+@test "event socket: missing listener does not affect the container" {
+    kill "$LISTENER_PID"
+    wait "$LISTENER_PID" 2>/dev/null || true
+    rm -f "$EVENT_SOCKET"
+
+    run_conmon_with_default_args --event-socket "$EVENT_SOCKET" --exit-dir "$TEST_TMPDIR"
+    [ -f "$TEST_TMPDIR/$CTR_ID" ]
+}
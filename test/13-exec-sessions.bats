@@ -0,0 +1,53 @@
+#!/usr/bin/env bats
+
+load test_helper
+
+EXEC_CLIENT="$BATS_TEST_DIRNAME/../hack/exec-client.py"
+
+setup() {
+    check_conmon_binary
+    check_runtime_binary
+    if ! command -v python3 >/dev/null 2>&1; then
+        skip "python3 is required for the exec client"
+    fi
+    setup_container_env "while [ ! -f /tmp/done ]; do /busybox sleep 0.1; done"
+}
+
+teardown() {
+    cleanup_test_env
+}
+
+@test "exec sessions: output and exit code are relayed by the container's conmon" {
+    generate_process_spec "echo 'Hello from exec session!' && echo oops >&2 && exit 3"
+    start_conmon_with_default_args --log-path "k8s-file:$LOG_PATH" --exec-sessions
+    wait_for_runtime_status "$CTR_ID" running
+
+    run python3 "$EXEC_CLIENT" "$BUNDLE_PATH/exec" "$BUNDLE_PATH/process.json"
+    assert "$status" -eq 3
+    assert "$output" =~ "Hello from exec session!"
+    assert "$output" =~ "oops"
+
+    # A second session on the same conmon, forwarding stdin.
+    generate_process_spec "/busybox cat > /tmp/done"
+    run python3 "$EXEC_CLIENT" -i "$BUNDLE_PATH/exec" "$BUNDLE_PATH/process.json" <<< "bye"
+    assert_success
+    wait_for_runtime_status "$CTR_ID" stopped
+}
+
+@test "exec sessions: runtime errors are reported" {
+    generate_process_spec
+    start_conmon_with_default_args --log-path "k8s-file:$LOG_PATH" --exec-sessions
+    wait_for_runtime_status "$CTR_ID" running
+
+    run python3 "$EXEC_CLIENT" "$BUNDLE_PATH/exec" "$BUNDLE_PATH/does-not-exist.json"
+    assert "$status" -eq 125
+    assert "$output" =~ "exec failed"
+}
+
+@test "exec sessions: cannot be combined with --exec" {
+    generate_process_spec
+    run_conmon --cid "$CTR_ID" --cuuid "$CTR_ID" --runtime "$RUNTIME_BINARY" \
+        --exec --exec-process-spec "$BUNDLE_PATH/process.json" --exec-sessions
+    assert_failure
+    assert_output_contains "--exec-sessions cannot be used with --exec"
+}
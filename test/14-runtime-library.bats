@@ -0,0 +1,73 @@
+#!/usr/bin/env bats
+
+load test_helper
+
+setup() {
+    check_conmon_binary
+    check_runtime_binary
+    if ! command -v cc >/dev/null 2>&1; then
+        skip "a C compiler is required to build the test runtime library"
+    fi
+    setup_container_env "/busybox echo hello from runtime library"
+
+    # A runtime library that hands the arguments to the runtime binary and
+    # leaves a trace, to prove conmon went through it, with the fds it got.
+    export LIBRARY_MARKER="$TEST_TMPDIR/library-called"
+    cat > "$TEST_TMPDIR/runtime-library.c" <<'EOF'
+#include <dirent.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+int conmon_runtime_version(void)
+{
+	return 1;
+}
+
+int conmon_runtime_main(int argc, char **argv)
+{
+	(void)argc;
+	FILE *marker = fopen(getenv("LIBRARY_MARKER"), "w");
+	DIR *d = opendir("/proc/self/fd");
+	struct dirent *ent;
+	while ((ent = readdir(d)) != NULL) {
+		if (ent->d_name[0] != '.' && atoi(ent->d_name) != dirfd(d) && atoi(ent->d_name) != fileno(marker))
+			fprintf(marker, "%s\n", ent->d_name);
+	}
+	closedir(d);
+	fclose(marker);
+	execv(argv[0], argv);
+	return 127;
+}
+EOF
+    cc -shared -fPIC -o "$TEST_TMPDIR/runtime-library.so" "$TEST_TMPDIR/runtime-library.c"
+}
+
+teardown() {
+    cleanup_test_env
+}
+
+@test "runtime library: container is created through the library" {
+    run_conmon_with_default_args --log-path "k8s-file:$LOG_PATH" --runtime-library "$TEST_TMPDIR/runtime-library.so"
+    [ -f "$LIBRARY_MARKER" ]
+
+    run cat "$LOG_PATH"
+    assert "$output" =~ "hello from runtime library"
+}
+
+@test "runtime library: only stdio is left open for the library" {
+    run_conmon_with_default_args --log-path "k8s-file:$LOG_PATH" --runtime-library "$TEST_TMPDIR/runtime-library.so"
+
+    run sort -n "$LIBRARY_MARKER"
+    assert "$output" == "$(printf '0\n1\n2')"
+}
+
+@test "runtime library: missing entry point is rejected" {
+    echo 'int unrelated(void) { return 0; }' > "$TEST_TMPDIR/empty.c"
+    cc -shared -fPIC -o "$TEST_TMPDIR/empty.so" "$TEST_TMPDIR/empty.c"
+
+    run_conmon --cid "$CTR_ID" --cuuid "$CTR_ID" --runtime "$RUNTIME_BINARY" --bundle "$BUNDLE_PATH" \
+        --runtime-library "$TEST_TMPDIR/empty.so"
+    assert_failure
+    assert_output_contains "doesn't export \`conmon_runtime_version\`"
+}
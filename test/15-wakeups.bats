@@ -0,0 +1,66 @@
+#!/usr/bin/env bats
+
+load test_helper
+
+# How long conmon is watched while the container does nothing.
+IDLE_SECONDS="${IDLE_WAKEUP_SECONDS:-60}"
+
+setup() {
+    check_conmon_binary
+    check_runtime_binary
+}
+
+teardown() {
+    cleanup_test_env
+}
+
+# Every time conmon is woken up it is switched in, so the context switch
+# counters of an idle conmon must not move.
+context_switches() {
+    awk '/^(non)?voluntary_ctxt_switches:/ { n += $2 } END { print n }' "/proc/$1/status"
+}
+
+count_idle_wakeups() {
+    local pid
+    pid=$(cat "$CONMON_PID_FILE")
+    # Let the startup settle
+    sleep 1
+    local before
+    before=$(context_switches "$pid")
+    sleep "$IDLE_SECONDS"
+    echo $(( $(context_switches "$pid") - before ))
+}
+
+@test "wakeups: idle conmon is not woken up" {
+    setup_container_env "/busybox sleep 600"
+    start_conmon_with_default_args --log-path "k8s-file:$LOG_PATH" --no-idle-wakeups --timer-slack 50
+    wait_for_runtime_status "$CTR_ID" running
+
+    run count_idle_wakeups
+    assert "$output" -eq 0
+}
+
+@test "wakeups: idle conmon with a terminal is not woken up" {
+    setup_container_env "/busybox sleep 600" true
+    start_conmon_with_default_args --log-path "k8s-file:$LOG_PATH" --terminal --no-idle-wakeups
+    wait_for_runtime_status "$CTR_ID" running
+
+    run count_idle_wakeups
+    assert "$output" -eq 0
+}
+
+@test "wakeups: healthchecks cannot be combined with --no-idle-wakeups" {
+    setup_container_env
+    run_conmon --cid "$CTR_ID" --cuuid "$CTR_ID" --runtime "$RUNTIME_BINARY" --bundle "$BUNDLE_PATH" \
+        --healthcheck-cmd /busybox --no-idle-wakeups
+    assert_failure
+    assert_output_contains "--healthcheck-cmd cannot be used with --no-idle-wakeups"
+}
+
+@test "wakeups: stats sampling cannot be combined with --no-idle-wakeups" {
+    setup_container_env
+    run_conmon --cid "$CTR_ID" --cuuid "$CTR_ID" --runtime "$RUNTIME_BINARY" --bundle "$BUNDLE_PATH" \
+        --stats-interval 1 --no-idle-wakeups
+    assert_failure
+    assert_output_contains "--stats-interval cannot be used with --no-idle-wakeups"
+}
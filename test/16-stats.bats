@@ -0,0 +1,49 @@
+#!/usr/bin/env bats
+
+load test_helper
+
+STATS_READER="$BATS_TEST_DIRNAME/../hack/conmon-stats.py"
+
+setup() {
+    check_conmon_binary
+    check_runtime_binary
+    if ! [[ -f /sys/fs/cgroup/cgroup.controllers ]]; then
+        skip "cgroup v2 is required for the resource sampler"
+    fi
+    if ! command -v python3 >/dev/null 2>&1; then
+        skip "python3 is required for the stats reader"
+    fi
+    setup_container_env "/busybox sleep 3"
+}
+
+teardown() {
+    cleanup_test_env
+}
+
+@test "stats: samples are published and summarized at exit" {
+    start_conmon_with_default_args --log-path "k8s-file:$LOG_PATH" --stats-interval 1
+    wait_for_runtime_status "$CTR_ID" running
+    sleep 2
+
+    run python3 "$STATS_READER" --history "$BUNDLE_PATH"
+    assert_success
+    assert "$output" =~ "\"pids_current\": [1-9]"
+    assert "$output" =~ "\"samples\": [2-9]"
+
+    wait_for_runtime_status "$CTR_ID" stopped
+    # conmon writes the summary after the container exited
+    for _ in $(seq 1 50); do
+        [ -f "$BUNDLE_PATH/stats-summary" ] && break
+        sleep 0.1
+    done
+    run cat "$BUNDLE_PATH/stats-summary"
+    assert_success
+    assert_output_contains "pids_peak 1"
+    assert_output_contains "cpu_usage_usec"
+}
+
+@test "stats: negative interval is rejected" {
+    run_conmon --cid "$CTR_ID" --cuuid "$CTR_ID" --runtime "$RUNTIME_BINARY" --bundle "$BUNDLE_PATH" --stats-interval -1
+    assert_failure
+    assert_output_contains "Stats interval must be greater than or equal to 0"
+}
@@ -0,0 +1,75 @@
+#!/usr/bin/env bats
+
+load test_helper
+
+CONTROL_CLIENT="$BATS_TEST_DIRNAME/../hack/conmon-control.py"
+
+setup() {
+    check_conmon_binary
+    check_runtime_binary
+    if ! command -v python3 >/dev/null 2>&1; then
+        skip "python3 is required for the control client"
+    fi
+    setup_container_env "while [ ! -f /tmp/done ]; do echo tick; /busybox sleep 0.1; done"
+}
+
+teardown() {
+    cleanup_test_env
+}
+
+@test "control socket: settings can be read and changed" {
+    start_conmon_with_default_args --log-path "k8s-file:$LOG_PATH" --control-socket
+    wait_for_runtime_status "$CTR_ID" running
+
+    run python3 "$CONTROL_CLIENT" "$BUNDLE_PATH/control" get
+    assert_success
+    assert_output_contains "log-level"
+    assert_output_contains "stdout-bytes-read"
+
+    run python3 "$CONTROL_CLIENT" "$BUNDLE_PATH/control" set log-size-max 4096
+    assert_success
+    run python3 "$CONTROL_CLIENT" "$BUNDLE_PATH/control" get
+    assert_output_contains "log-size-max 4096"
+
+    run python3 "$CONTROL_CLIENT" "$BUNDLE_PATH/control" set log-level nonsense
+    assert_failure
+    assert_output_contains "error: unknown log level"
+
+    run python3 "$CONTROL_CLIENT" "$BUNDLE_PATH/control" frobnicate
+    assert_failure
+    assert_output_contains "error: unknown command"
+}
+
+@test "control socket: paused output is counted as dropped" {
+    start_conmon_with_default_args --log-path "k8s-file:$LOG_PATH" --control-socket
+    wait_for_runtime_status "$CTR_ID" running
+
+    run python3 "$CONTROL_CLIENT" "$BUNDLE_PATH/control" pause
+    assert_success
+    sleep 0.5
+    run python3 "$CONTROL_CLIENT" "$BUNDLE_PATH/control" get
+    assert_output_contains "paused 1"
+    assert "$output" =~ "stdout-bytes-dropped [1-9]"
+
+    run python3 "$CONTROL_CLIENT" "$BUNDLE_PATH/control" resume
+    assert_success
+    run python3 "$CONTROL_CLIENT" "$BUNDLE_PATH/control" flush
+    assert_success
+}
+
+@test "control socket: a line started before a pause is finished at exit" {
+    setup_container_env "printf started; while [ ! -f /tmp/done ]; do /busybox sleep 0.1; done"
+    start_conmon_with_default_args --log-path "k8s-file:$LOG_PATH" --control-socket
+    wait_for_runtime_status "$CTR_ID" running
+    sleep 0.5
+
+    run python3 "$CONTROL_CLIENT" "$BUNDLE_PATH/control" pause
+    assert_success
+    touch "$ROOTFS/tmp/done"
+    wait_for_conmon_exit
+
+    run cat "$LOG_PATH"
+    assert "$output" =~ "stdout P started"
+    run tail -n 1 "$LOG_PATH"
+    assert "$output" =~ " stdout F$"
+}
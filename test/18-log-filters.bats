@@ -0,0 +1,89 @@
+#!/usr/bin/env bats
+
+load test_helper
+
+setup() {
+    check_conmon_binary
+    check_runtime_binary
+}
+
+teardown() {
+    cleanup_test_env
+}
+
+# Start a container running $1 with the extra conmon arguments and wait for
+# conmon to have drained its output.
+run_logging_container() {
+    local cmd="$1"
+    shift
+    setup_container_env "$cmd"
+    start_conmon_with_default_args --log-path "k8s-file:$LOG_PATH" "$@"
+    wait_for_conmon_exit
+}
+
+@test "log filters: lines over the rate limit are suppressed and counted" {
+    run_logging_container "/busybox seq 1 1000" --log-rate-lines 10
+    run grep -c " F [0-9]*$" "$LOG_PATH"
+    assert "$output" -le 20
+    run cat "$LOG_PATH"
+    assert_output_contains "lines ("
+    assert_output_contains "suppressed by the log rate limit"
+}
+
+@test "log filters: a line longer than the byte bucket is still logged" {
+    run_logging_container "printf '%*s' 1000 | /busybox tr ' ' '#'; /busybox echo; /busybox echo after" --log-rate-bytes 100
+    run grep -c "stdout F #\{1000\}$" "$LOG_PATH"
+    assert "$output" == 1
+    run cat "$LOG_PATH"
+    assert_output_contains "1 lines (6 bytes) suppressed by the log rate limit"
+}
+
+@test "log filters: rate limit sampling keeps one in N lines" {
+    run_logging_container "/busybox seq 1 1000" --log-rate-lines 1 --log-rate-sample 100
+    run grep -c " F [0-9]*$" "$LOG_PATH"
+    assert "$output" -ge 10
+    assert "$output" -le 20
+}
+
+@test "log filters: repeated lines are collapsed" {
+    run_logging_container "for i in \$(/busybox seq 1 500); do echo same; done; echo other" --log-dedup 5
+    run grep -c " F same$" "$LOG_PATH"
+    assert "$output" == "1"
+    run cat "$LOG_PATH"
+    assert_output_contains "last message repeated 499 times"
+    assert_output_contains " F other"
+}
+
+@test "log filters: a line dropped by the rate limit is not counted as repeated" {
+    run_logging_container "echo first; echo second; echo second; /busybox sleep 1.5; echo second" \
+        --log-dedup 5 --log-rate-lines 1
+    run grep -c " F second$" "$LOG_PATH"
+    assert "$output" == "1"
+    run cat "$LOG_PATH"
+    assert "$output" !~ "last message repeated"
+}
+
+@test "log filters: lines matching a drop pattern are not logged" {
+    run_logging_container "echo 'GET /healthz 200'; echo keep me; echo 'DEBUG chatter'; echo 'probe 42 ok'" \
+        --log-drop-pattern /healthz --log-drop-pattern DEBUG --log-drop-pattern 're:^probe [0-9]+'
+    run cat "$LOG_PATH"
+    assert_output_contains " F keep me"
+    assert "$output" !~ "healthz"
+    assert "$output" !~ "chatter"
+    assert "$output" !~ "probe"
+}
+
+@test "log filters: invalid drop patterns are rejected" {
+    setup_container_env
+    run_conmon --cid "$CTR_ID" --cuuid "$CTR_ID" --runtime "$RUNTIME_BINARY" --bundle "$BUNDLE_PATH" \
+        --log-path "k8s-file:$LOG_PATH" --log-drop-pattern 're:('
+    assert_failure
+    assert_output_contains "Invalid --log-drop-pattern"
+}
+
+@test "log filters: negative rate limits are rejected" {
+    setup_container_env
+    run_conmon --cid "$CTR_ID" --cuuid "$CTR_ID" --runtime "$RUNTIME_BINARY" --bundle "$BUNDLE_PATH" --log-rate-bytes -1
+    assert_failure
+    assert_output_contains "Log rate limits must be greater than or equal to 0"
+}
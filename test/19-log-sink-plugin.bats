@@ -0,0 +1,56 @@
+#!/usr/bin/env bats
+
+load test_helper
+
+SINK_SOURCE="$BATS_TEST_DIRNAME/../hack/log-sink-example.c"
+
+setup() {
+    check_conmon_binary
+    check_runtime_binary
+    if ! command -v cc >/dev/null 2>&1; then
+        skip "a C compiler is required to build the example log sink"
+    fi
+}
+
+teardown() {
+    cleanup_test_env
+}
+
+# Set up a container running $1 and build the example sink next to it
+setup_sink_container() {
+    setup_container_env "$1"
+    cc -shared -fPIC -I"$BATS_TEST_DIRNAME/../src" -o "$TEST_TMPDIR/log-sink.so" "$SINK_SOURCE"
+    SINK_OUTPUT="$TEST_TMPDIR/sink.log"
+}
+
+@test "log sink plugin: records reach the sink next to k8s-file" {
+    setup_sink_container "echo hello from the container; echo oops >&2"
+    start_conmon_with_default_args --log-path "k8s-file:$LOG_PATH" --log-path "plugin:$TEST_TMPDIR/log-sink.so:$SINK_OUTPUT"
+    # The sink is flushed when conmon exits
+    wait_for_conmon_exit
+
+    run cat "$SINK_OUTPUT"
+    assert "$output" =~ "[0-9]+ stdout F hello from the container"
+    assert "$output" =~ "[0-9]+ stderr F oops"
+
+    run cat "$LOG_PATH"
+    assert_output_contains "hello from the container"
+}
+
+@test "log sink plugin: a line split over two reads is two records" {
+    setup_sink_container "printf 'first half'; /busybox sleep 0.5; echo ' second half'"
+    start_conmon_with_default_args --log-path "k8s-file:$LOG_PATH" --log-path "plugin:$TEST_TMPDIR/log-sink.so:$SINK_OUTPUT"
+    wait_for_conmon_exit
+
+    run cat "$SINK_OUTPUT"
+    assert "$output" =~ "[0-9]+ stdout P first half"
+    assert "$output" =~ "[0-9]+ stdout F  second half"
+    run grep -c " stdout [FP] " "$SINK_OUTPUT"
+    assert "$output" == 2
+}
+
+@test "log sink plugin: a missing shared object fails" {
+    setup_sink_container
+    start_conmon_with_default_args --log-path "plugin:$TEST_TMPDIR/does-not-exist.so"
+    assert_output_contains "cannot load"
+}
@@ -0,0 +1,112 @@
+#!/usr/bin/env bats
+
+load test_helper
+
+RING_READER="$BATS_TEST_DIRNAME/../hack/conmon-log-ring.py"
+CONTROL_CLIENT="$BATS_TEST_DIRNAME/../hack/conmon-control.py"
+
+setup() {
+    check_conmon_binary
+    check_runtime_binary
+    if ! command -v python3 >/dev/null 2>&1; then
+        skip "python3 is required to read the log ring"
+    fi
+}
+
+teardown() {
+    if [[ -n "${READER_PID:-}" ]]; then
+        kill -CONT "$READER_PID" 2>/dev/null || true
+        kill "$READER_PID" 2>/dev/null || true
+    fi
+    cleanup_test_env
+}
+
+# The ring is removed when conmon exits, so it is followed from the start.
+start_ring_reader() {
+    python3 "$RING_READER" --follow "$BUNDLE_PATH" > "$TEST_TMPDIR/ring.out" 2> "$TEST_TMPDIR/ring.err" &
+    READER_PID=$!
+    sleep 0.5
+}
+
+@test "log ring: lines are published next to k8s-file" {
+    setup_container_env "while [ ! -f /tmp/go ]; do /busybox sleep 0.1; done; echo hello from the container; echo oops >&2"
+    start_conmon_with_default_args --log-path "k8s-file:$LOG_PATH" --log-path ring:65536
+    wait_for_runtime_status "$CTR_ID" running
+
+    start_ring_reader
+    touch "$ROOTFS/tmp/go"
+    wait_for_conmon_exit
+    wait "$READER_PID"
+
+    run cat "$TEST_TMPDIR/ring.out"
+    assert "$output" =~ "[0-9]+ stdout F hello from the container"
+    assert "$output" =~ "[0-9]+ stderr F oops"
+
+    run cat "$LOG_PATH"
+    assert_output_contains "hello from the container"
+}
+
+@test "log ring: a lapped reader is told how many records it lost" {
+    setup_container_env "echo start; while [ ! -f /tmp/go ]; do /busybox sleep 0.1; done; /busybox seq 1 50000"
+    start_conmon_with_default_args --log-path "k8s-file:$LOG_PATH" --log-path ring:65536
+    wait_for_runtime_status "$CTR_ID" running
+
+    start_ring_reader
+    touch "$ROOTFS/tmp/go"
+    wait_for_conmon_exit
+    wait "$READER_PID"
+
+    # 50000 records do not fit in 64 KiB; the writer never waits for the reader
+    run cat "$TEST_TMPDIR/ring.err"
+    assert "$output" =~ "lost [0-9]+ records"
+    run tail -n 1 "$TEST_TMPDIR/ring.out"
+    assert "$output" =~ "[0-9]+ stdout F 50000"
+}
+
+@test "log ring: the lag of a stalled reader is reported" {
+    setup_container_env "echo start; while [ ! -f /tmp/go ]; do /busybox sleep 0.1; done; /busybox seq 1 1000; while [ ! -f /tmp/done ]; do /busybox sleep 0.1; done"
+    start_conmon_with_default_args --log-path "k8s-file:$LOG_PATH" --log-path ring:65536 --control-socket
+    wait_for_runtime_status "$CTR_ID" running
+
+    start_ring_reader
+    kill -STOP "$READER_PID"
+    touch "$ROOTFS/tmp/go"
+    sleep 0.5
+
+    run python3 "$CONTROL_CLIENT" "$BUNDLE_PATH/control" get
+    assert_success
+    assert "$output" =~ "ring-reader-$READER_PID-lag [1-9]"
+
+    kill -CONT "$READER_PID"
+    touch "$ROOTFS/tmp/done"
+    wait_for_conmon_exit
+    wait "$READER_PID"
+    run tail -n 1 "$TEST_TMPDIR/ring.out"
+    assert "$output" =~ "[0-9]+ stdout F 1000"
+}
+
+@test "log ring: the ring is removed when conmon exits" {
+    setup_container_env "while [ ! -f /tmp/go ]; do /busybox sleep 0.1; done"
+    start_conmon_with_default_args --log-path "k8s-file:$LOG_PATH" --log-path ring:65536
+    wait_for_runtime_status "$CTR_ID" running
+    local ring
+    ring=$(readlink "$BUNDLE_PATH/log-ring")
+    [ -f "$ring" ]
+
+    touch "$ROOTFS/tmp/go"
+    wait_for_conmon_exit
+    [ ! -e "$ring" ]
+    [ ! -L "$BUNDLE_PATH/log-ring" ]
+}
+
+@test "log ring: an invalid size fails" {
+    setup_container_env
+    start_conmon_with_default_args --log-path ring:lots
+    assert_output_contains "Invalid ring size"
+}
+
+@test "log ring: a size above 1 GiB fails" {
+    setup_container_env
+    start_conmon_with_default_args --log-path ring:18446744073709551615
+    assert_output_contains "Invalid ring size"
+}
@@ -0,0 +1,101 @@
+#!/usr/bin/env bats
+
+load test_helper
+
+setup() {
+    check_conmon_binary
+    check_runtime_binary
+    if ! command -v python3 >/dev/null 2>&1; then
+        skip "python3 is required to run a collector"
+    fi
+}
+
+teardown() {
+    if [[ -n "${COLLECTOR_PID:-}" ]]; then
+        kill "$COLLECTOR_PID" 2>/dev/null || true
+    fi
+    cleanup_test_env
+}
+
+# Accept one connection on $COLLECTOR_SOCKET and write the frames it gets to
+# $COLLECTOR_OUTPUT, one per line.
+start_collector() {
+    python3 - "$COLLECTOR_SOCKET" "$COLLECTOR_OUTPUT" <<'EOF_PY' &
+import socket, struct, sys
+sock = socket.socket(socket.AF_UNIX, socket.SOCK_STREAM)
+sock.bind(sys.argv[1])
+sock.listen(1)
+conn, _ = sock.accept()
+data = b""
+with open(sys.argv[2], "wb") as out:
+    while True:
+        chunk = conn.recv(65536)
+        if not chunk:
+            break
+        data += chunk
+        while len(data) >= 4 and len(data) >= 4 + struct.unpack(">I", data[:4])[0]:
+            length = struct.unpack(">I", data[:4])[0]
+            out.write(data[4:4 + length] + b"\n")
+            out.flush()
+            data = data[4 + length:]
+EOF_PY
+    COLLECTOR_PID=$!
+    for _ in $(seq 1 50); do
+        [[ -S "$COLLECTOR_SOCKET" ]] && return
+        sleep 0.1
+    done
+    echo "collector did not start" >&2
+    return 1
+}
+
+# Set up a container running $1 and the paths of its collector
+setup_forward_container() {
+    setup_container_env "$1"
+    COLLECTOR_SOCKET="$TEST_TMPDIR/collector.sock"
+    COLLECTOR_OUTPUT="$TEST_TMPDIR/collector.log"
+}
+
+@test "log forward: lines reach the collector as frames" {
+    setup_forward_container "echo hello from the container; echo oops >&2"
+    start_collector
+    start_conmon_with_default_args --log-path "k8s-file:$LOG_PATH" --log-path "forward:$COLLECTOR_SOCKET" --log-forward-flush-interval 50
+    wait_for_conmon_exit
+
+    run cat "$COLLECTOR_OUTPUT"
+    assert "$output" =~ "stdout F hello from the container"
+    assert "$output" =~ "stderr F oops"
+
+    run cat "$LOG_PATH"
+    assert_output_contains "hello from the container"
+}
+
+@test "log forward: lines queued before the collector starts are sent once it does" {
+    setup_forward_container "echo before the collector; while [ ! -f /tmp/go ]; do /busybox sleep 0.1; done; echo after the collector"
+    start_conmon_with_default_args --log-path "k8s-file:$LOG_PATH" --log-path "forward:$COLLECTOR_SOCKET" --log-forward-flush-interval 50
+    wait_for_runtime_status "$CTR_ID" running
+    # Let a few connection attempts fail
+    sleep 1
+
+    start_collector
+    touch "$ROOTFS/tmp/go"
+    wait_for_conmon_exit
+
+    run cat "$COLLECTOR_OUTPUT"
+    assert "$output" =~ "stdout F before the collector"
+    assert "$output" =~ "stdout F after the collector"
+}
+
+@test "log forward: a missing collector does not stop the other drivers" {
+    setup_forward_container "echo hello from the container"
+    start_conmon_with_default_args --log-path "k8s-file:$LOG_PATH" --log-path "forward:$COLLECTOR_SOCKET"
+    wait_for_conmon_exit
+
+    run cat "$LOG_PATH"
+    assert_output_contains "hello from the container"
+}
+
+@test "log forward: the socket path is required" {
+    setup_forward_container
+    start_conmon_with_default_args --log-path "forward:"
+    assert_output_contains "forward requires the path of a unix socket"
+}
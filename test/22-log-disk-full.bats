@@ -0,0 +1,52 @@
+#!/usr/bin/env bats
+
+load test_helper
+
+setup() {
+    check_conmon_binary
+    check_runtime_binary
+    if [[ $EUID -ne 0 ]]; then
+        skip "mounting a small tmpfs needs root"
+    fi
+    setup_container_env "/busybox seq 1 20000; /busybox sleep 2"
+    FULL_FS="$TEST_TMPDIR/full"
+    mkdir -p "$FULL_FS"
+    mount -t tmpfs -o size=1m tmpfs "$FULL_FS" || skip "cannot mount tmpfs"
+    LOG_PATH="$FULL_FS/container.log"
+    # Leave no room for the log
+    dd if=/dev/zero of="$FULL_FS/filler" bs=4k 2>/dev/null || true
+}
+
+teardown() {
+    umount "$FULL_FS" 2>/dev/null || true
+    cleanup_test_env
+}
+
+@test "log disk full: output is held back and the loss is logged once there is space" {
+    start_conmon_with_default_args --log-path "k8s-file:$LOG_PATH" --log-spill-size 65536
+    sleep 1
+    rm -f "$FULL_FS/filler"
+    wait_for_conmon_exit
+
+    run cat "$LOG_PATH"
+    assert "$output" =~ "stderr F conmon: [0-9]+ bytes of logs lost while the file system was full"
+    run grep -c "stdout F 1$" "$LOG_PATH"
+    assert "$output" == 1
+    # Every line is still a whole k8s-file line
+    run grep -vc "^[^ ]* std\(out\|err\) [FP] " "$LOG_PATH"
+    assert "$output" == 0
+}
+
+@test "log disk full: held back output is written at exit with --no-sync-log" {
+    start_conmon_with_default_args --log-path "k8s-file:$LOG_PATH" --log-spill-size 65536 --no-sync-log
+    # Between the first retry, after 1s, and the next one, after 3s; the
+    # container exits before that
+    sleep 1.5
+    rm -f "$FULL_FS/filler"
+    wait_for_conmon_exit
+
+    run cat "$LOG_PATH"
+    assert "$output" =~ "stderr F conmon: [0-9]+ bytes of logs lost while the file system was full"
+    run grep -c "stdout F 1$" "$LOG_PATH"
+    assert "$output" == 1
+}
@@ -0,0 +1,190 @@
+#!/usr/bin/env bats
+
+load test_helper
+
+setup() {
+    check_conmon_binary
+    check_runtime_binary
+}
+
+teardown() {
+    cleanup_test_env
+}
+
+# Set up a container running $1 whose kill(2) calls are trapped to conmon, and
+# build a plugin next to it that lets them all return 0.  kill is an ash
+# builtin, so one shell can make as many trapped calls as a test needs.
+# Handing the listener over with the run.oci.seccomp.receiver annotation is
+# something crun does.
+setup_seccomp_container() {
+    if [[ "$(basename "$RUNTIME_BINARY")" != crun ]]; then
+        skip "handing the seccomp listener to conmon needs crun"
+    fi
+    if ! command -v cc >/dev/null 2>&1 || ! command -v jq >/dev/null 2>&1; then
+        skip "a C compiler and jq are required to set up the seccomp plugin"
+    fi
+    setup_container_env "$1"
+    SECCOMP_SOCKET="$TEST_TMPDIR/seccomp.sock"
+
+    jq --arg socket "$SECCOMP_SOCKET" '.annotations["run.oci.seccomp.receiver"] = $socket
+        | .linux.seccomp = {"defaultAction": "SCMP_ACT_ALLOW",
+                            "architectures": ["SCMP_ARCH_X86_64", "SCMP_ARCH_X86"],
+                            "syscalls": [{"names": ["kill"], "action": "SCMP_ACT_NOTIFY"}]}' \
+        "$BUNDLE_PATH/config.json" > "$BUNDLE_PATH/config.json.tmp"
+    mv "$BUNDLE_PATH/config.json.tmp" "$BUNDLE_PATH/config.json"
+
+    # SECCOMP_TEST_SLOW_FIRST=1 makes the plugin take 2 s over the first request,
+    # SECCOMP_TEST_CACHEABLE=1 lets conmon reuse an answer for the same pid and
+    # SECCOMP_TEST_FAIL=1 makes it fail every request.
+    cat > "$TEST_TMPDIR/seccomp-plugin.c" <<'EOF'
+#include <stdlib.h>
+#include <unistd.h>
+
+#include "seccomp_notify_plugin.h"
+
+static int slow_first = 0;
+static int cacheable = 0;
+static int fail = 0;
+static int requests = 0;
+
+int run_oci_seccomp_notify_version()
+{
+	return 1;
+}
+
+int run_oci_seccomp_notify_start(void **opaque, struct seccomp_notify_conf_s *conf, size_t size_configuration)
+{
+	(void)conf;
+	(void)size_configuration;
+	slow_first = getenv("SECCOMP_TEST_SLOW_FIRST") != NULL;
+	cacheable = getenv("SECCOMP_TEST_CACHEABLE") != NULL;
+	fail = getenv("SECCOMP_TEST_FAIL") != NULL;
+	*opaque = NULL;
+	return 0;
+}
+
+int run_oci_seccomp_notify_handle_request(void *opaque, struct seccomp_notif_sizes *sizes, struct seccomp_notif *sreq,
+					  struct seccomp_notif_resp *sresp, int seccomp_fd, int *handled)
+{
+	(void)opaque;
+	(void)sizes;
+	(void)sreq;
+	(void)seccomp_fd;
+
+	if (__atomic_fetch_add(&requests, 1, __ATOMIC_SEQ_CST) == 0 && slow_first)
+		sleep(2);
+	if (fail)
+		return -1;
+	sresp->error = 0;
+	sresp->val = 0;
+	*handled = RUN_OCI_SECCOMP_NOTIFY_HANDLE_SEND_RESPONSE;
+	if (cacheable)
+		*handled |= RUN_OCI_SECCOMP_NOTIFY_HANDLE_CACHEABLE | RUN_OCI_SECCOMP_NOTIFY_CACHE_ARG(0);
+	return 0;
+}
+
+int run_oci_seccomp_notify_stop(void *opaque)
+{
+	(void)opaque;
+	return 0;
+}
+EOF
+    cc -shared -fPIC -DUSE_SECCOMP -I"$BATS_TEST_DIRNAME/../src" -o "$TEST_TMPDIR/seccomp-plugin.so" "$TEST_TMPDIR/seccomp-plugin.c"
+}
+
+start_conmon_with_seccomp() {
+    start_conmon_with_default_args --log-path "k8s-file:$LOG_PATH" \
+        --seccomp-notify-socket "$SECCOMP_SOCKET" \
+        --seccomp-notify-plugins "$TEST_TMPDIR/seccomp-plugin.so" "$@"
+    if [[ "$output" == *"seccomp support not present"* ]]; then
+        skip "conmon is built without seccomp support"
+    fi
+}
+
+# Wait until the container has logged the line $1
+wait_for_log_line() {
+    for _ in $(seq 1 50); do
+        grep -q " stdout F $1\$" "$LOG_PATH" 2>/dev/null && return 0
+        sleep 0.1
+    done
+    die "timed out waiting for '$1' in the container log"
+}
+
+# Have conmon write its seccomp notification telemetry and wait for it
+dump_seccomp_stats() {
+    rm -f "$BUNDLE_PATH/seccomp-notify-stats"
+    kill -USR2 "$(cat "$CONMON_PID_FILE")"
+    for _ in $(seq 1 50); do
+        [[ -f "$BUNDLE_PATH/seccomp-notify-stats" ]] && return 0
+        sleep 0.1
+    done
+    die "timed out waiting for seccomp-notify-stats"
+}
+
+@test "seccomp notify: a slow plugin does not hold up other trapped syscalls" {
+    setup_seccomp_container "(kill -0 1; echo slow) & /busybox sleep 1; kill -0 1; echo fast; wait"
+    SECCOMP_TEST_SLOW_FIRST=1 start_conmon_with_seccomp --seccomp-notify-threads 2
+    wait_for_conmon_exit
+
+    # The second call is answered by the other worker while the first waits
+    run sed -n 's/.* stdout F //p' "$LOG_PATH"
+    assert "$output" == "$(printf 'fast\nslow')"
+}
+
+@test "seccomp notify: a failing plugin still answers the trapped syscall" {
+    setup_seccomp_container 'kill -0 1 || echo refused; echo done; /busybox sleep 5'
+    SECCOMP_TEST_FAIL=1 start_conmon_with_seccomp
+    wait_for_log_line done
+    dump_seccomp_stats
+
+    run cat "$LOG_PATH"
+    assert_output_contains "stdout F refused"
+    run grep -x "plugin_errors 1" "$BUNDLE_PATH/seccomp-notify-stats"
+    assert_success
+}
+
+@test "seccomp notify: a cacheable answer is reused" {
+    setup_seccomp_container 'for i in $(/busybox seq 1 10); do kill -0 1; done; echo done; /busybox sleep 5'
+    SECCOMP_TEST_CACHEABLE=1 start_conmon_with_seccomp
+    wait_for_log_line done
+    dump_seccomp_stats
+
+    run grep -x -e "cache_hits 9" -e "cache_misses 1" -e "cache_entries 1" "$BUNDLE_PATH/seccomp-notify-stats"
+    assert "${#lines[@]}" == 3
+}
+
+@test "seccomp notify: the decision cache is cleared at 1024 entries" {
+    # Pid 1 is gone from the cache once it is cleared, pid 1100 came after
+    setup_seccomp_container 'for i in $(/busybox seq 1 1100); do kill -0 $i; done; kill -0 1; kill -0 1100; echo done; /busybox sleep 5'
+    SECCOMP_TEST_CACHEABLE=1 start_conmon_with_seccomp
+    wait_for_log_line done
+    dump_seccomp_stats
+
+    run grep -x -e "cache_hits 1" -e "cache_misses 1101" -e "cache_entries 77" "$BUNDLE_PATH/seccomp-notify-stats"
+    assert "${#lines[@]}" == 3
+}
+
+@test "seccomp notify: SIGUSR2 writes the notification stats" {
+    setup_seccomp_container 'kill -0 1; kill -0 2; kill -0 3; echo done; /busybox sleep 5'
+    start_conmon_with_seccomp
+    wait_for_log_line done
+    dump_seccomp_stats
+
+    run cat "$BUNDLE_PATH/seccomp-notify-stats"
+    assert "$output" =~ "notifications 3"
+    assert "$output" =~ "workers 1"
+    assert "$output" =~ "latency count=3 "
+    assert "$output" =~ "plugin $TEST_TMPDIR/seccomp-plugin.so count=3 "
+    assert "$output" =~ "syscall [0-9]+ 3"
+}
+
+@test "seccomp notify: SIGUSR2 without a seccomp listener is ignored" {
+    setup_container_env "/busybox sleep 5"
+    start_conmon_with_default_args --log-path "k8s-file:$LOG_PATH"
+    wait_for_runtime_status "$CTR_ID" running
+
+    kill -USR2 "$(cat "$CONMON_PID_FILE")"
+    sleep 0.5
+    kill -0 "$(cat "$CONMON_PID_FILE")"
+    [ ! -f "$BUNDLE_PATH/seccomp-notify-stats" ]
+}
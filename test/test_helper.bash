@@ -466,6 +466,17 @@ run_conmon_with_default_args() {
     wait_for_runtime_status "$CTR_ID" stopped
 }
 
+# Helper function to wait until the container is stopped and conmon, which
+# drains and closes the log drivers after that, has exited.
+wait_for_conmon_exit() {
+    wait_for_runtime_status "$CTR_ID" stopped
+    for _ in $(seq 1 50); do
+        kill -0 "$(cat "$CONMON_PID_FILE")" 2>/dev/null || return 0
+        sleep 0.1
+    done
+    die "timed out waiting for conmon to exit"
+}
+
 # Generic helper function to create pipe and read from it.
 _start_pipe_reader() {
     local pipe_path=$1